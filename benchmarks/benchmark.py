@@ -0,0 +1,129 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2020 Technica Engineering GmbH
+#  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#
+# Converts generated BLF files and reports throughput and peak memory.
+# Results are compared with a stored baseline of the same machine, a scenario
+# slower than the baseline by more than the tolerance fails the run.
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+
+# name: generator arguments
+SCENARIOS = {
+    "canfd": ["--mix", "canfd=100", "--compression", "6"],
+    "ethernet": ["--mix", "ethernet=100", "--compression", "6"],
+    "mixed": ["--mix", "canfd=70,ethernet=20,flexray=5,lin=5", "--compression", "6"],
+    "mixed_fast": ["--mix", "canfd=70,ethernet=20,flexray=5,lin=5", "--compression", "1"],
+    "mixed_stored": ["--mix", "canfd=70,ethernet=20,flexray=5,lin=5", "--compression", "0"],
+}
+
+
+def generate(args, name, path):
+    if os.path.exists(path):
+        return
+    print(f"Generating {path}", flush=True)
+    subprocess.run([args.generator, "--size", args.size, *SCENARIOS[name], path + ".tmp"], check=True)
+    os.replace(path + ".tmp", path)
+
+
+def object_count(args, path):
+    out = subprocess.run([args.converter, "--info", "--json", path], check=True, capture_output=True, text=True).stdout
+    return json.loads(out)["object_count"]
+
+
+def run(args, path, output):
+    start = time.perf_counter()
+    proc = subprocess.Popen([args.converter, *args.converter_args, path, output], stdout=subprocess.DEVNULL)
+    _, status, usage = os.wait4(proc.pid, 0)
+    elapsed = time.perf_counter() - start
+    if status != 0:
+        raise RuntimeError(f"Conversion of {path} failed")
+    # ru_maxrss is in kilobytes on Linux
+    return elapsed, usage.ru_maxrss * 1024
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Benchmarks blf_converter on generated BLF files.")
+    parser.add_argument("--converter", required=True)
+    parser.add_argument("--generator", required=True)
+    parser.add_argument("--work-dir", required=True, help="Generated inputs are kept here between runs")
+    parser.add_argument("--baseline", required=True, help="JSON file with the stored results")
+    parser.add_argument("--size", default="2G", help="Uncompressed object data per input file")
+    parser.add_argument("--runs", type=int, default=3, help="The best run of each scenario counts")
+    parser.add_argument("--tolerance", type=float, default=0.15)
+    parser.add_argument("--update", action="store_true", help="Store the results as new baseline")
+    parser.add_argument("--scenario", action="append", choices=sorted(SCENARIOS))
+    parser.add_argument("converter_args", nargs="*", help="Extra converter options, after --")
+    args = parser.parse_args()
+
+    os.makedirs(args.work_dir, exist_ok=True)
+    host = platform.node()
+    results = {}
+    for name in args.scenario or SCENARIOS:
+        path = os.path.join(args.work_dir, f"{name}_{args.size}.blf")
+        output = os.path.join(args.work_dir, f"{name}.pcapng")
+        generate(args, name, path)
+        size = os.path.getsize(path)
+        objects = object_count(args, path)
+
+        best, rss = None, 0
+        for _ in range(args.runs):
+            elapsed, peak = run(args, path, output)
+            best = elapsed if best is None else min(best, elapsed)
+            rss = max(rss, peak)
+        os.remove(output)
+
+        results[name] = {
+            "input_bytes": size,
+            "objects": objects,
+            "seconds": round(best, 3),
+            "mb_per_s": round(size / best / 1e6, 1),
+            "objects_per_s": round(objects / best),
+            "peak_rss_mb": round(rss / 1e6, 1),
+        }
+        r = results[name]
+        print(f"{name:14} {r['mb_per_s']:8.1f} MB/s {r['objects_per_s']:12} objects/s {r['peak_rss_mb']:8.1f} MB peak RSS", flush=True)
+
+    baseline = {}
+    if os.path.exists(args.baseline):
+        with open(args.baseline) as f:
+            baseline = json.load(f)
+
+    if args.update:
+        baseline[host] = results
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print(f"Stored results for {host} in {args.baseline}")
+        return 0
+
+    # Without stored results nothing is checked, which must not pass as a check
+    stored = baseline.get(host)
+    if not stored:
+        print(f"No baseline for {host} in {args.baseline}, run with --update to store one", file=sys.stderr)
+        return 2
+
+    failed = False
+    for name, r in results.items():
+        if name not in stored:
+            print(f"{name:14} no baseline, run with --update to store one", file=sys.stderr)
+            failed = True
+            continue
+        b = stored[name]
+        speed = r["objects_per_s"] / b["objects_per_s"] - 1
+        memory = r["peak_rss_mb"] / b["peak_rss_mb"] - 1 if b["peak_rss_mb"] else 0
+        regression = speed < -args.tolerance or memory > args.tolerance
+        failed |= regression
+        print(f"{name:14} {speed:+7.1%} throughput {memory:+7.1%} peak RSS{'  REGRESSION' if regression else ''}")
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
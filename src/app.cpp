@@ -3,1054 +3,812 @@
   GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
 */
 
-#include <array>
-#include <codecvt>
-#include <cstring>
-#include <ctime>
+#include <algorithm>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
 #include <fstream>
-#include <iomanip>
 #include <iostream>
-#include <locale>
-#include <map>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
-#include <Vector/BLF.h>
-#include <light_pcapng_ext.h>
-#include "endianness.h"
-#include <pcapng_exporter/lin.h>
-#include <pcapng_exporter/linktype.h>
-#include <pcapng_exporter/pcapng_exporter.hpp>
 #include <args.hxx>
+#include <pcapng_exporter/linktype.h>
 
+#include "asc_writer.hpp"
+#include "blf_format.hpp"
 #include "channels.hpp"
+#include "columnar.hpp"
+#include "compressed_input.hpp"
+#include "container_cache.hpp"
+#include "converter.hpp"
+#include "decimate.hpp"
+#include "encoder.hpp"
+#include "filter.hpp"
+#include "file_writer.hpp"
+#include "info.hpp"
+#include "interface_stats.hpp"
+#include "jobs.hpp"
+#include "on_change.hpp"
+#include "parallel.hpp"
+#include "pcap_writer.hpp"
+#include "pcapng_writer.hpp"
+#include "reorder.hpp"
+#include "sequence.hpp"
+#include "signals.hpp"
+#include "sink.hpp"
+#include "statistics.hpp"
+#include "summary.hpp"
+#include "watch.hpp"
+
+using namespace blf_converter;
 
-using namespace Vector::BLF;
+#define NANOS_PER_SEC 1000000000
 
-#define HAS_FLAG(var,pos) ((var) & (1<<(pos)))
+// Parses durations such as "500ms", "2s", "250us" or "1000ns", plain numbers are milliseconds
+uint64_t parse_duration_ns(const std::string& text) {
+	size_t pos = 0;
+	double value = std::stod(text, &pos);
+	std::string unit = text.substr(pos);
+	double scale;
+	if (unit == "ns") scale = 1;
+	else if (unit == "us") scale = 1000;
+	else if (unit == "ms" || unit.empty()) scale = 1000 * 1000;
+	else if (unit == "s") scale = NANOS_PER_SEC;
+	else throw std::invalid_argument("Unknown time unit: " + unit);
+	if (value < 0) throw std::invalid_argument("Negative duration: " + text);
+	return (uint64_t)(value * scale);
+}
+
+// Parses local times such as "2024-05-01", "2024-05-01T12:30:00" or "2024-05-01 12:30:00"
+uint64_t parse_local_time_ns(const std::string& text) {
+	Vector::BLF::SYSTEMTIME time = {};
+	int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+	char separator = 'T';
+	int fields = sscanf(text.c_str(), "%d-%d-%d%c%d:%d:%d", &year, &month, &day, &separator, &hour, &minute, &second);
+	if ((fields != 3 && fields != 7) || (separator != 'T' && separator != ' ')) {
+		throw std::invalid_argument("Expected YYYY-MM-DD[THH:MM:SS]: " + text);
+	}
+	time.year = (uint16_t)year;
+	time.month = (uint16_t)month;
+	time.day = (uint16_t)day;
+	time.hour = (uint16_t)hour;
+	time.minute = (uint16_t)minute;
+	time.second = (uint16_t)second;
+	return systemtime_to_ns(time);
+}
+
+// Reads the file statistics header and rewinds the stream
+bool peek_statistics(std::istream& in, Vector::BLF::FileStatistics* statistics) {
+	uint8_t header[BLF_FILE_STATISTICS_SIZE];
+	auto start = in.tellg();
+	in.read((char*)header, sizeof(header));
+	bool ok = parse_file_statistics(header, (size_t)in.gcount(), statistics);
+	in.clear();
+	in.seekg(start);
+	return ok;
+}
+
+static std::atomic<bool> stop_watching(false);
+
+static void on_stop_signal(int) {
+	stop_watching = true;
+}
+
+// Converts one file of a watched directory through a temporary file, so that
+// readers of out_dir only ever see complete outputs
+static void convert_watched(
+	const std::string& path,
+	const std::string& out_dir,
+	const std::vector<pcapng_exporter::channel_mapping>& mappings,
+	const snap_lengths& snaplen,
+	bool prescan,
+	bool interface_statistics
+) {
+	size_t slash = path.find_last_of('/');
+	std::string name = path.substr(slash == std::string::npos ? 0 : slash + 1);
+	std::string stem = name.substr(0, name.find_last_of('.'));
+	std::string output = out_dir + "/" + stem + ".pcapng";
+	// Unique per job, the same file may be queued again while it is converted
+	std::random_device random;
+	std::string temp = out_dir + "/." + stem + ".pcapng." + std::to_string(random()) + ".tmp";
+	std::string message;
+
+	try {
+		std::ifstream infile(path, std::ios_base::in | std::ios_base::binary);
+		if (!infile.is_open()) {
+			throw std::runtime_error("Unable to open: " + path);
+		}
+		std::ofstream outfile(temp, std::ios_base::out | std::ios_base::binary);
+		if (!outfile.is_open()) {
+			throw std::runtime_error("Unable to open: " + temp);
+		}
 
-#define NANOS_PER_SEC 1000000000
-// Mask used to avoid overflow issues with Timestamp
-#define TIMESTAMP_MASK 0x7fffffffffffffff
+		PcapngWriter writer([&outfile](const uint8_t* data, size_t length) {
+			outfile.write((const char*)data, length);
+		});
+		for (const auto& mapping : mappings) {
+			writer.add_mapping(mapping);
+		}
+		PacketEncoder encoder(writer, snaplen);
+		InterfaceCounterSink counter(encoder);
+		ObjectSink* first = &encoder;
+		if (interface_statistics) {
+			writer.set_interface_statistics(&counter.received());
+			first = &counter;
+		}
+		Converter converter(*first);
+		if (prescan) {
+			converter.prescan(infile);
+		}
+		// Like single conversions, unfinished files are written up to the error
+		try {
+			converter.convert(infile);
+		}
+		catch (std::runtime_error& e) {
+			message = path + ": " + e.what() + "\n";
+			converter.finish();
+		}
 
-#define DIR_IN    1
-#define DIR_OUT   2
+		outfile.close();
+		if (!outfile) {
+			throw std::runtime_error("Unable to write: " + temp);
+		}
+		if (std::rename(temp.c_str(), output.c_str()) != 0) {
+			throw std::runtime_error("Unable to rename " + temp + " to " + output);
+		}
+		message += "Converted " + path + " to " + output + "\n";
+	}
+	catch (std::exception& e) {
+		std::remove(temp.c_str());
+		message += "Failed to convert " + path + ": " + e.what() + "\n";
+	}
+	// A single write keeps the lines of parallel jobs apart
+	std::cerr << message << std::flush;
+}
 
-// Enumerations
-enum class FlexRayPacketType
-{
-	FlexRayFrame = 1,    // FlexRay Frame
-	FlexRaySymbol = 2     // FlexRay Symbol
-};
+int main(int argc, char* argv[]) {
+	args::ArgumentParser parser("This tool is intended for converting BLF files to plain PCAPNG files.");
+	parser.helpParams.showTerminator = false;
+	parser.helpParams.proglineShowFlags = true;
 
-class CanFrame {
-private:
-	uint8_t raw[72] = { 0 };
-public:
+	args::HelpFlag help(parser, "help", "", { 'h', "help" }, args::Options::HiddenFromUsage);
+	args::ValueFlag<std::string> maparg(parser, "map-file", "Configuration file for channel mapping", { "channel-map" });
+	args::ValueFlag<std::string> reorderarg(parser, "time", "Write packets in timestamp order within this window (e.g. 500ms, 2s)", { "reorder-window" });
+	args::ValueFlag<size_t> reorderlimitarg(parser, "count", "Maximum number of packets held by the reorder window", { "reorder-limit" }, 1000000);
+	args::ValueFlag<uint64_t> reordermemoryarg(parser, "MiB", "Maximum payload held by the reorder window, the oldest packets are written first above it", { "reorder-memory" }, 1024);
+	args::Flag prescanarg(parser, "prescan", "Read the channel names of the whole file before converting it, so they apply from the first packet on", { "prescan" });
+	args::Flag asyncarg(parser, "async-output", "Encode PCAPNG blocks into large buffers written by a separate I/O thread", { "async-output" });
+	args::Flag infoarg(parser, "info", "Print a summary of the input file instead of converting it", { "info" });
+	args::Flag containersarg(parser, "containers", "With --info, also walk the log container headers", { "containers" });
+	args::Flag jsonarg(parser, "json", "With --info, print one JSON object per file", { "json" });
+	args::ValueFlag<std::string> statsarg(parser, "file", "Write per message statistics to this file, CSV if it ends with .csv, JSON otherwise", { "stats" });
+	args::ValueFlag<std::string> tracearg(parser, "file", "Write a Chrome trace (chrome://tracing, ui.perfetto.dev) of the conversion stages", { "trace" });
+	args::ValueFlag<std::string> filterarg(parser, "expression", "Convert only frames matching the expression, e.g. \"can.id in [0x100-0x1FF] && payload[0] & 0x80\"", { "filter" });
+	args::ValueFlag<uint32_t> keepeveryarg(parser, "n", "Keep only every Nth frame per message (interface and id), error frames are always kept", { "keep-every" }, 1);
+	args::ValueFlag<double> maxratearg(parser, "fps", "Keep at most this many frames per second per message, error frames are always kept", { "max-rate" }, 0);
+	args::Flag onchangearg(parser, "on-change", "Write CAN, LIN and FlexRay frames only when their payload or flags change", { "on-change" });
+	args::ValueFlag<std::string> heartbeatarg(parser, "time", "With --on-change, also write unchanged frames after this time (e.g. 5s)", { "heartbeat" });
+	args::Flag interfacestatsarg(parser, "interface-stats", "End the output with PCAPNG Interface Statistics Blocks: time range, received and dropped frames per interface, implies --async-output", { "interface-stats" });
+	args::ValueFlag<std::string> indexarg(parser, "file", "Write a seek index (timestamp to file offset) of the output, implies --async-output", { "index" });
+	args::ValueFlag<uint32_t> indexpacketsarg(parser, "count", "With --index, add an entry at least every this many packets", { "index-packets" }, 10000);
+	args::ValueFlag<std::string> indextimearg(parser, "time", "With --index, add an entry at least every this time (e.g. 1s)", { "index-time" }, "1s");
+	args::ValueFlag<std::string> snaplenarg(parser, "lengths", "Truncate captured frames per link type, e.g. eth=128,flexray=64,can=16", { "snaplen" });
+	args::Flag watcharg(parser, "watch", "Keep converting BLF files completed in the infile directory into the outfile directory until interrupted", { "watch" });
+	args::ValueFlag<size_t> workersarg(parser, "count", "With --watch, number of files converted in parallel", { "workers" }, std::max(1u, std::thread::hardware_concurrency()));
+	args::ValueFlag<size_t> parallelarg(parser, "threads", "Split the file into ranges of log containers converted by this many threads, one PCAPNG section each", { "parallel" });
+	args::ValueFlag<std::string> formatarg(parser, "format", "Output format: pcapng (default), pcap (one file per link type), columnar or asc (Vector ASC text)", { "format" }, "pcapng");
+	args::ValueFlag<std::string> jobsarg(parser, "file", "Write the outputs listed in this JSON file, each with its own format, filter and snaplen, instead of outfile", { "jobs" });
+	args::ValueFlag<std::string> summaryarg(parser, "file", "Write a summary (time range, interfaces, identifiers) of the input for --query, without outfile only the summary is written", { "summary" });
+	args::ValueFlagList<std::string> dbcarg(parser, "[channel=]file", "Decode CAN signals with this DBC file on the channel given by interface name or BLF channel number, or on all CAN channels (repeatable)", { "dbc" });
+	args::ValueFlag<std::string> signalsarg(parser, "file", "With --dbc, write the decoded signals as time series to this file", { "signals" });
+	args::Flag sequencearg(parser, "sequence", "Convert infile and the numbered files following it (drive_001.blf, drive_002.blf, ...) as one recording", { "sequence" });
+	args::Flag queryarg(parser, "query", "List the BLF files whose summaries in the infile directory match the --query-* options", { "query" });
+	args::ValueFlag<std::string> querylinkarg(parser, "bus", "With --query, bus of the frames: can, lin, eth or fr", { "query-link" });
+	args::ValueFlag<uint32_t> querychannelarg(parser, "channel", "With --query, BLF channel of the frames", { "query-channel" });
+	args::ValueFlag<std::string> queryidarg(parser, "id", "With --query, CAN / LIN identifier, FlexRay slot or EtherType, e.g. 0x3E9", { "query-id" });
+	args::ValueFlag<std::string> queryfromarg(parser, "time", "With --query, files with frames at or after this local time, e.g. 2024-05-01T08:00:00", { "query-from" });
+	args::ValueFlag<std::string> querytoarg(parser, "time", "With --query, files with frames at or before this local time", { "query-to" });
+	args::ValueFlag<std::string> cachearg(parser, "dir", "Keep inflated log containers in this directory, later conversions of the same file skip decompression", { "cache" });
+	args::ValueFlag<uint64_t> cachesizearg(parser, "MiB", "With --cache, evict the least recently used files above this size", { "cache-size" }, 4096);
 
-	uint32_t id() {
-		return ntoh32(*(uint32_t*)raw) & 0x1fffffff;
-	}
+	args::Positional<std::string> inarg(parser, "infile", "Input File", args::Options::Required);
+	args::Positional<std::string> outarg(parser, "outfile", "Output File");
 
-	void id(uint32_t value) {
-		uint8_t id_flags = *raw & 0xE0;
-		*(uint32_t*)raw = hton32(value);
-		*raw |= id_flags;
+	try
+	{
+		parser.ParseCLI(argc, argv);
 	}
-
-	bool ext() {
-		return (*raw & 0x80) != 0;
+	catch (args::Help)
+	{
+		std::cout << parser;
+		return 0;
 	}
-	void ext(bool value) {
-		uint8_t masked = *raw & 0x7F;
-		*raw = masked | value << 7;
+	catch (args::Error e)
+	{
+		std::cerr << e.what() << std::endl;
+		std::cerr << parser;
+		return 1;
 	}
 
-	bool rtr() {
-		return (*raw & 0x40) != 0;
+	if (queryarg) {
+		summary_query query;
+		try {
+			if (querylinkarg) {
+				const std::string& link = args::get(querylinkarg);
+				if (link == "can") query.link_type = LINKTYPE_CAN;
+				else if (link == "lin") query.link_type = LINKTYPE_LIN;
+				else if (link == "eth") query.link_type = LINKTYPE_ETHERNET;
+				else if (link == "fr" || link == "flexray") query.link_type = LINKTYPE_FLEXRAY;
+				else throw std::invalid_argument("Unknown bus: " + link);
+			}
+			if (querychannelarg) {
+				query.channel = args::get(querychannelarg);
+			}
+			if (queryidarg) {
+				query.id = (uint32_t)std::stoul(args::get(queryidarg), nullptr, 0);
+			}
+			if (queryfromarg) {
+				query.from_ns = parse_local_time_ns(args::get(queryfromarg));
+			}
+			if (querytoarg) {
+				query.to_ns = parse_local_time_ns(args::get(querytoarg));
+			}
+		}
+		catch (std::exception& e) {
+			std::cerr << "Invalid query: " << e.what() << std::endl;
+			return 1;
+		}
+		try {
+			query_summaries(args::get(inarg), query, [](const std::string& file) {
+				std::cout << file << std::endl;
+			});
+		}
+		catch (std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
 	}
-	void rtr(bool value) {
-		uint8_t masked = *raw & 0xBF;
-		*raw = masked | value << 6;
+
+	if (!infoarg && !outarg && !jobsarg && !summaryarg && !signalsarg) {
+		std::cerr << "Argument 'outfile' is required" << std::endl;
+		std::cerr << parser;
+		return 1;
 	}
 
-	bool err() {
-		return (*raw & 0x20) != 0;
+	uint64_t heartbeat_ns = 0;
+	if (heartbeatarg) {
+		try {
+			heartbeat_ns = parse_duration_ns(args::get(heartbeatarg));
+		}
+		catch (std::exception& e) {
+			std::cerr << "Invalid heartbeat: " << e.what() << std::endl;
+			return 1;
+		}
 	}
-	void err(bool value) {
-		uint8_t masked = *raw & 0xDF;
-		*raw = masked | value << 5;
+
+	uint64_t window_ns = 0;
+	if (reorderarg) {
+		try {
+			window_ns = parse_duration_ns(args::get(reorderarg));
+		}
+		catch (std::exception& e) {
+			std::cerr << "Invalid reorder window: " << e.what() << std::endl;
+			return 1;
+		}
 	}
 
-	bool brs() {
-		return (*(raw + 5) & 0x01) != 0;
+	uint64_t index_interval_ns = 0;
+	try {
+		index_interval_ns = parse_duration_ns(args::get(indextimearg));
 	}
-	void brs(bool value) {
-		uint8_t masked = *(raw + 5) & 0xFE;
-		*(raw + 5) = masked | value << 0;
+	catch (std::exception& e) {
+		std::cerr << "Invalid index time: " << e.what() << std::endl;
+		return 1;
 	}
 
-	bool esi() {
-		return (*(raw + 5) & 0x02) != 0;
+	snap_lengths snaplen;
+	if (snaplenarg) {
+		try {
+			snaplen = parse_snaplen(args::get(snaplenarg));
+		}
+		catch (std::exception& e) {
+			std::cerr << "Invalid snaplen: " << e.what() << std::endl;
+			return 1;
+		}
 	}
-	void esi(bool value) {
-		uint8_t masked = *(raw + 5) & 0xFD;
-		*(raw + 5) = masked | value << 1;
+
+	std::string format = args::get(formatarg);
+	if (format != "pcapng" && format != "pcap" && format != "columnar" && format != "asc") {
+		std::cerr << "Unknown output format: " << format << std::endl;
+		return 1;
 	}
-	
-	bool fdf() {
-		return (*(raw + 5) & 0x04) != 0;
+	if ((format == "columnar" || format == "asc") && (reorderarg || maparg || snaplenarg)) {
+		std::cerr << "--reorder-window, --channel-map and --snaplen do not apply to columnar and ASC output" << std::endl;
+		return 1;
 	}
-	void fdf(bool value) {
-		uint8_t masked = *(raw + 5) & 0xFB;
-		*(raw + 5) = masked | value << 2;
+	if (format != "pcapng" && (asyncarg || indexarg || interfacestatsarg)) {
+		std::cerr << "--async-output, --index and --interface-stats only apply to pcapng output" << std::endl;
+		return 1;
 	}
 
-	uint8_t len() {
-		return *(raw + 4);
-	}
-	void len(uint8_t value) {
-		*(raw + 4) = value;
+	if (bool(dbcarg) != bool(signalsarg)) {
+		std::cerr << "--dbc and --signals are used together" << std::endl;
+		return 1;
 	}
 
-	const uint8_t* data() {
-		return raw + 8;
-	}
-	void data(const uint8_t* value, size_t size) {
-		memcpy(raw + 8, value, size);
+	if (sequencearg && cachearg) {
+		std::cerr << "--cache does not apply to --sequence" << std::endl;
+		return 1;
 	}
 
-	const uint8_t* bytes() {
-		return raw;
+	// gzip, zstd and zip files are decompressed while converting
+	input_wrapper wrapper = watcharg ? input_wrapper::none : detect_wrapper(args::get(inarg));
+	if (wrapper != input_wrapper::none && (cachearg || sequencearg || parallelarg || infoarg)) {
+		std::cerr << "--cache, --sequence, --parallel and --info do not apply to compressed input" << std::endl;
+		return 1;
 	}
 
-	const uint8_t size() {
-		return len() + 8;
+	if (!outarg && !jobsarg && (asyncarg || indexarg || interfacestatsarg)) {
+		std::cerr << "--async-output, --index and --interface-stats need an outfile" << std::endl;
+		return 1;
 	}
 
-};
-
-std::map <uint16_t, std::string> channels_prefix = {
-	{LINKTYPE_ETHERNET, "ETH-"},
-	{LINKTYPE_CAN, "CAN-"},
-	{LINKTYPE_LIN, "LIN-"},
-	{LINKTYPE_FLEXRAY, "FR-"}
-};
-
-template<class ObjectHeaderGeneric>
-std::uint64_t calculate_ts_res(ObjectHeaderGeneric* oh)
-{
-	uint64_t ts_resol = 0;
-	switch (oh->objectFlags) {
-	case ObjectHeader::ObjectFlags::TimeTenMics:
-		ts_resol = 100000;
-		break;
-	case ObjectHeader::ObjectFlags::TimeOneNans:
-		ts_resol = NANOS_PER_SEC;
-		break;
-	default:
-		fprintf(stderr, "ERROR: The timestamp format is unknown (not 10us nor ns)!\n");
-		break;
+	if (jobsarg && (formatarg || asyncarg || indexarg || interfacestatsarg || reorderarg || tracearg || snaplenarg)) {
+		std::cerr << "--format, --async-output, --index, --interface-stats, --reorder-window, --trace and --snaplen do not apply to --jobs" << std::endl;
+		return 1;
 	}
-	return ts_resol;
-}
-
-template<class ObjectHeaderGeneric>
-pcapng_exporter::frame_header generate_header(
-	ObjectHeaderGeneric* oh,
-	std::uint64_t date_offset_ns)
-{
-	pcapng_exporter::frame_header header = pcapng_exporter::frame_header();
-	header.channel_id = oh->channel;
-	header.timestamp_resolution = calculate_ts_res(oh);
-	uint64_t relative_timestamp = (NANOS_PER_SEC / header.timestamp_resolution) * oh->objectTimeStamp;
-	// To avoid overflow issues that are handled differently in different OS
-	uint64_t ts = (relative_timestamp & TIMESTAMP_MASK) + (date_offset_ns & TIMESTAMP_MASK);
-	header.timestamp.tv_sec = ts / NANOS_PER_SEC;
-	header.timestamp.tv_nsec = ts % NANOS_PER_SEC;
-	return header;
-}
 
-template <class ObjHeader>
-int write_packet(
-	pcapng_exporter::PcapngExporter exporter,
-	uint16_t link_type,
-	ObjHeader* oh,
-	uint32_t length,
-	const uint8_t* data,
-	uint64_t date_offset_ns,
-	uint32_t flags = 0,
-	uint32_t hw_channel = 0
-) {
-	light_packet_interface interface = { 0 };
-	interface.link_type = link_type;
-	auto channel_id = 100000 * hw_channel + oh->channel;
-	std::string name;
-	
-	// Unifying interface name for Ethernet link_type with Wireshark.
-	// For other link_types updates, refer to `add_interface_name` in https://gitlab.com/wireshark/wireshark/-/blob/44781615b155d3ae125394454cc317af159c218f/wiretap/blf.c
-	if (exporter.mappings.empty() && hw_channel == 0 && channels_prefix.find(link_type) != channels_prefix.end()) {
-	    // Needed to take the name as fallback in get_interface_name of mapping.cpp in pcapng_exporter
-		channel_id = 0;
-		name = channels_prefix[link_type] + std::to_string(oh->channel);
-	}
-	else {
-		name = std::to_string(channel_id);
+	if (watcharg) {
+		if (jobsarg || cachearg || summaryarg || sequencearg || signalsarg || dbcarg || format != "pcapng" || reorderarg || asyncarg || indexarg || statsarg || tracearg
+			|| filterarg || onchangearg || heartbeatarg || args::get(keepeveryarg) > 1 || args::get(maxratearg) > 0 || infoarg || parallelarg) {
+			std::cerr << "--watch only supports pcapng output with --channel-map, --snaplen, --prescan and --interface-stats" << std::endl;
+			return 1;
+		}
+		std::vector<pcapng_exporter::channel_mapping> mappings;
+		if (maparg) {
+			try {
+				// Loaded once, all jobs share the mappings
+				mappings = load_channel_map(args::get(maparg));
+			}
+			catch (std::runtime_error& e) {
+				std::cerr << e.what() << std::endl;
+				return 1;
+			}
+		}
+		signal(SIGINT, on_stop_signal);
+		signal(SIGTERM, on_stop_signal);
+
+		std::string out_dir = args::get(outarg);
+		bool prescan = prescanarg;
+		bool interface_statistics = interfacestatsarg;
+		size_t workers = std::max((size_t)1, args::get(workersarg));
+		// The pool finishes the queued files before leaving this scope
+		WorkerPool pool(workers, 2 * workers);
+		try {
+			watch_directory(args::get(inarg), ".blf", stop_watching, [&](const std::string& path) {
+				pool.submit([path, &out_dir, &mappings, &snaplen, prescan, interface_statistics] {
+					convert_watched(path, out_dir, mappings, snaplen, prescan, interface_statistics);
+				});
+			});
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		return 0;
 	}
-	char name_str[256] = { 0 };
-	memcpy(name_str, name.c_str(), sizeof(char) * std::min((size_t)255, name.length()));
-	interface.name = name_str;
-
-	uint64_t ts_resol = calculate_ts_res(oh);
-	if (ts_resol == 0) return -3;
-
-	/* since we convert to NS, we need to always set the output to NS */
-	interface.timestamp_resolution = NANOS_PER_SEC;
-
-	light_packet_header header = { 0 };
-	uint64_t relative_timestamp = (NANOS_PER_SEC / ts_resol) * oh->objectTimeStamp;
-	uint64_t ts = (relative_timestamp & TIMESTAMP_MASK) + (date_offset_ns & TIMESTAMP_MASK);
-	header.timestamp.tv_sec = ts / NANOS_PER_SEC;
-	header.timestamp.tv_nsec = ts % NANOS_PER_SEC;
-	header.captured_length = length;
-	header.original_length = length;
-	header.flags = flags;
 
-	exporter.write_packet(channel_id, interface, header, data);
-
-	return 0;
-}
-
-// CAN_MESSAGE = 1
-void write(pcapng_exporter::PcapngExporter exporter, CanMessage* obj, uint64_t date_offset_ns) {
-	CanFrame can;
-
-	can.id(obj->id);
-	can.rtr(HAS_FLAG(obj->flags, 7));
-	can.len(obj->dlc);
-	can.data(obj->data.data(), obj->data.size());
-
-	uint32_t flags = HAS_FLAG(obj->flags, 0) ? DIR_OUT : DIR_IN;
-	write_packet(exporter, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns, flags);
-}
-
-// CAN_MESSAGE2
-void write(pcapng_exporter::PcapngExporter exporter, CanMessage2* obj, uint64_t date_offset_ns) {
-	CanFrame can;
-
-	can.id(obj->id);
-	can.rtr(HAS_FLAG(obj->flags, 7));
-	can.len(obj->dlc);
-	can.data(obj->data.data(), obj->data.size());
-
-	uint32_t flags = HAS_FLAG(obj->flags, 0) ? DIR_OUT : DIR_IN;
-
-	write_packet(exporter, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns, flags);
-}
-
-template <class CanError>
-void write_can_error(pcapng_exporter::PcapngExporter exporter, CanError* obj, uint64_t date_offset_ns) {
-
-	CanFrame can;
-	can.err(true);
-	can.len(8);
-	write_packet(exporter, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns);
-}
-
-// CAN_ERROR = 2
-void write(pcapng_exporter::PcapngExporter exporter, CanErrorFrame* obj, uint64_t date_offset_ns) {
-
-	write_can_error(exporter, obj, date_offset_ns);
-}
-
-// CAN_ERROR_EXT = 73
-void write(pcapng_exporter::PcapngExporter exporter, CanErrorFrameExt* obj, uint64_t date_offset_ns) {
-
-	write_can_error(exporter, obj, date_offset_ns);
-}
-
-// CAN_FD_MESSAGE = 100
-void write(pcapng_exporter::PcapngExporter exporter, CanFdMessage* obj, uint64_t date_offset_ns) {
-
-	CanFrame can;
-
-	can.id(obj->id);
-
-	can.rtr(HAS_FLAG(obj->flags, 7));
-
-	// https://www.tcpdump.org/linktypes/LINKTYPE_CAN_SOCKETCAN.html : set CANFD_FDF flags
-	can.fdf(HAS_FLAG(obj->canFdFlags, 0));
-	can.brs(HAS_FLAG(obj->canFdFlags, 1));
-	can.esi(HAS_FLAG(obj->canFdFlags, 2));
-
-	can.len(obj->validDataBytes);
-	can.data(obj->data.data(), obj->data.size());
-
-	uint32_t flags = HAS_FLAG(obj->flags, 0) ? DIR_OUT : DIR_IN;
-
-	write_packet(exporter, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns, flags);
-}
-
-// CAN_FD_MESSAGE_64 = 101
-void write(pcapng_exporter::PcapngExporter exporter, CanFdMessage64* obj, uint64_t date_offset_ns) {
-
-	CanFrame can;
-
-	can.id(obj->id);
-
-	can.rtr(HAS_FLAG(obj->flags, 4));
-
-	// https://www.tcpdump.org/linktypes/LINKTYPE_CAN_SOCKETCAN.html : set CANFD_FDF flags
-	can.fdf(HAS_FLAG(obj->flags, 12));
-	can.brs(HAS_FLAG(obj->flags, 13));
-	can.esi(HAS_FLAG(obj->flags, 14));
-
-	can.len(obj->validDataBytes);
-	can.data(obj->data.data(), obj->data.size());
-
-	// TODO obj->crc
-
-	uint32_t flags = HAS_FLAG(obj->flags, 6) || HAS_FLAG(obj->flags, 7) ? DIR_OUT : DIR_IN;
-
-	write_packet(exporter, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns);
-}
-
-// CAN_FD_ERROR_64 = 104
-void write(pcapng_exporter::PcapngExporter exporter, CanFdErrorFrame64* obj, uint64_t date_offset_ns) {
-
-	write_can_error(exporter, obj, date_offset_ns);
-}
-
-// ETHERNET_FRAME = 71
-void write(pcapng_exporter::PcapngExporter exporter, EthernetFrame* obj, uint64_t date_offset_ns) {
-
-	uint32_t flags = 0;
-	switch (obj->dir)
-	{
-	case 0:
-		flags = DIR_IN;
-		break;
-	case 1:
-		flags = DIR_OUT;
-		break;
+	if (parallelarg && args::get(parallelarg) > 1 && !infoarg) {
+		if (jobsarg || cachearg || summaryarg || sequencearg || signalsarg || format != "pcapng" || reorderarg || asyncarg || indexarg || statsarg || tracearg
+			|| filterarg || onchangearg || heartbeatarg || args::get(keepeveryarg) > 1 || args::get(maxratearg) > 0) {
+			std::cerr << "--parallel only supports pcapng output with --channel-map, --snaplen and --interface-stats" << std::endl;
+			return 1;
+		}
+		try {
+			std::vector<pcapng_exporter::channel_mapping> mappings;
+			if (maparg) {
+				mappings = load_channel_map(args::get(maparg));
+			}
+			auto on_error = [](const std::exception& e) {
+				std::cout << "Exception: " << e.what() << std::endl;
+			};
+			if (convert_parallel(args::get(inarg), args::get(outarg), args::get(parallelarg), mappings, snaplen, interfacestatsarg, on_error)) {
+				return 0;
+			}
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		std::cerr << "The file cannot be split, converting it sequentially" << std::endl;
 	}
 
-	std::vector<uint8_t> eth;
-	// Pre allocate to remove need of reallocation
-	eth.reserve(14 + 4 + obj->payLoad.size());
-
-	eth.insert(eth.end(), obj->destinationAddress.begin(), obj->destinationAddress.end());
-	eth.insert(eth.end(), obj->sourceAddress.begin(), obj->sourceAddress.end());
-
-	if (obj->tpid) {
-		std::array<uint8_t, 4> vlan = {
-			(uint8_t)(obj->tpid >> 8),
-			(uint8_t)obj->tpid,
-			(uint8_t)(obj->tci >> 8),
-			(uint8_t)obj->tci
-		};
-		eth.insert(eth.end(), vlan.begin(), vlan.end());
+	std::ifstream infile(args::get(inarg), std::ios_base::in | std::ios_base::binary);
+	if (!infile.is_open()) {
+		fprintf(stderr, "Unable to open: %s\n", args::get(inarg).c_str());
+		return 1;
 	}
 
-	eth.push_back((uint8_t)(obj->type >> 8));
-	eth.push_back((uint8_t)obj->type);
-
-	eth.insert(eth.end(), obj->payLoad.begin(), obj->payLoad.end());
-	
-	write_packet(exporter, LINKTYPE_ETHERNET, obj, eth.size(), eth.data(), date_offset_ns, flags);
-}
-
-template <class TEthernetFrame>
-void write_ethernet_frame(pcapng_exporter::PcapngExporter exporter, TEthernetFrame* obj, uint64_t date_offset_ns) {
-	std::vector<uint8_t> eth(obj->frameData);
-
-	uint32_t flags = 0;
-	switch (obj->dir)
-	{
-	case 0:
-		flags = DIR_IN;
-		break;
-	case 1:
-		flags = DIR_OUT;
-		break;
+	if (infoarg) {
+		blf_info info;
+		bool valid = read_blf_info(infile, containersarg, &info);
+		write_blf_info(std::cout, args::get(inarg), info, jsonarg);
+		return valid ? 0 : 1;
 	}
 
-	write_packet(exporter, LINKTYPE_ETHERNET, obj, (uint32_t)eth.size(), eth.data(), date_offset_ns, flags, obj->hardwareChannel);
-}
-
-// ETHERNET_FRAME_EX = 120
-void write(pcapng_exporter::PcapngExporter exporter, EthernetFrameEx* obj, uint64_t date_offset_ns) {
-
-	write_ethernet_frame(exporter, obj, date_offset_ns);
-}
-
-// ETHERNET_FRAME_FORWARDED = 121
-void write(pcapng_exporter::PcapngExporter exporter, EthernetFrameForwarded* obj, uint64_t date_offset_ns) {
-
-	write_ethernet_frame(exporter, obj, date_offset_ns);
-}
-
-void set_measurment_header(uint8_t& measurementHeader, FlexRayPacketType packetType, uint16_t channelMask = 0)
-{
-	/// Measurement Header (1 byte)
-	// TI[0..6]: Type Index
-	// 0x01: FlexRay Frame
-	// 0x02: FlexRay Symbol
-	switch (packetType)
-	{
-	case FlexRayPacketType::FlexRayFrame:
-		measurementHeader = 0x01;
-		break;
-	case FlexRayPacketType::FlexRaySymbol:
-		measurementHeader = 0x02;
-		break;
+	std::unique_ptr<Tracer> tracer;
+	if (tracearg) {
+		tracer = std::make_unique<Tracer>();
 	}
-	// CH: Channel, indicates the Channel
-	// 1	: Channel A
-	// 2/3	: Channel B
-	switch (channelMask)
-	{
-	case 1: /* Channel A */
-		break;
-	case 2: /* Channel B */
-	case 3: /* Channel B */
-		measurementHeader |= 0x80;
-		break;
-	}
-}
 
-void set_header_crc(uint16_t channelMask, uint16_t headerCrc1, uint16_t headerCrc2, uint16_t& headerCrc)
-{
-	// CH: Channel, indicates the Channel
-	// 1	: Channel A
-	// 2/3	: Channel B
-	switch (channelMask)
-	{
-	case 1: /* Channel A */
-		headerCrc = headerCrc1;
-		break;
-	case 2: /* Channel B */
-	case 3: /* Channel B */
-		headerCrc = headerCrc2;
-		break;
-	}
-}
+	std::unique_ptr<ObjectSink> objects;
+	std::unique_ptr<ExporterSink> exporter;
+	std::unique_ptr<AsyncFileWriter> file_writer;
+	std::unique_ptr<PcapngWriter> pcapng_writer;
+	std::unique_ptr<ReorderSink> reorder;
+	std::unique_ptr<TracingSink> tracing;
+	std::unique_ptr<PcapWriter> pcap_writer;
+	std::unique_ptr<JobOutputs> jobs;
+	std::ofstream outfile;
 
-void set_header_flags(uint16_t frameState, uint8_t& headerFlags)
-{
-	if (HAS_FLAG(frameState, 0))
-	{
-		headerFlags |= 0x08; // Payload preample indicator bit set to 1
+	if (jobsarg) {
+		try {
+			std::vector<pcapng_exporter::channel_mapping> mappings;
+			if (maparg) {
+				mappings = load_channel_map(args::get(maparg));
+			}
+			jobs = std::make_unique<JobOutputs>(args::get(jobsarg), mappings);
+		}
+		catch (std::exception& e) {
+			std::cerr << "Invalid jobs: " << e.what() << std::endl;
+			return 1;
+		}
 	}
-	if (HAS_FLAG(frameState, 1))
-	{
-		headerFlags |= 0x02; // Sync. frame indicator bit set to 1
+	else if (!outarg) {
+		// Only the summary, signals or statistics are written
+		objects = std::make_unique<NullSink>();
 	}
-	if (HAS_FLAG(frameState, 2))
-	{
-		headerFlags |= 0x10; // Reserved bit set to 1
+	else if (format == "columnar") {
+		outfile.open(args::get(outarg), std::ios_base::out | std::ios_base::binary);
+		if (!outfile.is_open()) {
+			fprintf(stderr, "Unable to open: %s\n", args::get(outarg).c_str());
+			return 1;
+		}
+		objects = std::make_unique<ColumnarSink>([&outfile](const uint8_t* data, size_t length) {
+			outfile.write((const char*)data, length);
+		});
 	}
-	if (!HAS_FLAG(frameState, 3))
-	{
-		headerFlags |= 0x04; // Null frame indicator bit set to 1
+	else if (format == "asc") {
+		// Text is formatted by worker threads and written by the I/O thread
+		try {
+			file_writer = std::make_unique<AsyncFileWriter>(args::get(outarg));
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		file_writer->set_tracer(tracer.get());
+		objects = std::make_unique<AscSink>([&file_writer](const uint8_t* data, size_t length) {
+			file_writer->write(data, length);
+		}, std::max(1u, std::thread::hardware_concurrency()));
 	}
-	if (HAS_FLAG(frameState, 4))
-	{
-		headerFlags |= 0x01; // Startup frame indicator bit set to 1
+	else {
+		PacketSink* sink;
+		if (format == "pcap") {
+			std::string base = args::get(outarg);
+			if (base.size() > 5 && base.compare(base.size() - 5, 5, ".pcap") == 0) {
+				base.resize(base.size() - 5);
+			}
+			pcap_writer = std::make_unique<PcapWriter>(base);
+			if (maparg) {
+				try {
+					for (const auto& mapping : load_channel_map(args::get(maparg))) {
+						pcap_writer->add_mapping(mapping);
+					}
+				}
+				catch (std::runtime_error& e) {
+					std::cerr << e.what() << std::endl;
+					return 1;
+				}
+			}
+			sink = pcap_writer.get();
+		}
+		else if (asyncarg || indexarg || interfacestatsarg) {
+			// Offsets of the seek index are only known when encoding the blocks here
+			try {
+				file_writer = std::make_unique<AsyncFileWriter>(args::get(outarg));
+				file_writer->set_tracer(tracer.get());
+				pcapng_writer = std::make_unique<PcapngWriter>(*file_writer);
+				if (indexarg) {
+					pcapng_writer->set_index_interval(args::get(indexpacketsarg), index_interval_ns);
+				}
+				if (maparg) {
+					for (const auto& mapping : load_channel_map(args::get(maparg))) {
+						pcapng_writer->add_mapping(mapping);
+					}
+				}
+			}
+			catch (std::runtime_error& e) {
+				std::cerr << e.what() << std::endl;
+				return 1;
+			}
+			Vector::BLF::FileStatistics statistics;
+			if (peek_statistics(infile, &statistics)) {
+				file_writer->preallocate(statistics.uncompressedFileSize);
+			}
+			sink = pcapng_writer.get();
+		}
+		else {
+			exporter = std::make_unique<ExporterSink>(args::get(outarg), maparg.Get());
+			sink = exporter.get();
+		}
+		if (tracer) {
+			tracing = std::make_unique<TracingSink>(*sink, *tracer);
+			sink = tracing.get();
+		}
+		if (reorderarg) {
+			reorder = std::make_unique<ReorderSink>(*sink, window_ns, args::get(reorderlimitarg), args::get(reordermemoryarg) << 20);
+			sink = reorder.get();
+		}
+		objects = std::make_unique<PacketEncoder>(*sink, snaplen);
 	}
-}
 
-void set_header_flags_rcv_msg(uint32_t frameFlags, uint8_t& headerFlags)
-{
-	if (!HAS_FLAG(frameFlags, 0))
-	{
-		headerFlags |= 0x04; // Null frame indicator bit set to 1
-	}
-	if (HAS_FLAG(frameFlags, 2))
-	{
-		headerFlags |= 0x02; // Sync. frame indicator bit set to 1
-	}
-	if (HAS_FLAG(frameFlags, 3))
-	{
-		headerFlags |= 0x01; // Startup frame indicator bit set to 1
-	}
-	if (HAS_FLAG(frameFlags, 4))
-	{
-		headerFlags |= 0x08; // Payload preample indicator bit set to 1
-	}
-	if (HAS_FLAG(frameFlags, 5))
-	{
-		headerFlags |= 0x10; // Reserved bit set to 1
-	}
-}
+	ObjectSink* first = jobs ? &jobs->sink() : objects.get();
 
-void set_header(uint64_t& header, uint8_t headerFlags, uint64_t payloadLength, uint8_t cycleCount = 0, uint16_t frameId = 0, uint16_t headerCrc = 0)
-{
-	header = (static_cast<uint64_t>(headerFlags) << 35) | (static_cast<uint64_t>(payloadLength & 0x7F) << 17);
-	if (cycleCount != 0)
-	{
-		header |= static_cast<uint64_t>(cycleCount & 0x3F);
+	std::unique_ptr<DecimationSink> decimation;
+	if (args::get(keepeveryarg) > 1 || args::get(maxratearg) > 0) {
+		decimation = std::make_unique<DecimationSink>(*first, args::get(keepeveryarg), args::get(maxratearg));
+		first = decimation.get();
 	}
-	if (frameId != 0)
-	{
-		header |= (static_cast<uint64_t>(frameId & 0x07FF) << 24);
-	}
-	if (headerCrc != 0)
-	{
-		header |= (static_cast<uint64_t>(headerCrc & 0x07FF) << 6);
-	}
-
-	// Convert from Host Byte Order to Network Byte Order (network order is big endian)
-	header = hton64(header);
-}
 
-// FLEXRAY_DATA = 29
-void write(pcapng_exporter::PcapngExporter exporter, FlexRayData* obj, uint64_t date_offset_ns) {
-
-	uint64_t header = 0;
-	uint8_t headerFlags = 0;
-	std::array<uint8_t, 261> flexrayData;
-
-	memset(&flexrayData, 0, sizeof(flexrayData));
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame);
-
-	/// Error Flags Information (1 byte) -> set to 0
-
-	/// FlexRay Frame Header (5 bytes)
-	//  - Header flags
-	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
-	//  - Payload length
-	uint64_t len = obj->dataBytes.size() / 2;
-	set_header(header, headerFlags, len, 0, obj->messageId, obj->crc);
-
-	// Copy only 5 bytes of header to flexrayData
-	uint8_t* headerPtr = (uint8_t*)&header;
-	memcpy(&flexrayData[2], headerPtr + 3, 5);
-
-	// FlexRay Frame Payload (0-254 bytes)
-	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
-
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
-}
-
-// FLEXRAY_SYNC = 30
-void write(pcapng_exporter::PcapngExporter exporter, FlexRaySync* obj, uint64_t date_offset_ns) {
-
-	uint64_t header = 0;
-	uint8_t headerFlags = 0;
-	std::array<uint8_t, 261> flexrayData;
-
-	memset(&flexrayData, 0, sizeof(flexrayData));
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame);
-
-	/// Error Flags Information (1 byte) -> set to 0
-
-	/// FlexRay Frame Header (5 bytes)
-	//  - Header flags
-	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
-	headerFlags |= 0x02; // Sync. frame indicator bit set to 1
-
-	/// FlexRay Frame Header (5 bytes)
-	//  - Payload length
-	uint64_t len = obj->dataBytes.size() / 2;
-	set_header(header, headerFlags, len, obj->cycle, obj->messageId, obj->crc);
-
-	// Copy only 5 bytes of header to flexrayData
-	uint8_t* headerPtr = (uint8_t*)&header;
-	memcpy(&flexrayData[2], headerPtr + 3, 5);
-
-	// FlexRay Frame Payload (0-254 bytes)
-	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
-
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
-}
-
-// FLEXRAY_CYCLE = 40
-void write(pcapng_exporter::PcapngExporter exporter, FlexRayV6StartCycleEvent* obj, uint64_t date_offset_ns) {
-
-	uint64_t header = 0;
-	uint8_t headerFlags = 0;
-	std::array<uint8_t, 261> flexrayData;
-
-	memset(&flexrayData, 0, sizeof(flexrayData));
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame);
-
-	/// Error Flags Information (1 byte) -> set to 0
-
-	/// FlexRay Frame Header (5 bytes)
-	//  - Header flags
-	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
-	//  - Payload length
-	uint64_t len = obj->dataBytes.size() / 2;
-	set_header(header, headerFlags, len);
-
-	// Copy only 5 bytes of header to flexrayData
-	uint8_t* headerPtr = (uint8_t*)&header;
-	memcpy(&flexrayData[2], headerPtr + 3, 5);
-
-	// FlexRay Frame Payload (0-254 bytes)
-	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
-
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
-}
-
-// FLEXRAY_MESSAGE = 41
-void write(pcapng_exporter::PcapngExporter exporter, FlexRayV6Message* obj, uint64_t date_offset_ns) {
-
-	uint64_t header = 0;
-	uint8_t headerFlags = 0;
-	std::array<uint8_t, 261> flexrayData;
-
-	memset(&flexrayData, 0, sizeof(flexrayData));
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame);
-
-	/// Error Flags Information (1 byte) -> set to 0
-
-	/// FlexRay Frame Header (5 bytes)
-	set_header_flags(obj->frameState, headerFlags);
-	uint64_t len = obj->dataBytes.size() / 2;
-	set_header(header, headerFlags, len, obj->cycle, obj->frameId, obj->headerCrc);
-
-	// Copy only 5 bytes of header to flexrayData
-	uint8_t* headerPtr = (uint8_t*)&header;
-	memcpy(&flexrayData[2], headerPtr + 3, 5);
-
-	// FlexRay Frame Payload (0-254 bytes)
-	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
-
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
-}
-
-// FR_ERROR = 47
-void write(pcapng_exporter::PcapngExporter exporter, FlexRayVFrError* obj, uint64_t date_offset_ns) {
-
-	uint64_t header = 0;
-	uint8_t headerFlags = 0;
-	std::array<uint8_t, 7> flexrayData;
-
-	memset(&flexrayData, 0, sizeof(flexrayData));
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame, obj->channelMask);
-
-	/// Error Flags Information (1 byte)
-	flexrayData[1] |= 0x02; // Coding error bit (CODERR) set to 1
-
-	/// FlexRay Frame Header (5 bytes)
-	//  - Header flags
-	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
-	set_header(header, headerFlags, 0, obj->cycle);
-
-	// Copy only 5 bytes of header to flexrayData
-	uint8_t* headerPtr = (uint8_t*)&header;
-	memcpy(&flexrayData[2], headerPtr + 3, 5);
-
-	/// FlexRay Frame Payload (0-254 bytes) -> no payload
-
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, 7, flexrayData.data(), date_offset_ns);
-}
-
-// FR_STATUS = 48
-void write(pcapng_exporter::PcapngExporter exporter, FlexRayVFrStatus* obj, uint64_t date_offset_ns) {
-
-	std::array<uint8_t, 2> flexraySymbolData;
-
-	memset(&flexraySymbolData, 0, sizeof(flexraySymbolData));
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(flexraySymbolData[0], FlexRayPacketType::FlexRaySymbol, obj->channelMask);
-
-	/// Symbol length (1 byte)
-	if (obj->tag == 3) /* BUSDOCTOR */
-	{
-		flexraySymbolData[1] = obj->data[1] & 0xFF;
-	}
-	if (obj->tag == 5) /* VN-Interface */
-	{
-		flexraySymbolData[1] = obj->data[0] & 0xFF;
+	std::unique_ptr<OnChangeSink> on_change;
+	if (onchangearg) {
+		on_change = std::make_unique<OnChangeSink>(*first, heartbeat_ns);
+		first = on_change.get();
 	}
 
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, 2, flexraySymbolData.data(), date_offset_ns);
-}
-
-// FR_STARTCYCLE = 49
-void write(pcapng_exporter::PcapngExporter exporter, FlexRayVFrStartCycle* obj, uint64_t date_offset_ns) {
-
-	uint64_t header = 0;
-	uint8_t headerFlags = 0;
-	std::array<uint8_t, 19> flexrayData;
-
-	memset(&flexrayData, 0, sizeof(flexrayData));
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame, obj->channelMask);
-
-	/// Error Flags Information (1 byte) -> set to 0
-
-	/// FlexRay Frame Header (5 bytes)
-	//  - Header flags
-	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
-	//  - Payload length
-	uint64_t len = obj->dataBytes.size() / 2;
-	set_header(header, headerFlags, len, obj->cycle);
-
-	// Copy only 5 bytes of header to flexrayData
-	uint8_t* headerPtr = (uint8_t*)&header;
-	memcpy(&flexrayData[2], headerPtr + 3, 5);
-
-	// FlexRay Frame Payload (0-254 bytes)
-	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
-
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
-}
-
-// FR_RCVMESSAGE = 50
-void write(pcapng_exporter::PcapngExporter exporter, FlexRayVFrReceiveMsg* obj, uint64_t date_offset_ns) {
-
-	uint64_t header = 0;
-	uint16_t headerCrc = 0;
-	uint8_t headerFlags = 0;
-	std::array<uint8_t, 261> flexrayData;
-
-	memset(&flexrayData, 0, sizeof(flexrayData));
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame, obj->channelMask);
-
-	/// Error Flags Information (1 byte) -> case Error flag (error frame or invalid frame) set to 1
-	if (HAS_FLAG(obj->frameFlags, 6))
-	{
-		flexrayData[1] |= 0x10; // FCRCERR bit set to 1
+	std::unique_ptr<FilterSink> filter;
+	if (filterarg) {
+		try {
+			filter = std::make_unique<FilterSink>(*first, args::get(filterarg));
+		}
+		catch (std::invalid_argument& e) {
+			std::cerr << "Invalid filter: " << e.what() << std::endl;
+			return 1;
+		}
+		first = filter.get();
 	}
 
-	/// FlexRay Frame Header (5 bytes)
-	//  - Header flags
-	set_header_flags_rcv_msg(obj->frameFlags, headerFlags);
-	// 	- Header CRC
-	set_header_crc(obj->channelMask, obj->headerCrc1, obj->headerCrc2, headerCrc);
-	//  - Payload length
-	uint64_t len = obj->dataBytes.size() / 2;
-	set_header(header, headerFlags, len, obj->cycle, obj->frameId, headerCrc);
-
-	// Copy only 5 bytes of header to flexrayData
-	uint8_t* headerPtr = (uint8_t*)&header;
-	memcpy(&flexrayData[2], headerPtr + 3, 5);
-
-	// FlexRay Frame Payload (0-254 bytes)
-	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
-
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
-}
-
-// FR_RCVMESSAGE_EX = 66
-void write(pcapng_exporter::PcapngExporter exporter, FlexRayVFrReceiveMsgEx* obj, uint64_t date_offset_ns) {
-
-	uint64_t header = 0;
-	uint16_t headerCrc = 0;
-	uint8_t headerFlags = 0;
-	uint8_t measurementHeader = 0;
-	uint8_t errorFlagsInfo = 0;
-	std::vector<uint8_t> flexrayData;
-
-	flexrayData.clear();
-
-	/// Measurement Header (1 byte)
-	set_measurment_header(measurementHeader, FlexRayPacketType::FlexRayFrame, obj->channelMask);
-
-	flexrayData.push_back(measurementHeader);
-
-	/// Error Flags Information (1 byte) -> case Error flag (error frame or invalid frame) set to 1
-	if (HAS_FLAG(obj->frameFlags, 6))
-	{
-		errorFlagsInfo |= 0x10; // FCRCERR bit set to 1
+	// Frames are counted as received before any reduction, those not written count as dropped
+	std::unique_ptr<InterfaceCounterSink> interface_counter;
+	if (interfacestatsarg && pcapng_writer) {
+		interface_counter = std::make_unique<InterfaceCounterSink>(*first);
+		pcapng_writer->set_interface_statistics(&interface_counter->received());
+		first = interface_counter.get();
 	}
-	flexrayData.push_back(errorFlagsInfo);
-
-	/// FlexRay Frame Header (5 bytes)
-	//  - Header flags
-	set_header_flags_rcv_msg(obj->frameFlags, headerFlags);
-	// 	- Header CRC
-	set_header_crc(obj->channelMask, obj->headerCrc1, obj->headerCrc2, headerCrc);
-	//  - Payload length
-	uint64_t len = obj->dataBytes.size() / 2;
-	set_header(header, headerFlags, len, obj->cycle, obj->frameId, headerCrc);
 
-	// Copy only 5 bytes of header to flexrayData
-	uint8_t* headerPtr = (uint8_t*)&header;
-	std::vector<uint8_t> headerVec(headerPtr + 3, headerPtr + 8);
-	flexrayData.insert(flexrayData.end(), headerVec.begin(), headerVec.end());
-
-	// FlexRay Frame Payload (0-254 bytes)
-	flexrayData.insert(flexrayData.end(), obj->dataBytes.begin(), obj->dataBytes.end());
-
-	write_packet(exporter, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
-}
-
-uint64_t calculate_startdate(Vector::BLF::File* infile) {
-	Vector::BLF::SYSTEMTIME startTime;
-	startTime = infile->fileStatistics.measurementStartTime;
-
-	struct tm tms = { 0 };
-	tms.tm_year = startTime.year - 1900;
-	tms.tm_mon = startTime.month - 1;
-	tms.tm_mday = startTime.day;
-	tms.tm_hour = startTime.hour;
-	tms.tm_min = startTime.minute;
-	tms.tm_sec = startTime.second;
-
-	time_t ret = mktime(&tms);
-	if (ret < 0 )
-	{
-		return 0;
+	// Statistics describe the input, so they come before any reduction
+	std::unique_ptr<StatisticsSink> statistics;
+	if (statsarg) {
+		statistics = std::make_unique<StatisticsSink>(*first);
+		first = statistics.get();
 	}
-	
-	ret *= 1000;
-	ret += startTime.milliseconds;
-	ret *= 1000 * 1000;
-
-	return ret;
-}
 
-template<class LinErrorBase>
-int write_lin_error(
-	pcapng_exporter::PcapngExporter writer,
-	LinErrorBase* lerr,
-	std::uint8_t errors,
-	uint64_t date_offset_ns)
-{
-	pcapng_exporter::frame_header header = generate_header(lerr, date_offset_ns);
-	if (header.timestamp_resolution == 0) return -3;
-	lin_frame frame = lin_frame();
-	frame.errors = errors;
-	writer.write_lin(header, frame);
-	return 0;
-}
+	std::unique_ptr<SummarySink> summary;
+	if (summaryarg) {
+		summary = std::make_unique<SummarySink>(*first);
+		first = summary.get();
+	}
 
-template<class LinMessageBase>
-int write_lin_message(
-	pcapng_exporter::PcapngExporter writer,
-	LinMessageBase* msg,
-	uint64_t date_offset_ns)
-{
-	pcapng_exporter::frame_header header = generate_header(msg, date_offset_ns);
-	if (header.timestamp_resolution == 0) return -3;
-	lin_frame frame = lin_frame();
-	frame.pid = msg->id;
-	frame.payload_length = (std::uint8_t)(msg->data.size());
-	memcpy(frame.data, &(msg->data), frame.payload_length);
-	frame.checksum = msg->crc;
-	writer.write_lin(header, frame);
-	return 0;
-}
+	std::ofstream signals_file;
+	std::unique_ptr<SignalSink> signals;
+	if (signalsarg) {
+		signals_file.open(args::get(signalsarg), std::ios_base::out | std::ios_base::binary);
+		if (!signals_file.is_open()) {
+			fprintf(stderr, "Unable to open: %s\n", args::get(signalsarg).c_str());
+			return 1;
+		}
+		signals = std::make_unique<SignalSink>(*first, [&signals_file](const uint8_t* data, size_t length) {
+			signals_file.write((const char*)data, length);
+		});
+		try {
+			for (const auto& item : args::get(dbcarg)) {
+				size_t eq = item.find('=');
+				std::string selector = eq == std::string::npos ? "" : item.substr(0, eq);
+				std::string path = eq == std::string::npos ? item : item.substr(eq + 1);
+				signals->add_database(selector, std::make_shared<dbc_database>(load_dbc(path)));
+			}
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+		first = signals.get();
+	}
 
-int main(int argc, char* argv[]) {
-	args::ArgumentParser parser("This tool is intended for converting BLF files to plain PCAPNG files.");
-	parser.helpParams.showTerminator = false;
-	parser.helpParams.proglineShowFlags = true;
+	Converter converter(*first);
+	converter.set_tracer(tracer.get());
 
-	args::HelpFlag help(parser, "help", "", { 'h', "help" }, args::Options::HiddenFromUsage);
-	args::ValueFlag<std::string> maparg(parser, "map-file", "Configuration file for channel mapping", { "channel-map" });
+	// A cached copy is read instead of the input, otherwise the inflated containers are cached
+	std::unique_ptr<ContainerCache> cache;
+	std::unique_ptr<MappedFile> cached;
+	std::unique_ptr<CacheEntryWriter> cache_entry;
+	if (cachearg) {
+		try {
+			cache = std::make_unique<ContainerCache>(args::get(cachearg), args::get(cachesizearg) << 20);
+			cached = cache->find(args::get(inarg));
+			if (cached) {
+				std::cerr << "Reading the cached copy of the input, " << cached->size() << " bytes" << std::endl;
+			}
+			else {
+				cache_entry = cache->create(args::get(inarg));
+				converter.set_container_callback([&cache_entry](const uint8_t* data, size_t length) {
+					cache_entry->add_container(data, length);
+				});
+			}
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << "Not using the cache: " << e.what() << std::endl;
+		}
+	}
 
-	args::Positional<std::string> inarg(parser, "infile", "Input File", args::Options::Required);
-	args::Positional<std::string> outarg(parser, "outfile", "Output File", args::Options::Required);
+	// Only packet outputs use the channel names. Compressed input cannot be
+	// rewound, channel names apply from where they are found.
+	if (prescanarg && (outarg || jobsarg) && format != "columnar" && format != "asc" && wrapper == input_wrapper::none) {
+		if (cached) {
+			converter.prescan(cached->data(), cached->size());
+		}
+		else {
+			converter.prescan(infile);
+		}
+	}
 
-	try
-	{
-		parser.ParseCLI(argc, argv);
+	/* convert and capture exceptions, e.g. unfinished files */
+	try {
+		if (cached) {
+			converter.push(cached->data(), cached->size());
+			converter.end_file();
+			converter.finish();
+		}
+		else if (sequencearg) {
+			std::vector<std::string> files = find_sequence(args::get(inarg));
+			std::cerr << "Converting " << files.size() << " files as one recording" << std::endl;
+			convert_sequence(converter, files, [](const std::string& file, const std::exception& e) {
+				std::cout << "Exception: " << file << ": " << e.what() << std::endl;
+			});
+		}
+		else if (wrapper != input_wrapper::none) {
+			convert_compressed(converter, args::get(inarg), wrapper, [](const std::string& file, const std::exception& e) {
+				std::cout << "Exception: " << file << ": " << e.what() << std::endl;
+			});
+		}
+		else {
+			converter.convert(infile);
+		}
 	}
-	catch (args::Help)
-	{
-		std::cout << parser;
-		return 0;
+	catch (std::runtime_error& e) {
+		std::cout << "Exception: " << e.what() << std::endl;
+		converter.finish();
+		// Only complete files are cached
+		cache_entry.reset();
 	}
-	catch (args::Error e)
-	{
-		std::cerr << e.what() << std::endl;
-		std::cerr << parser;
-		return 1;
+
+	if (cache_entry) {
+		try {
+			cache_entry->commit();
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << "Not using the cache: " << e.what() << std::endl;
+		}
 	}
 
-	Vector::BLF::File infile;
-	infile.open(args::get(inarg));
-	if (!infile.is_open()) {
-		fprintf(stderr, "Unable to open: %s\n", argv[1]);
-		return 1;
+	if (statistics) {
+		const std::string& path = args::get(statsarg);
+		std::ofstream report(path);
+		if (!report.is_open()) {
+			fprintf(stderr, "Unable to open: %s\n", path.c_str());
+			return 1;
+		}
+		bool csv = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+		if (csv) {
+			statistics->write_csv(report);
+		}
+		else {
+			statistics->write_json(report);
+		}
 	}
-	pcapng_exporter::PcapngExporter exporter = pcapng_exporter::PcapngExporter(args::get(outarg), maparg.Get());
 
-	uint64_t startDate_ns = calculate_startdate(&infile);
+	if (signals) {
+		signals_file.close();
+		if (!signals_file) {
+			fprintf(stderr, "Unable to write: %s\n", args::get(signalsarg).c_str());
+			return 1;
+		}
+		std::cerr << "Decoded " << signals->samples() << " signal values" << std::endl;
+	}
 
-	while (infile.good()) {
-		ObjectHeaderBase* ohb = nullptr;
+	if (summary) {
+		const std::string& path = args::get(summaryarg);
+		std::ofstream out(path);
+		if (!out.is_open()) {
+			fprintf(stderr, "Unable to open: %s\n", path.c_str());
+			return 1;
+		}
+		std::error_code ec;
+		std::filesystem::path input = std::filesystem::absolute(args::get(inarg), ec);
+		summary->write_json(out, ec ? args::get(inarg) : input.string());
+	}
 
-		/* read and capture exceptions, e.g. unfinished files */
+	if (jobs) {
 		try {
-			ohb = infile.read();
+			jobs->close();
 		}
 		catch (std::runtime_error& e) {
-			std::cout << "Exception: " << e.what() << std::endl;
-		}
-		if (ohb == nullptr) {
-			break;
+			std::cerr << e.what() << std::endl;
+			return 1;
 		}
-		/* Object */
-		std::uint8_t errors = 0;
-		switch (ohb->objectType) {
-
-		case ObjectType::CAN_MESSAGE:
-			write(exporter, reinterpret_cast<CanMessage*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::CAN_ERROR:
-			write(exporter, reinterpret_cast<CanErrorFrame*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::CAN_FD_MESSAGE:
-			write(exporter, reinterpret_cast<CanFdMessage*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::CAN_FD_MESSAGE_64:
-			write(exporter, reinterpret_cast<CanFdMessage64*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::CAN_FD_ERROR_64:
-			write(exporter, reinterpret_cast<CanFdErrorFrame64*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::ETHERNET_FRAME:
-			write(exporter, reinterpret_cast<EthernetFrame*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::CAN_ERROR_EXT:
-			write(exporter, reinterpret_cast<CanErrorFrameExt*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::CAN_MESSAGE2:
-			write(exporter, reinterpret_cast<CanMessage2*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::ETHERNET_FRAME_EX:
-			write(exporter, reinterpret_cast<EthernetFrameEx*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::ETHERNET_FRAME_FORWARDED:
-			write(exporter, reinterpret_cast<EthernetFrameForwarded*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FLEXRAY_DATA:
-			write(exporter, reinterpret_cast<FlexRayData*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FLEXRAY_SYNC:
-			write(exporter, reinterpret_cast<FlexRaySync*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FLEXRAY_CYCLE:
-			write(exporter, reinterpret_cast<FlexRayV6StartCycleEvent*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FLEXRAY_MESSAGE:
-			write(exporter, reinterpret_cast<FlexRayV6Message*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FLEXRAY_STATUS:
-			// We do not have reliable BLF file or clear documentation for this type
-			break;
-
-		case ObjectType::FR_ERROR:
-			write(exporter, reinterpret_cast<FlexRayVFrError*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FR_STATUS:
-			write(exporter, reinterpret_cast<FlexRayVFrStatus*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FR_STARTCYCLE:
-			write(exporter, reinterpret_cast<FlexRayVFrStartCycle*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FR_RCVMESSAGE:
-			write(exporter, reinterpret_cast<FlexRayVFrReceiveMsg*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::FR_RCVMESSAGE_EX:
-			write(exporter, reinterpret_cast<FlexRayVFrReceiveMsgEx*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::APP_TEXT:
-			configure_channels(&exporter, reinterpret_cast<AppText*>(ohb));
-			break;
-
-		case ObjectType::LIN_MESSAGE:
-			write_lin_message(exporter, reinterpret_cast<LinMessage*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::LIN_MESSAGE2:
-			write_lin_message(exporter, reinterpret_cast<LinMessage2*>(ohb), startDate_ns);
-			break;
-
-		case ObjectType::LIN_CRC_ERROR:
-			errors = LIN_ERROR_CHECKSUM;
-			write_lin_error(exporter, reinterpret_cast<LinCrcError*>(ohb), errors, startDate_ns);
-			break;
-
-		case ObjectType::LIN_CRC_ERROR2:
-			errors = LIN_ERROR_CHECKSUM;
-			write_lin_error(exporter, reinterpret_cast<LinCrcError2*>(ohb), errors, startDate_ns);
-			break;
-
-		case ObjectType::LIN_RCV_ERROR:
-			errors = LIN_ERROR_FRAMING;
-			write_lin_error(exporter, reinterpret_cast<LinReceiveError*>(ohb), errors, startDate_ns);
-			break;
-
-		case ObjectType::LIN_RCV_ERROR2:
-			errors = LIN_ERROR_FRAMING;
-			write_lin_error(exporter, reinterpret_cast<LinReceiveError2*>(ohb), errors, startDate_ns);
-			break;
+	}
 
-		case ObjectType::LIN_SLV_TIMEOUT:
-			errors = LIN_ERROR_NOSLAVE;
-			write_lin_error(exporter, reinterpret_cast<LinSlaveTimeout*>(ohb), errors, startDate_ns);
-			break;
+	if (pcap_writer) {
+		try {
+			pcap_writer->close();
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
 
-		case ObjectType::LIN_SND_ERROR:
-			errors = LIN_ERROR_FRAMING;
-			write_lin_error(exporter, reinterpret_cast<LinSendError*>(ohb), errors, startDate_ns);
-			break;
+	if (file_writer) {
+		try {
+			file_writer->close();
+		}
+		catch (std::runtime_error& e) {
+			std::cerr << e.what() << std::endl;
+			return 1;
+		}
+	}
 
-		case ObjectType::LIN_SND_ERROR2:
-			errors = LIN_ERROR_FRAMING;
-			write_lin_error(exporter, reinterpret_cast<LinSendError2*>(ohb), errors, startDate_ns);
-			break;
+	if (indexarg) {
+		std::ofstream index(args::get(indexarg), std::ios_base::out | std::ios_base::binary);
+		if (!index.is_open()) {
+			fprintf(stderr, "Unable to open: %s\n", args::get(indexarg).c_str());
+			return 1;
+		}
+		write_seek_index(index, pcapng_writer->index());
+	}
 
-		case ObjectType::LIN_SYN_ERROR:
-			errors = LIN_ERROR_FRAMING;
-			write_lin_error(exporter, reinterpret_cast<LinSyncError*>(ohb), errors, startDate_ns);
-			break;
+	if (tracer) {
+		std::ofstream trace(args::get(tracearg));
+		if (!trace.is_open()) {
+			fprintf(stderr, "Unable to open: %s\n", args::get(tracearg).c_str());
+			return 1;
+		}
+		tracer->write_json(trace);
+	}
 
-		case ObjectType::LIN_SYN_ERROR2:
-			errors = LIN_ERROR_FRAMING;
-			write_lin_error(exporter, reinterpret_cast<LinSyncError2*>(ohb), errors, startDate_ns);
-			break;
+	if (filter) {
+		std::cerr << "Filtered out " << filter->dropped() << " frames" << std::endl;
+	}
 
-		default:
-#ifdef DEBUG
-			std::cerr << (std::uint32_t)(ohb->objectType) << " is not implemented." << std::endl;
-#endif
-			break;
+	if (on_change) {
+		std::cerr << "Skipped " << on_change->unchanged() << " unchanged frames" << std::endl;
+	}
 
-		}
+	if (decimation) {
+		std::cerr << "Dropped " << decimation->dropped_by_count() << " frames by --keep-every and "
+			<< decimation->dropped_by_rate() << " by --max-rate" << std::endl;
+	}
 
-		/* delete object */
-		delete ohb;
+	if (reorder && reorder->stragglers() > 0) {
+		std::cerr << reorder->stragglers() << " packets arrived outside of the reorder window" << std::endl;
 	}
-	infile.close();
 	return 0;
 }
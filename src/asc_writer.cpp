@@ -0,0 +1,439 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "asc_writer.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+
+#include <pcapng_exporter/lin.h>
+#include <pcapng_exporter/linktype.h>
+
+#include "converter.hpp"
+
+#define NANOS_PER_SEC 1000000000
+#define SECONDS_PER_DAY 86400
+#define MAX_BATCH_BYTES (8 << 20)
+// Upper bound of a line without its data bytes
+#define MAX_LINE_OVERHEAD 256
+
+// Flags column of CAN FD lines
+#define ASC_CANFD_EDL 0x1000
+#define ASC_CANFD_BRS 0x2000
+#define ASC_CANFD_ESI 0x4000
+
+namespace blf_converter {
+
+static const char HEX_DIGITS[] = "0123456789ABCDEF";
+
+static char* put(char* p, const char* s, size_t length) {
+	memcpy(p, s, length);
+	return p + length;
+}
+
+template<size_t N>
+static char* put(char* p, const char (&s)[N]) {
+	return put(p, s, N - 1);
+}
+
+static char* put_spaces(char* p, size_t count) {
+	memset(p, ' ', count);
+	return p + count;
+}
+
+// Pads the field starting at start with spaces to width
+static char* pad(char* p, const char* start, size_t width) {
+	size_t length = (size_t)(p - start);
+	return length < width ? put_spaces(p, width - length) : p;
+}
+
+static char* put_decimal(char* p, uint64_t value) {
+	return std::to_chars(p, p + 20, value).ptr;
+}
+
+// Upper case, without leading zeros
+static char* put_hex(char* p, uint32_t value) {
+	char digits[8];
+	int count = 0;
+	do {
+		digits[count++] = HEX_DIGITS[value & 0xF];
+		value >>= 4;
+	} while (value);
+	while (count) {
+		*p++ = digits[--count];
+	}
+	return p;
+}
+
+static char* put_hex_byte(char* p, uint8_t value) {
+	p[0] = HEX_DIGITS[value >> 4];
+	p[1] = HEX_DIGITS[value & 0xF];
+	return p + 2;
+}
+
+static char* put_right_decimal(char* p, uint64_t value, size_t width) {
+	char digits[20];
+	char* end = put_decimal(digits, value);
+	size_t length = (size_t)(end - digits);
+	if (length < width) {
+		p = put_spaces(p, width - length);
+	}
+	return put(p, digits, length);
+}
+
+// Bytes separated by spaces, each preceded by one
+static char* put_bytes(char* p, const uint8_t* data, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		*p++ = ' ';
+		p = put_hex_byte(p, data[i]);
+	}
+	return p;
+}
+
+// Seconds with microseconds, right aligned to 11 characters
+static char* put_time(char* p, uint64_t ns) {
+	uint64_t us = (ns + 500) / 1000;
+	p = put_right_decimal(p, us / 1000000, 4);
+	*p++ = '.';
+	uint32_t fraction = (uint32_t)(us % 1000000);
+	for (int i = 5; i >= 0; i--) {
+		p[i] = (char)('0' + fraction % 10);
+		fraction /= 10;
+	}
+	return p + 6;
+}
+
+static char* put_two_digits(char* p, uint32_t value) {
+	p[0] = (char)('0' + value / 10 % 10);
+	p[1] = (char)('0' + value % 10);
+	return p + 2;
+}
+
+// "Wed Jan 01 09:30:00.000 am 2020" of the local time fields from local_clock_ns
+static char* put_date(char* p, uint64_t ns) {
+	static const char* const weekdays[] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+	static const char* const months[] = { "Jan", "Feb", "Mar", "Apr", "May", "Jun", "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+	uint64_t seconds = ns / NANOS_PER_SEC;
+	uint32_t millis = (uint32_t)(ns / 1000000 % 1000);
+	int64_t days = (int64_t)(seconds / SECONDS_PER_DAY);
+	uint32_t time = (uint32_t)(seconds % SECONDS_PER_DAY);
+
+	// Civil date of days since 1970-01-01, see http://howardhinnant.github.io/date_algorithms.html
+	int64_t z = days + 719468;
+	int64_t era = z / 146097;
+	int64_t day_of_era = z - era * 146097;
+	int64_t year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	int64_t day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	int64_t mp = (5 * day_of_year + 2) / 153;
+	uint32_t day = (uint32_t)(day_of_year - (153 * mp + 2) / 5 + 1);
+	uint32_t month = (uint32_t)(mp < 10 ? mp + 3 : mp - 9);
+	int64_t year = year_of_era + era * 400 + (month <= 2);
+
+	uint32_t hour = time / 3600;
+	p = put(p, weekdays[(days + 4) % 7], 3);
+	*p++ = ' ';
+	p = put(p, months[month - 1], 3);
+	*p++ = ' ';
+	p = put_two_digits(p, day);
+	*p++ = ' ';
+	p = put_two_digits(p, hour % 12 == 0 ? 12 : hour % 12);
+	*p++ = ':';
+	p = put_two_digits(p, time / 60 % 60);
+	*p++ = ':';
+	p = put_two_digits(p, time % 60);
+	*p++ = '.';
+	p = put_two_digits(p, millis / 10);
+	*p++ = (char)('0' + millis % 10);
+	p = put(p, hour < 12 ? " am " : " pm ", 4);
+	return put_decimal(p, (uint64_t)year);
+}
+
+static char* put_direction(char* p, uint32_t flags) {
+	return put(p, flags & FRAME_FLAG_TX ? "Tx" : "Rx", 2);
+}
+
+static char* put_can_id(char* p, uint32_t id, uint32_t flags) {
+	p = put_hex(p, id);
+	if (flags & FRAME_FLAG_EXT) {
+		*p++ = 'x';
+	}
+	return p;
+}
+
+AscSink::AscSink(block_callback on_text, size_t threads, size_t batch_frames)
+	: on_text(std::move(on_text)),
+	batch_frames(batch_frames > 0 ? batch_frames : 1),
+	max_pending(2 * threads)
+{
+	if (threads > 0) {
+		pool = std::make_unique<WorkerPool>(threads, threads);
+	}
+}
+
+void AscSink::write_header(uint64_t date_ns) {
+	char header[256];
+	char* p = header;
+	p = put(p, "date ");
+	p = put_date(p, date_ns);
+	p = put(p, "\nbase hex  timestamps absolute\ninternal events logged\n// version 13.0.0\nBegin Triggerblock ");
+	p = put_date(p, date_ns);
+	p = put(p, "\n   0.000000 Start of measurement\n");
+	on_text((const uint8_t*)header, (size_t)(p - header));
+}
+
+void AscSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (!make_frame_view(ohb, date_offset_ns, &view)) {
+		return;
+	}
+	if (!started) {
+		started = true;
+		start_ns = date_offset_ns & 0x7fffffffffffffff;
+		// The date is written as the local time of the BLF header, not as UTC
+		write_header(local_clock_ns(start_ns));
+	}
+	if (view.link_type == LINKTYPE_FLEXRAY && view.flags & (FRAME_FLAG_STATUS | FRAME_FLAG_ERROR)) {
+		// Not frames, written as slot 0 messages they would pass for real ones
+		return;
+	}
+	if (!current) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (free_batches.empty()) {
+			current = std::make_unique<batch>();
+			current->frames.reserve(batch_frames);
+		}
+		else {
+			current = std::move(free_batches.back());
+			free_batches.pop_back();
+		}
+	}
+
+	frame_record record;
+	record.time_ns = view.timestamp_ns;
+	record.id = view.id;
+	record.flags = view.flags;
+	record.channel = view.channel;
+	record.offset = (uint32_t)current->bytes.size();
+	record.length = view.header_length + view.data_length;
+	record.link_type = view.link_type;
+	record.dlc = view.dlc;
+	record.cycle = view.cycle;
+	record.lin_errors = view.lin_errors;
+	current->frames.push_back(record);
+	current->bytes.insert(current->bytes.end(), view.header, view.header + view.header_length);
+	current->bytes.insert(current->bytes.end(), view.data, view.data + view.data_length);
+
+	if (current->frames.size() >= batch_frames || current->bytes.size() >= MAX_BATCH_BYTES) {
+		dispatch();
+	}
+}
+
+void AscSink::dispatch() {
+	batch* b = current.get();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.push_back(std::move(current));
+	}
+	uint64_t start = start_ns;
+	if (pool) {
+		pool->submit([this, b, start] {
+			format(*b, start);
+			std::lock_guard<std::mutex> lock(mutex);
+			b->done = true;
+			formatted.notify_all();
+		});
+	}
+	else {
+		format(*b, start);
+		b->done = true;
+	}
+	write_formatted(false);
+}
+
+// Hands the text of formatted batches to on_text in order. Waits for the oldest
+// batch when too many are pending, or for all of them.
+void AscSink::write_formatted(bool wait_all) {
+	for (;;) {
+		std::unique_ptr<batch> b;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (pending.empty()) {
+				return;
+			}
+			if (!pending.front()->done) {
+				if (!wait_all && pending.size() <= max_pending) {
+					return;
+				}
+				formatted.wait(lock, [this] { return pending.front()->done; });
+			}
+			b = std::move(pending.front());
+			pending.pop_front();
+		}
+		on_text((const uint8_t*)b->text.data(), b->text_length);
+		b->frames.clear();
+		b->bytes.clear();
+		b->text_length = 0;
+		b->done = false;
+		std::lock_guard<std::mutex> lock(mutex);
+		free_batches.push_back(std::move(b));
+	}
+}
+
+void AscSink::flush() {
+	if (!started) {
+		started = true;
+		write_header(0);
+	}
+	if (current && !current->frames.empty()) {
+		dispatch();
+	}
+	write_formatted(true);
+	static const char footer[] = "End TriggerBlock\n";
+	on_text((const uint8_t*)footer, sizeof(footer) - 1);
+}
+
+void AscSink::format(batch& b, uint64_t start_ns) {
+	// Grown once to the longest text so far, then reused
+	size_t needed = 0;
+	for (const auto& f : b.frames) {
+		needed += MAX_LINE_OVERHEAD + 3 * (size_t)f.length;
+	}
+	if (b.text.size() < needed) {
+		b.text.resize(needed);
+	}
+
+	char* p = b.text.data();
+	for (const auto& f : b.frames) {
+		const uint8_t* data = b.bytes.data() + f.offset;
+		p = put_time(p, f.time_ns >= start_ns ? f.time_ns - start_ns : 0);
+		*p++ = ' ';
+		switch (f.link_type) {
+		case LINKTYPE_CAN:
+			if (f.flags & FRAME_FLAG_ERROR && f.flags & FRAME_FLAG_FDF) {
+				p = put(p, "CANFD ");
+				p = put_right_decimal(p, f.channel, 3);
+				*p++ = ' ';
+				p = put_direction(p, f.flags);
+				p = put(p, "   ErrorFrame");
+			}
+			else if (f.flags & FRAME_FLAG_ERROR) {
+				p = put_decimal(p, f.channel);
+				p = put(p, "  ErrorFrame");
+			}
+			else if (f.flags & FRAME_FLAG_FDF) {
+				p = put(p, "CANFD ");
+				p = put_right_decimal(p, f.channel, 3);
+				*p++ = ' ';
+				p = put_direction(p, f.flags);
+				p = put(p, "   ");
+				char id[9];
+				char* id_end = put_can_id(id, f.id, f.flags);
+				p = put_spaces(p, 8 - std::min<size_t>(8, (size_t)(id_end - id)));
+				p = put(p, id, (size_t)(id_end - id));
+				// No symbolic name
+				p = put_spaces(p, 2 + 32 + 1);
+				*p++ = f.flags & FRAME_FLAG_BRS ? '1' : '0';
+				*p++ = ' ';
+				*p++ = f.flags & FRAME_FLAG_ESI ? '1' : '0';
+				*p++ = ' ';
+				p = put_hex(p, f.dlc);
+				*p++ = ' ';
+				p = put_right_decimal(p, f.length, 2);
+				p = put_bytes(p, data, f.length);
+				// Message duration and length
+				p = put(p, "        0    0 ");
+				uint32_t flags = ASC_CANFD_EDL;
+				if (f.flags & FRAME_FLAG_BRS) flags |= ASC_CANFD_BRS;
+				if (f.flags & FRAME_FLAG_ESI) flags |= ASC_CANFD_ESI;
+				p = put(p, "    ");
+				p = put_hex(p, flags);
+				// CRC and bit timings
+				p = put(p, "        0        0        0        0        0");
+			}
+			else {
+				p = put_decimal(p, f.channel);
+				p = put(p, "  ");
+				char* start = p;
+				p = put_can_id(p, f.id, f.flags);
+				p = pad(p, start, 15);
+				*p++ = ' ';
+				p = put_direction(p, f.flags);
+				p = put(p, "   ");
+				if (f.flags & FRAME_FLAG_RTR) {
+					p = put(p, "r ");
+					p = put_hex(p, f.dlc);
+				}
+				else {
+					p = put(p, "d ");
+					p = put_hex(p, f.dlc);
+					p = put_bytes(p, data, std::min<size_t>(f.length, std::min<size_t>(f.dlc, 8)));
+				}
+			}
+			break;
+		case LINKTYPE_LIN:
+			p = put(p, "Li");
+			p = put_decimal(p, f.channel);
+			*p++ = ' ';
+			if (f.lin_errors) {
+				if (f.lin_errors & LIN_ERROR_CHECKSUM) {
+					p = put(p, "CSErr ");
+				}
+				else if (f.lin_errors & LIN_ERROR_NOSLAVE) {
+					p = put(p, "TransmErr ");
+				}
+				else {
+					p = put(p, "RcvError ");
+				}
+				p = put_hex(p, f.id);
+			}
+			else {
+				p = put_hex(p, f.id);
+				*p++ = ' ';
+				p = put_direction(p, f.flags);
+				*p++ = ' ';
+				p = put_hex(p, f.dlc);
+				p = put_bytes(p, data, f.length);
+			}
+			break;
+		case LINKTYPE_FLEXRAY:
+			// Channel index, client index, channel, channel mask
+			p = put(p, "Fr RMSG 0 0 ");
+			p = put_decimal(p, f.channel);
+			p = put(p, " 1 ");
+			p = put_decimal(p, f.id);
+			*p++ = ' ';
+			p = put_decimal(p, f.cycle);
+			*p++ = ' ';
+			p = put_direction(p, f.flags);
+			// Application parameter, flags, controller type and data, header CRC, no name
+			p = put(p, " 0 0 0 0 0 x ");
+			p = put_hex(p, f.length);
+			*p++ = ' ';
+			p = put_hex(p, f.length);
+			p = put_bytes(p, data, f.length);
+			// Frame CRC, spy flag, frame length, frame id, PDU offset, reserved
+			p = put(p, " 0 0 0 0 0 0");
+			break;
+		case LINKTYPE_ETHERNET:
+			p = put(p, "ETH ");
+			p = put_decimal(p, f.channel);
+			*p++ = ' ';
+			p = put_direction(p, f.flags);
+			*p++ = ' ';
+			p = put_hex(p, f.length);
+			*p++ = ':';
+			for (uint32_t i = 0; i < f.length; i++) {
+				p = put_hex_byte(p, data[i]);
+			}
+			break;
+		}
+		*p++ = '\n';
+	}
+	b.text_length = (size_t)(p - b.text.data());
+}
+
+}
@@ -0,0 +1,96 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_ASC_WRITER_H
+#define _APP_ASC_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "encoder.hpp"
+#include "frame_view.hpp"
+#include "watch.hpp"
+
+namespace blf_converter {
+
+// Writes bus frames as Vector ASC text with hexadecimal identifiers and data
+// and timestamps relative to the measurement start:
+//
+//   CAN:      <time> <ch>  <id>[x] Rx|Tx d <dlc> <data>, "r <dlc>" for remote frames
+//             <time> <ch>  ErrorFrame
+//   CAN FD:   <time> CANFD <ch> Rx|Tx <id>[x] <brs> <esi> <dlc> <length> <data> ...
+//             <time> CANFD <ch> Rx|Tx ErrorFrame
+//   LIN:      <time> Li<ch> <id> Rx|Tx <dlc> <data>, errors as CSErr, RcvError or TransmErr
+//   FlexRay:  <time> Fr RMSG 0 0 <ch> 1 <slot> <cycle> Rx|Tx ... <length> <length> <data> ...
+//   Ethernet: <time> ETH <ch> Rx|Tx <length>:<frame>
+//
+// Fields that BLF objects do not carry, e.g. CAN FD bit timings, are written as 0.
+// FlexRay status, start of cycle and error events are not written.
+//
+// Frames are copied into batches that worker threads format into text, the
+// text is handed to on_text in frame order. Batches and their text buffers are
+// reused, formatting does not allocate per line.
+class AscSink : public ObjectSink {
+public:
+	using block_callback = std::function<void(const uint8_t* data, size_t length)>;
+
+	// Formats in the calling thread if threads is 0
+	explicit AscSink(block_callback on_text, size_t threads = 0, size_t batch_frames = 16384);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void flush() override;
+
+private:
+	struct frame_record {
+		uint64_t time_ns;
+		uint32_t id;
+		uint32_t flags;
+		uint32_t channel;
+		// Bytes of the frame in the batch, Ethernet header followed by data
+		uint32_t offset;
+		uint32_t length;
+		uint16_t link_type;
+		uint8_t dlc;
+		uint8_t cycle;
+		uint8_t lin_errors;
+	};
+
+	struct batch {
+		std::vector<frame_record> frames;
+		std::vector<uint8_t> bytes;
+		std::vector<char> text;
+		size_t text_length = 0;
+		bool done = false;
+	};
+
+	block_callback on_text;
+	size_t batch_frames;
+	size_t max_pending;
+
+	bool started = false;
+	uint64_t start_ns = 0;
+	std::unique_ptr<batch> current;
+
+	std::mutex mutex;
+	std::condition_variable formatted;
+	std::deque<std::unique_ptr<batch>> pending;
+	std::vector<std::unique_ptr<batch>> free_batches;
+
+	// Declared last, so that running jobs end before the batches go away
+	std::unique_ptr<WorkerPool> pool;
+
+	void write_header(uint64_t date_ns);
+	void dispatch();
+	void write_formatted(bool wait_all);
+	static void format(batch& b, uint64_t start_ns);
+};
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_BLF_FORMAT_H
+#define _APP_BLF_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <Vector/BLF.h>
+
+// On-disk layout of the parts of a BLF file that are parsed without Vector_BLF:
+// the file statistics header and the object headers of the log containers.
+
+#define BLF_FILE_SIGNATURE 0x47474F4C   // "LOGG"
+#define BLF_OBJECT_SIGNATURE 0x4A424F4C // "LOBJ"
+
+#define BLF_FILE_STATISTICS_SIZE 144
+#define BLF_OBJECT_HEADER_BASE_SIZE 16
+#define BLF_LOG_CONTAINER_HEADER_SIZE 32
+
+#define BLF_COMPRESSION_NONE 0
+#define BLF_COMPRESSION_ZLIB 2
+
+namespace blf_converter {
+
+inline uint16_t read_le16(const uint8_t* p) {
+	return (uint16_t)(p[0] | p[1] << 8);
+}
+
+inline uint32_t read_le32(const uint8_t* p) {
+	return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+inline uint64_t read_le64(const uint8_t* p) {
+	return (uint64_t)read_le32(p) | (uint64_t)read_le32(p + 4) << 32;
+}
+
+struct object_header_base {
+	uint32_t signature;
+	uint16_t header_size;
+	uint16_t header_version;
+	uint32_t object_size;
+	uint32_t object_type;
+
+	// Objects are padded to 4 bytes
+	size_t padding() const { return object_size % 4; }
+};
+
+inline object_header_base parse_object_header_base(const uint8_t* p) {
+	object_header_base header;
+	header.signature = read_le32(p);
+	header.header_size = read_le16(p + 4);
+	header.header_version = read_le16(p + 6);
+	header.object_size = read_le32(p + 8);
+	header.object_type = read_le32(p + 12);
+	return header;
+}
+
+struct log_container_header {
+	uint16_t compression_method;
+	uint32_t uncompressed_size;
+};
+
+// p points to the start of the LogContainer object, including its base header
+inline log_container_header parse_log_container_header(const uint8_t* p) {
+	log_container_header header;
+	header.compression_method = read_le16(p + 16);
+	header.uncompressed_size = read_le32(p + 24);
+	return header;
+}
+
+inline Vector::BLF::SYSTEMTIME parse_systemtime(const uint8_t* p) {
+	Vector::BLF::SYSTEMTIME time = {};
+	time.year = read_le16(p);
+	time.month = read_le16(p + 2);
+	time.dayOfWeek = read_le16(p + 4);
+	time.day = read_le16(p + 6);
+	time.hour = read_le16(p + 8);
+	time.minute = read_le16(p + 10);
+	time.second = read_le16(p + 12);
+	time.milliseconds = read_le16(p + 14);
+	return time;
+}
+
+// Parses the file header, length must be at least BLF_FILE_STATISTICS_SIZE
+inline bool parse_file_statistics(const uint8_t* p, size_t length, Vector::BLF::FileStatistics* stats) {
+	if (length < BLF_FILE_STATISTICS_SIZE || read_le32(p) != BLF_FILE_SIGNATURE) {
+		return false;
+	}
+	stats->signature = read_le32(p);
+	stats->statisticsSize = read_le32(p + 4);
+	stats->apiNumber = read_le32(p + 8);
+	stats->applicationId = p[12];
+	stats->compressionLevel = p[13];
+	stats->applicationMajor = p[14];
+	stats->applicationMinor = p[15];
+	stats->fileSize = read_le64(p + 16);
+	stats->uncompressedFileSize = read_le64(p + 24);
+	stats->objectCount = read_le32(p + 32);
+	stats->applicationBuild = read_le32(p + 36);
+	stats->measurementStartTime = parse_systemtime(p + 40);
+	stats->lastObjectTime = parse_systemtime(p + 56);
+	stats->restorePointsOffset = read_le64(p + 72);
+	return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,278 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "blf_reader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include <zlib.h>
+
+#include "blf_format.hpp"
+
+using namespace Vector::BLF;
+
+// Largest compression ratio of deflate
+#define ZLIB_MAX_RATIO 1032
+
+namespace blf_converter {
+
+// Read only view on a decoded object, as expected by Vector_BLF
+class MemoryFile : public AbstractFile {
+public:
+	MemoryFile(const uint8_t* data, size_t size)
+		: data(data), size(size)
+	{
+	}
+
+	std::streamsize gcount() const override {
+		return last_count;
+	}
+
+	void read(char* s, std::streamsize n) override {
+		size_t count = std::min((size_t)n, size - pos);
+		memcpy(s, data + pos, count);
+		pos += count;
+		last_count = (std::streamsize)count;
+		if (count < (size_t)n) {
+			at_eof = true;
+		}
+	}
+
+	std::streampos tellg() override {
+		return (std::streamoff)pos;
+	}
+
+	void seekg(const std::streampos p) override {
+		pos = std::min((size_t)(std::streamoff)p, size);
+	}
+
+	void seekg(const std::streamoff off, const std::ios_base::seekdir way) override {
+		std::streamoff base = 0;
+		if (way == std::ios_base::cur) base = (std::streamoff)pos;
+		if (way == std::ios_base::end) base = (std::streamoff)size;
+		std::streamoff target = std::max((std::streamoff)0, base + off);
+		pos = std::min((size_t)target, size);
+	}
+
+	void write(const char* s, std::streamsize n) override {
+		throw std::runtime_error("Objects are read only");
+	}
+
+	std::streampos tellp() override {
+		return (std::streamoff)pos;
+	}
+
+	bool good() const override {
+		return !at_eof;
+	}
+
+	bool eof() const override {
+		return at_eof;
+	}
+
+private:
+	const uint8_t* data;
+	size_t size;
+	size_t pos = 0;
+	std::streamsize last_count = 0;
+	bool at_eof = false;
+};
+
+BlfReader::BlfReader(object_callback on_object)
+	: on_object(std::move(on_object))
+{
+}
+
+// Parses straight from the caller's buffer when nothing is pending,
+// only the incomplete tail is copied
+template <class Parser>
+static void parse_buffered(std::vector<uint8_t>& pending, const uint8_t* data, size_t length, Parser parse) {
+	if (pending.empty()) {
+		size_t consumed = parse(data, length);
+		pending.assign(data + consumed, data + length);
+	}
+	else {
+		pending.insert(pending.end(), data, data + length);
+		size_t consumed = parse(pending.data(), pending.size());
+		pending.erase(pending.begin(), pending.begin() + consumed);
+	}
+}
+
+void BlfReader::push(const uint8_t* data, size_t length) {
+	size_t skip = std::min(raw_skip, length);
+	raw_skip -= skip;
+	parse_buffered(raw_buffer, data + skip, length - skip, [this](const uint8_t* p, size_t n) {
+		return parse_raw(p, n);
+	});
+}
+
+void BlfReader::push_uncompressed(const uint8_t* data, size_t length) {
+	size_t skip = std::min(object_skip, length);
+	object_skip -= skip;
+	parse_buffered(object_buffer, data + skip, length - skip, [this](const uint8_t* p, size_t n) {
+		return parse_objects(p, n);
+	});
+}
+
+// Trailing zero bytes are padding, anything else is the start of an object
+static bool holds_data(const std::vector<uint8_t>& pending) {
+	return std::any_of(pending.begin(), pending.end(), [](uint8_t b) { return b != 0; });
+}
+
+void BlfReader::end_of_file() {
+	bool truncated = holds_data(raw_buffer) || holds_data(object_buffer);
+	raw_buffer.clear();
+	object_buffer.clear();
+	if (truncated) {
+		throw std::runtime_error("Unexpected end of file within an object");
+	}
+}
+
+void BlfReader::reset() {
+	file_statistics = {};
+	statistics_read = false;
+	raw_buffer.clear();
+	object_buffer.clear();
+	raw_skip = 0;
+	object_skip = 0;
+}
+
+size_t BlfReader::parse_raw(const uint8_t* data, size_t length) {
+	size_t pos = 0;
+	if (!statistics_read) {
+		if (length < 8) {
+			return 0;
+		}
+		if (read_le32(data) != BLF_FILE_SIGNATURE) {
+			throw std::runtime_error("Not a BLF file");
+		}
+		size_t statistics_size = std::max((size_t)read_le32(data + 4), (size_t)BLF_FILE_STATISTICS_SIZE);
+		if (length < statistics_size) {
+			return 0;
+		}
+		parse_file_statistics(data, length, &file_statistics);
+		statistics_read = true;
+		pos = statistics_size;
+	}
+	while (length - pos >= BLF_OBJECT_HEADER_BASE_SIZE) {
+		object_header_base header = parse_object_header_base(data + pos);
+		if (header.signature != BLF_OBJECT_SIGNATURE) {
+			throw std::runtime_error("Unexpected object signature");
+		}
+		if (header.object_size < BLF_OBJECT_HEADER_BASE_SIZE) {
+			throw std::runtime_error("Invalid object size");
+		}
+		if (length - pos < header.object_size) {
+			break;
+		}
+		if (header.object_type == (uint32_t)ObjectType::LOG_CONTAINER) {
+			read_container(data + pos, header.object_size);
+		}
+		pos += header.object_size;
+		size_t padding = std::min(header.padding(), length - pos);
+		raw_skip = header.padding() - padding;
+		pos += padding;
+	}
+	return pos;
+}
+
+const uint8_t* inflate_log_container(const uint8_t* data, size_t length, std::vector<uint8_t>& buffer, size_t* payload_length, Tracer* tracer) {
+	if (length < BLF_LOG_CONTAINER_HEADER_SIZE) {
+		throw std::runtime_error("Invalid log container");
+	}
+	log_container_header header = parse_log_container_header(data);
+	const uint8_t* payload = data + BLF_LOG_CONTAINER_HEADER_SIZE;
+	*payload_length = length - BLF_LOG_CONTAINER_HEADER_SIZE;
+
+	switch (header.compression_method) {
+	case BLF_COMPRESSION_NONE:
+		return payload;
+	case BLF_COMPRESSION_ZLIB: {
+		// Bounds the size given by the file, deflate cannot compress more than that
+		if (header.uncompressed_size > (uint64_t)*payload_length * ZLIB_MAX_RATIO) {
+			throw std::runtime_error("Invalid log container size: " + std::to_string(header.uncompressed_size));
+		}
+		buffer.resize(header.uncompressed_size);
+		uLongf inflated = (uLongf)header.uncompressed_size;
+		int ret;
+		{
+			trace_scope scope(tracer, TRACE_INFLATE);
+			ret = uncompress(buffer.data(), &inflated, payload, (uLong)*payload_length);
+		}
+		if (ret != Z_OK) {
+			throw std::runtime_error("Unable to inflate log container: " + std::to_string(ret));
+		}
+		*payload_length = inflated;
+		return buffer.data();
+	}
+	default:
+		throw std::runtime_error("Unsupported log container compression: " + std::to_string(header.compression_method));
+	}
+}
+
+void BlfReader::read_container(const uint8_t* data, size_t length) {
+	container_count++;
+	if (tracer) {
+		tracer->begin_container();
+	}
+	size_t payload_length;
+	const uint8_t* payload = inflate_log_container(data, length, inflate_buffer, &payload_length, tracer);
+	if (on_container) {
+		on_container(payload, payload_length);
+	}
+	push_uncompressed(payload, payload_length);
+	if (tracer) {
+		tracer->end_container(length);
+	}
+}
+
+size_t BlfReader::parse_objects(const uint8_t* data, size_t length) {
+	size_t pos = 0;
+	while (length - pos >= BLF_OBJECT_HEADER_BASE_SIZE) {
+		object_header_base header = parse_object_header_base(data + pos);
+		if (header.signature != BLF_OBJECT_SIGNATURE) {
+			throw std::runtime_error("Unexpected object signature");
+		}
+		if (header.object_size < BLF_OBJECT_HEADER_BASE_SIZE) {
+			throw std::runtime_error("Invalid object size");
+		}
+		if (length - pos < header.object_size) {
+			break;
+		}
+		size_t padding = std::min(header.padding(), length - pos - header.object_size);
+		read_object(data + pos, header.object_size + padding, header.object_type);
+		pos += header.object_size + padding;
+		object_skip = header.padding() - padding;
+	}
+	return pos;
+}
+
+void BlfReader::read_object(const uint8_t* data, size_t length, uint32_t object_type) {
+	if (object_filter && !object_filter(object_type)) {
+		return;
+	}
+	std::unique_ptr<ObjectHeaderBase> ohb;
+	{
+		trace_scope scope(tracer, TRACE_DECODE);
+		ohb.reset(File::createObject((ObjectType)object_type));
+		if (!ohb) {
+			// Unknown object type
+			return;
+		}
+		MemoryFile file(data, length);
+		ohb->read(file);
+	}
+	if (tracer) {
+		tracer->count_object();
+	}
+	object_count++;
+	on_object(ohb.get());
+}
+
+}
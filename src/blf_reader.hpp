@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_BLF_READER_H
+#define _APP_BLF_READER_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include <Vector/BLF.h>
+
+#include "trace.hpp"
+
+namespace blf_converter {
+
+// Returns the object stream of a LogContainer object (data starts with its
+// base header), either in place or inflated into buffer. Throws std::runtime_error.
+const uint8_t* inflate_log_container(const uint8_t* data, size_t length, std::vector<uint8_t>& buffer, size_t* payload_length, Tracer* tracer = nullptr);
+
+// Push based BLF parser. The file can be fed in chunks of any size, log
+// containers are inflated here and the contained objects are decoded by
+// Vector_BLF. Objects spanning several containers are reassembled.
+class BlfReader {
+public:
+	// The object is owned by the reader and deleted once the callback returns
+	using object_callback = std::function<void(Vector::BLF::ObjectHeaderBase* ohb)>;
+
+	// Receives the object stream of every log container, after inflation
+	using container_callback = std::function<void(const uint8_t* data, size_t length)>;
+
+	explicit BlfReader(object_callback on_object);
+
+	// Only objects accepted by the filter are decoded, all others are skipped by their header
+	void set_object_filter(std::function<bool(uint32_t object_type)> filter) { object_filter = std::move(filter); }
+
+	void set_container_callback(container_callback callback) { on_container = std::move(callback); }
+
+	// Records inflation and decoding times, nullptr disables tracing
+	void set_tracer(Tracer* t) { tracer = t; }
+
+	// Raw file content, starting with the file statistics header
+	void push(const uint8_t* data, size_t length);
+
+	// Uncompressed log container content, i.e. a sequence of objects
+	void push_uncompressed(const uint8_t* data, size_t length);
+
+	// Ends the input of the current file. Throws std::runtime_error if it ended
+	// within an object, the incomplete object is dropped.
+	void end_of_file();
+
+	// Prepares for the next file, callbacks and counters are kept
+	void reset();
+
+	bool has_statistics() const { return statistics_read; }
+	const Vector::BLF::FileStatistics& statistics() const { return file_statistics; }
+
+	uint64_t containers_read() const { return container_count; }
+	uint64_t objects_read() const { return object_count; }
+
+	// True while the tail of an incomplete object is awaited
+	bool has_partial_object() const { return !object_buffer.empty(); }
+
+private:
+	object_callback on_object;
+	container_callback on_container;
+	std::function<bool(uint32_t object_type)> object_filter;
+	Tracer* tracer = nullptr;
+
+	Vector::BLF::FileStatistics file_statistics = {};
+	bool statistics_read = false;
+
+	// Unparsed bytes of the raw file and of the uncompressed object stream
+	std::vector<uint8_t> raw_buffer;
+	std::vector<uint8_t> object_buffer;
+	// Padding bytes still to be skipped at the start of the next chunk
+	size_t raw_skip = 0;
+	size_t object_skip = 0;
+
+	std::vector<uint8_t> inflate_buffer;
+
+	uint64_t container_count = 0;
+	uint64_t object_count = 0;
+
+	size_t parse_raw(const uint8_t* data, size_t length);
+	size_t parse_objects(const uint8_t* data, size_t length);
+	void read_container(const uint8_t* data, size_t length);
+	void read_object(const uint8_t* data, size_t length, uint32_t object_type);
+};
+
+}
+
+#endif
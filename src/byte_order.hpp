@@ -0,0 +1,49 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_BYTE_ORDER_H
+#define _APP_BYTE_ORDER_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace blf_converter {
+
+inline bool host_is_little_endian() {
+	const uint16_t probe = 1;
+	uint8_t first;
+	memcpy(&first, &probe, 1);
+	return first == 1;
+}
+
+// Appends an unsigned integer in little endian byte order
+template<class T, class Buffer>
+inline void put_le(Buffer& out, T value) {
+	static_assert(std::is_unsigned<T>::value, "unsigned integers only");
+	for (size_t i = 0; i < sizeof(T); i++) {
+		out.push_back((uint8_t)(value >> (8 * i)));
+	}
+}
+
+// Writes count integers or doubles in little endian byte order, a plain copy on little endian hosts
+template<class T>
+inline void write_le_array(uint8_t* out, const T* values, size_t count) {
+	static_assert(std::is_arithmetic<T>::value, "numbers only");
+	if (sizeof(T) == 1 || host_is_little_endian()) {
+		memcpy(out, values, count * sizeof(T));
+		return;
+	}
+	for (size_t i = 0; i < count; i++) {
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(values + i);
+		for (size_t b = 0; b < sizeof(T); b++) {
+			out[b] = bytes[sizeof(T) - 1 - b];
+		}
+		out += sizeof(T);
+	}
+}
+
+}
+
+#endif
@@ -4,6 +4,8 @@
 */
 
 #include "channels.hpp"
+#include "json.hpp"
+#include <stdexcept>
 #include <tinyxml2.h>
 #include <sstream>
 #include <map>
@@ -11,7 +13,9 @@
 
 using namespace Vector::BLF;
 
-std::vector<std::string> split(const std::string& s, char delim) {
+namespace blf_converter {
+
+static std::vector<std::string> split(const std::string& s, char delim) {
 	std::vector<std::string> result;
 	std::stringstream ss(s);
 	std::string item;
@@ -23,7 +27,7 @@ std::vector<std::string> split(const std::string& s, char delim) {
 	return result;
 }
 
-std::optional<uint16_t> bus_type_to_linklayer(uint32_t bus_type) {
+static std::optional<uint16_t> bus_type_to_linklayer(uint32_t bus_type) {
 	switch (bus_type)
 	{
 	case 0x01: return LINKTYPE_CAN;
@@ -34,7 +38,7 @@ std::optional<uint16_t> bus_type_to_linklayer(uint32_t bus_type) {
 	}
 }
 
-std::optional<uint16_t> bus_name_to_linklayer(std::string bus_type) {
+static std::optional<uint16_t> bus_name_to_linklayer(std::string bus_type) {
 	if (bus_type == "CAN") return LINKTYPE_CAN;
 	if (bus_type == "LIN") return LINKTYPE_LIN;
 	if (bus_type == "FlexRay") return LINKTYPE_FLEXRAY;
@@ -42,7 +46,7 @@ std::optional<uint16_t> bus_name_to_linklayer(std::string bus_type) {
 	return std::nullopt;
 }
 
-void configure_db_channel(pcapng_exporter::PcapngExporter* exporter, AppText* obj) {
+static void configure_db_channel(std::vector<pcapng_exporter::channel_mapping>* mappings, AppText* obj) {
 
 	auto channel_id = (obj->reservedAppText1 >> 8) & 0xFF;
 	auto channel_link = bus_type_to_linklayer((obj->reservedAppText1 >> 16) & 0xFF);
@@ -55,12 +59,12 @@ void configure_db_channel(pcapng_exporter::PcapngExporter* exporter, AppText* ob
 	mapping.when.chl_id = channel_id;
 	mapping.when.chl_link = channel_link;
 	mapping.change.inf_name = db_channels[1];
-	exporter->mappings.push_back(mapping);
+	mappings->push_back(mapping);
 
 }
 
 
-void configure_xml_channel(pcapng_exporter::PcapngExporter* exporter, tinyxml2::XMLElement* channel) {
+static void configure_xml_channel(std::vector<pcapng_exporter::channel_mapping>* mappings, tinyxml2::XMLElement* channel) {
 
 	auto channel_type = std::string(channel->Attribute("type") ? channel->Attribute("type") : "");
 	auto channel_id = channel->IntAttribute("number");
@@ -71,7 +75,7 @@ void configure_xml_channel(pcapng_exporter::PcapngExporter* exporter, tinyxml2::
 		mapping.when.chl_id = channel_id;
 		mapping.when.chl_link = bus_name_to_linklayer(channel_type);
 		mapping.change.inf_name = channel_name;
-		exporter->mappings.push_back(mapping);
+		mappings->push_back(mapping);
 	}
 
 	auto channel_properties = channel->FirstChildElement("channel_properties");
@@ -107,17 +111,17 @@ void configure_xml_channel(pcapng_exporter::PcapngExporter* exporter, tinyxml2::
 			}
 
 			if (mapping.change.inf_name && mapping.when.chl_id) {
-				exporter->mappings.push_back(mapping);
+				mappings->push_back(mapping);
 			}
 		}
 	}
 }
 
-std::map<int, std::stringstream> xml_channel_mapping;
-void configure_xml_channels(pcapng_exporter::PcapngExporter* exporter, AppText* obj) {
+static void configure_xml_channels(std::vector<pcapng_exporter::channel_mapping>* mappings, channel_state* state, AppText* obj) {
 	auto metadata_id = obj->reservedAppText1 >> 24;
 	auto remaining_len = obj->reservedAppText1 & 0xffffff;
 	auto part_len = obj->text.size();
+	auto& xml_channel_mapping = state->xml_channel_mapping;
 	if (!xml_channel_mapping.count(metadata_id)) {
 		xml_channel_mapping.insert_or_assign(metadata_id, std::stringstream());
 	}
@@ -139,15 +143,32 @@ void configure_xml_channels(pcapng_exporter::PcapngExporter* exporter, AppText*
 	}
 	for (auto channel = channels->FirstChildElement("channel"); channel != NULL; channel = channel->NextSiblingElement("channel"))
 	{
-		configure_xml_channel(exporter, channel);
+		configure_xml_channel(mappings, channel);
 	}
 }
 
-void configure_channels(pcapng_exporter::PcapngExporter* exporter, AppText* obj) {
+void configure_channels(std::vector<pcapng_exporter::channel_mapping>* mappings, channel_state* state, AppText* obj) {
 	if (obj->source == AppText::Source::DbChannelInfo) {
-		configure_db_channel(exporter, obj);
+		configure_db_channel(mappings, obj);
 	}
 	if (obj->source == AppText::Source::MetaData) {
-		configure_xml_channels(exporter, obj);
+		configure_xml_channels(mappings, state, obj);
+	}
+}
+
+std::vector<pcapng_exporter::channel_mapping> load_channel_map(const std::string& path) {
+	nlohmann::json root = load_json(path);
+	auto entries = root.find("mappings");
+	if (entries == root.end() || !entries->is_array()) {
+		throw std::runtime_error("Invalid channel map: " + path);
+	}
+	try {
+		// The conversion PcapngExporter applies to the --channel-map of the default output
+		return entries->get<std::vector<pcapng_exporter::channel_mapping>>();
 	}
-}
\ No newline at end of file
+	catch (nlohmann::json::exception& e) {
+		throw std::runtime_error("Invalid channel map: " + path + ": " + e.what());
+	}
+}
+
+}
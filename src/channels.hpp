@@ -5,9 +5,26 @@
 #ifndef _APP_CHANNELS_H
 #define _APP_CHANNELS_H
 
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include <Vector/BLF.h>
 #include <pcapng_exporter/pcapng_exporter.hpp>
 
-void configure_channels(pcapng_exporter::PcapngExporter* exporter, Vector::BLF::AppText* obj);
+namespace blf_converter {
+
+// Per conversion state of the channel configuration, XML metadata may be split over several AppText objects
+struct channel_state {
+	std::map<int, std::stringstream> xml_channel_mapping;
+};
+
+void configure_channels(std::vector<pcapng_exporter::channel_mapping>* mappings, channel_state* state, Vector::BLF::AppText* obj);
+
+// Reads a --channel-map file for outputs that do not go through PcapngExporter, throws std::runtime_error
+std::vector<pcapng_exporter::channel_mapping> load_channel_map(const std::string& path);
+
+}
 
-#endif
\ No newline at end of file
+#endif
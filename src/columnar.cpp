@@ -0,0 +1,162 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "columnar.hpp"
+
+#include <cstring>
+
+#include <pcapng_exporter/linktype.h>
+
+#include "byte_order.hpp"
+
+#define COLUMNAR_VERSION 2
+
+// Batches are also written once their payload gets this large
+#define MAX_BATCH_PAYLOAD (64 << 20)
+
+#define PAD8(x) (((x) + 7) & ~(size_t)7)
+
+namespace blf_converter {
+
+ColumnarSink::ColumnarSink(block_callback on_blocks, size_t batch_rows)
+	: on_blocks(std::move(on_blocks)), batch_rows(batch_rows)
+{
+	tables[0].id = COLUMNAR_TABLE_CAN;
+	tables[1].id = COLUMNAR_TABLE_LIN;
+	tables[2].id = COLUMNAR_TABLE_ETHERNET;
+	tables[3].id = COLUMNAR_TABLE_FLEXRAY;
+	for (auto& t : tables) {
+		t.has_id = t.id != COLUMNAR_TABLE_ETHERNET;
+		t.has_dlc = t.id == COLUMNAR_TABLE_CAN || t.id == COLUMNAR_TABLE_LIN;
+		t.has_cycle = t.id == COLUMNAR_TABLE_FLEXRAY;
+		t.has_length = t.id == COLUMNAR_TABLE_ETHERNET || t.id == COLUMNAR_TABLE_FLEXRAY;
+		t.payload_offset.push_back(0);
+	}
+}
+
+void ColumnarSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (!make_frame_view(ohb, date_offset_ns, &view)) {
+		return;
+	}
+	switch (view.link_type) {
+	case LINKTYPE_CAN: append(tables[0], view); break;
+	case LINKTYPE_LIN: append(tables[1], view); break;
+	case LINKTYPE_ETHERNET: append(tables[2], view); break;
+	case LINKTYPE_FLEXRAY: append(tables[3], view); break;
+	}
+}
+
+void ColumnarSink::append(table& t, const frame_view& view) {
+	t.timestamp.push_back(view.timestamp_ns);
+	t.channel.push_back(100000 * view.hw_channel + view.channel);
+	if (t.has_id) {
+		t.frame_id.push_back(view.id);
+		t.flags.push_back(view.flags | (uint32_t)view.lin_errors << 16);
+	}
+	if (t.has_dlc) {
+		t.dlc.push_back(view.dlc);
+	}
+	if (t.has_cycle) {
+		t.cycle.push_back(view.cycle);
+	}
+	if (t.has_length) {
+		t.length.push_back(view.header_length + view.data_length);
+	}
+	t.payload.insert(t.payload.end(), view.header, view.header + view.header_length);
+	t.payload.insert(t.payload.end(), view.data, view.data + view.data_length);
+	t.payload_offset.push_back((uint32_t)t.payload.size());
+
+	if (t.timestamp.size() >= batch_rows || t.payload.size() >= MAX_BATCH_PAYLOAD) {
+		write_batch(t);
+	}
+}
+
+template<class T>
+static void put_column(std::vector<uint8_t>& out, const std::vector<T>& column) {
+	size_t length = column.size() * sizeof(T);
+	size_t offset = out.size();
+	out.resize(offset + PAD8(length), 0);
+	write_le_array(out.data() + offset, column.data(), column.size());
+}
+
+void ColumnarSink::write_batch(table& t) {
+	uint32_t rows = (uint32_t)t.timestamp.size();
+	if (rows == 0) {
+		return;
+	}
+
+	out.clear();
+	if (!header_written) {
+		out.insert(out.end(), { 'B', 'L', 'F', 'C' });
+		put_le(out, (uint16_t)COLUMNAR_VERSION);
+		out.insert(out.end(), 10, 0);
+		header_written = true;
+	}
+
+	size_t body_size = PAD8(rows * sizeof(uint64_t)) + PAD8(rows * sizeof(uint32_t)) +
+		PAD8((rows + 1) * sizeof(uint32_t)) + PAD8(t.payload.size());
+	if (t.has_id) {
+		body_size += 2 * PAD8(rows * sizeof(uint32_t));
+	}
+	if (t.has_dlc) {
+		body_size += PAD8(rows);
+	}
+	if (t.has_cycle) {
+		body_size += PAD8(rows);
+	}
+	if (t.has_length) {
+		body_size += PAD8(rows * sizeof(uint32_t));
+	}
+	out.reserve(out.size() + 16 + body_size);
+
+	put_le(out, t.id);
+	put_le(out, rows);
+	put_le(out, (uint64_t)body_size);
+	put_column(out, t.timestamp);
+	put_column(out, t.channel);
+	if (t.has_id) {
+		put_column(out, t.frame_id);
+		put_column(out, t.flags);
+	}
+	if (t.has_dlc) {
+		put_column(out, t.dlc);
+	}
+	if (t.has_cycle) {
+		put_column(out, t.cycle);
+	}
+	if (t.has_length) {
+		put_column(out, t.length);
+	}
+	put_column(out, t.payload_offset);
+	put_column(out, t.payload);
+
+	on_blocks(out.data(), out.size());
+
+	t.timestamp.clear();
+	t.channel.clear();
+	t.frame_id.clear();
+	t.flags.clear();
+	t.dlc.clear();
+	t.cycle.clear();
+	t.length.clear();
+	t.payload_offset.assign(1, 0);
+	t.payload.clear();
+}
+
+void ColumnarSink::flush() {
+	for (auto& t : tables) {
+		write_batch(t);
+	}
+	if (!header_written) {
+		// Keep empty outputs readable
+		out.assign({ 'B', 'L', 'F', 'C', COLUMNAR_VERSION, 0 });
+		out.insert(out.end(), 10, 0);
+		on_blocks(out.data(), out.size());
+		header_written = true;
+	}
+}
+
+}
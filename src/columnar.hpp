@@ -0,0 +1,84 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_COLUMNAR_H
+#define _APP_COLUMNAR_H
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "encoder.hpp"
+#include "frame_view.hpp"
+
+// Columnar frame tables
+//
+// All integers are little endian. The output starts with a 16 byte header:
+//   char[4] magic "BLFC", u16 version (2), u16 reserved, u64 reserved
+// followed by batches, each holding the rows of one table:
+//   u32 table (COLUMNAR_TABLE_*)
+//   u32 rows
+//   u64 size of the columns following this header, in bytes
+// The columns are stored one after the other, each padded to 8 bytes:
+//   CAN, LIN: u64 timestamp[rows], u32 channel[rows], u32 id[rows],
+//             u32 flags[rows], u8 dlc[rows], u32 payload_offset[rows + 1], u8 payload[]
+//   FlexRay:  u64 timestamp[rows], u32 channel[rows], u32 id[rows], u32 flags[rows],
+//             u8 cycle[rows], u32 length[rows], u32 payload_offset[rows + 1], u8 payload[]
+//   Ethernet: u64 timestamp[rows], u32 channel[rows], u32 length[rows],
+//             u32 payload_offset[rows + 1], u8 payload[]
+// timestamp is in nanoseconds since the epoch, channel is 100000 * hardware channel + channel,
+// flags are FRAME_FLAG_* and, for LIN, the LIN_ERROR_* bits shifted by 16. The FlexRay id
+// is the slot; status and error events are kept apart from frames by FRAME_FLAG_STATUS and
+// FRAME_FLAG_ERROR. Version 1 had no id, flags and cycle columns for FlexRay.
+// Row i of a batch spans payload[payload_offset[i] .. payload_offset[i + 1]]. The payload
+// is the CAN / LIN / FlexRay data or the complete Ethernet frame.
+
+#define COLUMNAR_TABLE_CAN      1
+#define COLUMNAR_TABLE_LIN      2
+#define COLUMNAR_TABLE_ETHERNET 3
+#define COLUMNAR_TABLE_FLEXRAY  4
+
+namespace blf_converter {
+
+class ColumnarSink : public ObjectSink {
+public:
+	using block_callback = std::function<void(const uint8_t* data, size_t length)>;
+
+	explicit ColumnarSink(block_callback on_blocks, size_t batch_rows = 65536);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void flush() override;
+
+private:
+	struct table {
+		uint32_t id;
+		// Columns besides timestamp, channel and the payload
+		bool has_id;
+		bool has_dlc;
+		bool has_cycle;
+		bool has_length;
+		std::vector<uint64_t> timestamp;
+		std::vector<uint32_t> channel;
+		std::vector<uint32_t> frame_id;
+		std::vector<uint32_t> flags;
+		std::vector<uint8_t> dlc;
+		std::vector<uint8_t> cycle;
+		std::vector<uint32_t> length;
+		std::vector<uint32_t> payload_offset;
+		std::vector<uint8_t> payload;
+	};
+
+	block_callback on_blocks;
+	size_t batch_rows;
+	bool header_written = false;
+	table tables[4];
+	std::vector<uint8_t> out;
+
+	void append(table& t, const frame_view& view);
+	void write_batch(table& t);
+};
+
+}
+
+#endif
@@ -0,0 +1,642 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "compressed_input.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <zlib.h>
+#include <zstd.h>
+
+#include "blf_format.hpp"
+
+// Decompressed data is handed over in buffers of this size, at most BUFFER_COUNT exist
+#define BUFFER_SIZE (4 << 20)
+#define BUFFER_COUNT 4
+#define READ_CHUNK_SIZE (1 << 20)
+
+#define GZIP_MAGIC 0x8B1F
+#define ZSTD_MAGIC 0xFD2FB528
+#define ZIP_MAGIC 0x04034B50
+
+// https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+#define ZIP_LOCAL_HEADER_SIZE 30
+#define ZIP_CENTRAL_HEADER_SIGNATURE 0x02014B50
+#define ZIP_CENTRAL_HEADER_SIZE 46
+#define ZIP_END_SIGNATURE 0x06054B50
+#define ZIP_END_SIZE 22
+#define ZIP64_END_SIGNATURE 0x06064B50
+#define ZIP64_END_SIZE 56
+#define ZIP64_LOCATOR_SIGNATURE 0x07064B50
+#define ZIP64_LOCATOR_SIZE 20
+#define ZIP64_EXTRA_ID 0x0001
+#define ZIP_FLAG_ENCRYPTED 0x0001
+#define ZIP_METHOD_STORED 0
+#define ZIP_METHOD_DEFLATE 8
+#define ZIP_METHOD_ZSTD 93
+
+namespace blf_converter {
+
+enum class entry_codec {
+	stored,
+	deflate,
+	gzip,
+	zstd
+};
+
+// A BLF file inside the wrapper, gzip and zstd files hold exactly one
+struct archive_entry {
+	std::string name;
+	entry_codec codec;
+	// Start of the zip local header, the compressed data follows it
+	uint64_t offset = 0;
+	uint64_t compressed_size = UINT64_MAX;
+	// Zip entries are checked against their CRC-32
+	bool check_crc = false;
+	uint32_t crc = 0;
+	bool encrypted = false;
+	bool unsupported = false;
+};
+
+input_wrapper detect_wrapper(const std::string& path) {
+	std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+	uint8_t magic[4] = { 0 };
+	in.read((char*)magic, sizeof(magic));
+	if (in.gcount() < 2) {
+		return input_wrapper::none;
+	}
+	if (read_le16(magic) == GZIP_MAGIC) {
+		return input_wrapper::gzip;
+	}
+	if (in.gcount() == 4 && read_le32(magic) == ZSTD_MAGIC) {
+		return input_wrapper::zstd;
+	}
+	if (in.gcount() == 4 && read_le32(magic) == ZIP_MAGIC) {
+		return input_wrapper::zip;
+	}
+	return input_wrapper::none;
+}
+
+static std::string file_name(const std::string& path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+static bool has_blf_extension(const std::string& name) {
+	if (name.size() < 4) {
+		return false;
+	}
+	std::string extension = name.substr(name.size() - 4);
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return (char)tolower(c); });
+	return extension == ".blf";
+}
+
+static void read_at(std::ifstream& in, uint64_t offset, uint8_t* data, size_t length) {
+	in.clear();
+	in.seekg((std::streamoff)offset);
+	in.read((char*)data, length);
+	if ((size_t)in.gcount() != length) {
+		throw std::runtime_error("Unexpected end of file");
+	}
+}
+
+// Values that do not fit are stored as all ones and follow in the Zip64 extra field
+static void apply_zip64_extra(const uint8_t* extra, size_t length, uint64_t* size, uint64_t* compressed_size, uint64_t* offset) {
+	size_t pos = 0;
+	while (pos + 4 <= length) {
+		uint16_t id = read_le16(extra + pos);
+		uint16_t field_length = read_le16(extra + pos + 2);
+		pos += 4;
+		if (pos + field_length > length) {
+			return;
+		}
+		if (id == ZIP64_EXTRA_ID) {
+			const uint8_t* p = extra + pos;
+			const uint8_t* end = p + field_length;
+			for (uint64_t* value : { size, compressed_size, offset }) {
+				if (*value == UINT32_MAX && p + 8 <= end) {
+					*value = read_le64(p);
+					p += 8;
+				}
+			}
+			return;
+		}
+		pos += field_length;
+	}
+}
+
+// The BLF entries of the central directory, in name order
+static std::vector<archive_entry> read_zip_directory(const std::string& path) {
+	std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+	if (!in.is_open()) {
+		throw std::runtime_error("Unable to open: " + path);
+	}
+	in.seekg(0, std::ios_base::end);
+	uint64_t file_size = (uint64_t)in.tellg();
+
+	// The end record is followed by a comment of at most 64 KiB
+	size_t tail_length = (size_t)std::min<uint64_t>(file_size, ZIP_END_SIZE + 0xFFFF + ZIP64_LOCATOR_SIZE);
+	std::vector<uint8_t> tail(tail_length);
+	read_at(in, file_size - tail_length, tail.data(), tail_length);
+	size_t end = SIZE_MAX;
+	for (size_t pos = tail_length >= ZIP_END_SIZE ? tail_length - ZIP_END_SIZE + 1 : 0; pos-- > 0;) {
+		if (read_le32(tail.data() + pos) == ZIP_END_SIGNATURE) {
+			end = pos;
+			break;
+		}
+	}
+	if (end == SIZE_MAX) {
+		throw std::runtime_error("Invalid zip archive, no central directory: " + path);
+	}
+	uint64_t entry_count = read_le16(tail.data() + end + 10);
+	uint64_t directory_size = read_le32(tail.data() + end + 12);
+	uint64_t directory_offset = read_le32(tail.data() + end + 16);
+	if (end >= ZIP64_LOCATOR_SIZE && read_le32(tail.data() + end - ZIP64_LOCATOR_SIZE) == ZIP64_LOCATOR_SIGNATURE) {
+		uint8_t record[ZIP64_END_SIZE];
+		read_at(in, read_le64(tail.data() + end - ZIP64_LOCATOR_SIZE + 8), record, sizeof(record));
+		if (read_le32(record) != ZIP64_END_SIGNATURE) {
+			throw std::runtime_error("Invalid zip archive, damaged Zip64 end record: " + path);
+		}
+		entry_count = read_le64(record + 32);
+		directory_size = read_le64(record + 40);
+		directory_offset = read_le64(record + 48);
+	}
+	if (directory_offset + directory_size > file_size) {
+		throw std::runtime_error("Invalid zip archive, central directory out of range: " + path);
+	}
+
+	std::vector<uint8_t> directory((size_t)directory_size);
+	read_at(in, directory_offset, directory.data(), directory.size());
+	std::vector<archive_entry> entries;
+	size_t pos = 0;
+	for (uint64_t i = 0; i < entry_count; i++) {
+		const uint8_t* p = directory.data() + pos;
+		if (pos + ZIP_CENTRAL_HEADER_SIZE > directory.size() || read_le32(p) != ZIP_CENTRAL_HEADER_SIGNATURE) {
+			throw std::runtime_error("Invalid zip archive, damaged central directory: " + path);
+		}
+		uint16_t flags = read_le16(p + 8);
+		uint16_t method = read_le16(p + 10);
+		uint64_t compressed_size = read_le32(p + 20);
+		uint64_t size = read_le32(p + 24);
+		size_t name_length = read_le16(p + 28);
+		size_t extra_length = read_le16(p + 30);
+		size_t comment_length = read_le16(p + 32);
+		uint64_t offset = read_le32(p + 42);
+		size_t record_length = ZIP_CENTRAL_HEADER_SIZE + name_length + extra_length + comment_length;
+		if (pos + record_length > directory.size()) {
+			throw std::runtime_error("Invalid zip archive, damaged central directory: " + path);
+		}
+		apply_zip64_extra(p + ZIP_CENTRAL_HEADER_SIZE + name_length, extra_length, &size, &compressed_size, &offset);
+
+		archive_entry entry;
+		entry.name = std::string((const char*)p + ZIP_CENTRAL_HEADER_SIZE, name_length);
+		entry.offset = offset;
+		entry.compressed_size = compressed_size;
+		entry.check_crc = true;
+		entry.crc = read_le32(p + 16);
+		entry.encrypted = flags & ZIP_FLAG_ENCRYPTED;
+		switch (method) {
+		case ZIP_METHOD_STORED:
+			entry.codec = entry_codec::stored;
+			break;
+		case ZIP_METHOD_DEFLATE:
+			entry.codec = entry_codec::deflate;
+			break;
+		case ZIP_METHOD_ZSTD:
+			entry.codec = entry_codec::zstd;
+			break;
+		default:
+			entry.unsupported = true;
+			break;
+		}
+		if (has_blf_extension(entry.name)) {
+			entries.push_back(entry);
+		}
+		pos += record_length;
+	}
+	std::sort(entries.begin(), entries.end(), [](const archive_entry& a, const archive_entry& b) {
+		return a.name < b.name;
+	});
+	return entries;
+}
+
+// Buffers of decompressed data, filled by the decompressing thread and taken in
+// order by the converter. Emptied buffers are reused, so that at most
+// buffer_count exist and the decompressing thread waits when the converter
+// falls behind.
+class BufferQueue {
+public:
+	struct buffer {
+		std::vector<uint8_t> data;
+		size_t length = 0;
+		// The last buffer of a file, with the error that ended it early
+		bool end_of_file = false;
+		std::exception_ptr error;
+	};
+
+	// Thrown in the decompressing thread once the converter stopped reading
+	struct cancelled {};
+
+	BufferQueue(size_t buffer_size, size_t buffer_count) {
+		for (size_t i = 0; i < buffer_count; i++) {
+			free_buffers.emplace_back(buffer_size);
+		}
+	}
+
+	// Free space of the current buffer, a full buffer is queued first
+	uint8_t* space(size_t* length) {
+		if (current.data.empty() || current.length == current.data.size()) {
+			if (!current.data.empty()) {
+				submit();
+			}
+			acquire();
+		}
+		*length = current.data.size() - current.length;
+		return current.data.data() + current.length;
+	}
+
+	void commit(size_t length) {
+		current.length += length;
+	}
+
+	void end_file(std::exception_ptr error) {
+		if (current.data.empty()) {
+			acquire();
+		}
+		current.end_of_file = true;
+		current.error = error;
+		submit();
+	}
+
+	// No more files follow
+	void close() {
+		std::lock_guard<std::mutex> lock(mutex);
+		closed = true;
+		changed.notify_all();
+	}
+
+	// False once all files were taken
+	bool pop(buffer* out) {
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return !full_buffers.empty() || closed; });
+		if (full_buffers.empty()) {
+			return false;
+		}
+		*out = std::move(full_buffers.front());
+		full_buffers.pop_front();
+		return true;
+	}
+
+	void release(buffer& b) {
+		std::lock_guard<std::mutex> lock(mutex);
+		free_buffers.push_back(std::move(b.data));
+		changed.notify_all();
+	}
+
+	void cancel() {
+		std::lock_guard<std::mutex> lock(mutex);
+		cancelling = true;
+		changed.notify_all();
+	}
+
+private:
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<buffer> full_buffers;
+	std::vector<std::vector<uint8_t>> free_buffers;
+	bool closed = false;
+	bool cancelling = false;
+
+	// Only used by the decompressing thread
+	buffer current;
+
+	void acquire() {
+		std::unique_lock<std::mutex> lock(mutex);
+		changed.wait(lock, [this] { return !free_buffers.empty() || cancelling; });
+		if (cancelling) {
+			throw cancelled();
+		}
+		current = buffer();
+		current.data = std::move(free_buffers.back());
+		free_buffers.pop_back();
+	}
+
+	void submit() {
+		std::lock_guard<std::mutex> lock(mutex);
+		full_buffers.push_back(std::move(current));
+		current = buffer();
+		changed.notify_all();
+	}
+};
+
+// Compressed bytes of one entry, read in chunks
+class RawInput {
+public:
+	RawInput(std::ifstream& in, uint64_t length)
+		: in(in), remaining(length), chunk(READ_CHUNK_SIZE)
+	{
+	}
+
+	// Next chunk, 0 at the end of the entry
+	size_t read(const uint8_t** data) {
+		if (remaining == 0 || !in) {
+			return 0;
+		}
+		in.read((char*)chunk.data(), (std::streamsize)std::min<uint64_t>(chunk.size(), remaining));
+		size_t length = (size_t)in.gcount();
+		remaining -= length;
+		*data = chunk.data();
+		return length;
+	}
+
+private:
+	std::ifstream& in;
+	uint64_t remaining;
+	std::vector<uint8_t> chunk;
+};
+
+// Hands the data of one entry to the queue and keeps its CRC-32
+class EntryOutput {
+public:
+	EntryOutput(BufferQueue& queue, bool check_crc)
+		: queue(queue), check_crc(check_crc)
+	{
+	}
+
+	uint8_t* space(size_t* length) {
+		return queue.space(length);
+	}
+
+	void commit(const uint8_t* data, size_t length) {
+		if (check_crc) {
+			crc = crc32_z(crc, data, length);
+		}
+		queue.commit(length);
+	}
+
+	uint32_t checksum() const { return (uint32_t)crc; }
+
+private:
+	BufferQueue& queue;
+	bool check_crc;
+	uLong crc = crc32(0, Z_NULL, 0);
+};
+
+static void copy_stored(RawInput& raw, EntryOutput& out) {
+	const uint8_t* data;
+	size_t length;
+	while ((length = raw.read(&data)) > 0) {
+		while (length > 0) {
+			size_t available;
+			uint8_t* p = out.space(&available);
+			size_t part = std::min(length, available);
+			std::copy(data, data + part, p);
+			out.commit(p, part);
+			data += part;
+			length -= part;
+		}
+	}
+}
+
+// Raw deflate of zip entries or gzip files, which may hold several members
+static void inflate_stream(RawInput& raw, EntryOutput& out, bool gzip) {
+	z_stream stream = {};
+	if (inflateInit2(&stream, gzip ? 16 + MAX_WBITS : -MAX_WBITS) != Z_OK) {
+		throw std::runtime_error("Unable to initialize zlib");
+	}
+	struct guard {
+		z_stream& stream;
+		~guard() { inflateEnd(&stream); }
+	} end_stream = { stream };
+
+	bool in_stream = false;
+	bool output_full = false;
+	for (;;) {
+		// Output held back by a full buffer is taken before reading on
+		if (stream.avail_in == 0 && !output_full) {
+			const uint8_t* data;
+			size_t length = raw.read(&data);
+			if (length == 0) {
+				break;
+			}
+			stream.next_in = (Bytef*)data;
+			stream.avail_in = (uInt)length;
+		}
+		size_t available;
+		uint8_t* p = out.space(&available);
+		stream.next_out = p;
+		stream.avail_out = (uInt)std::min<size_t>(available, UINT_MAX);
+		uInt avail_out = stream.avail_out;
+		in_stream = true;
+		int ret = inflate(&stream, Z_NO_FLUSH);
+		if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+			throw std::runtime_error(std::string("Invalid deflate data: ") + (stream.msg ? stream.msg : "unknown error"));
+		}
+		out.commit(p, avail_out - stream.avail_out);
+		output_full = stream.avail_out == 0;
+		if (ret == Z_STREAM_END) {
+			in_stream = false;
+			output_full = false;
+			if (!gzip) {
+				return;
+			}
+			inflateReset(&stream);
+		}
+		else if (ret == Z_BUF_ERROR && stream.avail_in > 0) {
+			throw std::runtime_error("Invalid deflate data");
+		}
+	}
+	if (in_stream) {
+		throw std::runtime_error("Unexpected end of compressed data");
+	}
+}
+
+static void decompress_zstd(RawInput& raw, EntryOutput& out) {
+	ZSTD_DCtx* context = ZSTD_createDCtx();
+	if (!context) {
+		throw std::runtime_error("Unable to initialize zstd");
+	}
+	struct guard {
+		ZSTD_DCtx* context;
+		~guard() { ZSTD_freeDCtx(context); }
+	} free_context = { context };
+
+	ZSTD_inBuffer input = { nullptr, 0, 0 };
+	// 0 once a frame is complete
+	size_t hint = 0;
+	bool output_full = false;
+	bool any = false;
+	for (;;) {
+		if (input.pos == input.size && !output_full) {
+			const uint8_t* data;
+			size_t length = raw.read(&data);
+			if (length == 0) {
+				break;
+			}
+			input = { data, length, 0 };
+			any = true;
+		}
+		size_t available;
+		uint8_t* p = out.space(&available);
+		ZSTD_outBuffer output = { p, available, 0 };
+		hint = ZSTD_decompressStream(context, &output, &input);
+		if (ZSTD_isError(hint)) {
+			throw std::runtime_error(std::string("Invalid zstd data: ") + ZSTD_getErrorName(hint));
+		}
+		out.commit(p, output.pos);
+		output_full = output.pos == output.size;
+	}
+	if (!any || hint != 0) {
+		throw std::runtime_error("Unexpected end of compressed data");
+	}
+}
+
+static void decompress_entry(std::ifstream& in, const archive_entry& entry, BufferQueue& queue) {
+	if (entry.encrypted) {
+		throw std::runtime_error("Encrypted zip entries are not supported");
+	}
+	if (entry.unsupported) {
+		throw std::runtime_error("Unsupported zip compression method");
+	}
+	uint64_t offset = entry.offset;
+	if (entry.check_crc) {
+		uint8_t header[ZIP_LOCAL_HEADER_SIZE];
+		read_at(in, entry.offset, header, sizeof(header));
+		if (read_le32(header) != ZIP_MAGIC) {
+			throw std::runtime_error("Invalid zip local header");
+		}
+		offset += ZIP_LOCAL_HEADER_SIZE + read_le16(header + 26) + read_le16(header + 28);
+	}
+	in.clear();
+	in.seekg((std::streamoff)offset);
+
+	RawInput raw(in, entry.compressed_size);
+	EntryOutput out(queue, entry.check_crc);
+	switch (entry.codec) {
+	case entry_codec::stored:
+		copy_stored(raw, out);
+		break;
+	case entry_codec::deflate:
+		inflate_stream(raw, out, false);
+		break;
+	case entry_codec::gzip:
+		inflate_stream(raw, out, true);
+		break;
+	case entry_codec::zstd:
+		decompress_zstd(raw, out);
+		break;
+	}
+	if (in.bad()) {
+		throw std::runtime_error("Unable to read");
+	}
+	if (entry.check_crc && out.checksum() != entry.crc) {
+		throw std::runtime_error("CRC mismatch");
+	}
+}
+
+static void decompress_entries(const std::string& path, const std::vector<archive_entry>& entries, BufferQueue& queue) {
+	try {
+		std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+		for (const auto& entry : entries) {
+			std::exception_ptr error;
+			try {
+				if (!in.is_open()) {
+					throw std::runtime_error("Unable to open: " + path);
+				}
+				decompress_entry(in, entry, queue);
+			}
+			catch (BufferQueue::cancelled&) {
+				throw;
+			}
+			catch (...) {
+				error = std::current_exception();
+			}
+			queue.end_file(error);
+		}
+		queue.close();
+	}
+	catch (BufferQueue::cancelled&) {
+	}
+}
+
+void convert_compressed(
+	Converter& converter,
+	const std::string& path,
+	input_wrapper wrapper,
+	std::function<void(const std::string& file, const std::exception& e)> on_error)
+{
+	std::vector<archive_entry> entries;
+	if (wrapper == input_wrapper::zip) {
+		entries = read_zip_directory(path);
+		if (entries.empty()) {
+			throw std::runtime_error("No BLF file in " + path);
+		}
+	}
+	else {
+		// The BLF file is named after the wrapper, e.g. drive.blf for drive.blf.gz
+		archive_entry entry;
+		std::string name = file_name(path);
+		entry.name = name.substr(0, std::min(name.size(), name.find_last_of('.')));
+		entry.codec = wrapper == input_wrapper::gzip ? entry_codec::gzip : entry_codec::zstd;
+		entries.push_back(entry);
+	}
+
+	BufferQueue queue(BUFFER_SIZE, BUFFER_COUNT);
+	struct producer {
+		BufferQueue& queue;
+		std::thread thread;
+		// Also when the conversion throws, the thread is stopped before the queue goes away
+		~producer() {
+			queue.cancel();
+			thread.join();
+		}
+	} decompressing = { queue, std::thread(decompress_entries, std::cref(path), std::cref(entries), std::ref(queue)) };
+
+	size_t file = 0;
+	bool started = false;
+	bool failed = false;
+	BufferQueue::buffer buffer;
+	while (queue.pop(&buffer)) {
+		try {
+			if (!started) {
+				// Entries of an archive are separate recordings with their own start date
+				converter.begin_recording();
+				started = true;
+			}
+			// The rest of a damaged file is skipped
+			if (!failed) {
+				converter.push(buffer.data.data(), buffer.length);
+			}
+			if (buffer.end_of_file && buffer.error && !failed) {
+				std::rethrow_exception(buffer.error);
+			}
+			if (buffer.end_of_file && !failed) {
+				converter.end_file();
+			}
+		}
+		catch (std::exception& e) {
+			failed = true;
+			on_error(entries[file].name, e);
+		}
+		if (buffer.end_of_file) {
+			file++;
+			started = false;
+			failed = false;
+		}
+		queue.release(buffer);
+	}
+	converter.finish();
+}
+
+}
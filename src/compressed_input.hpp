@@ -0,0 +1,42 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_COMPRESSED_INPUT_H
+#define _APP_COMPRESSED_INPUT_H
+
+#include <exception>
+#include <functional>
+#include <string>
+
+#include "converter.hpp"
+
+namespace blf_converter {
+
+enum class input_wrapper {
+	none,
+	gzip,
+	zstd,
+	zip
+};
+
+// Recognizes a gzip, zstd or zip wrapper by the magic bytes at the start of the
+// file, none for plain BLF files and files that cannot be read
+input_wrapper detect_wrapper(const std::string& path);
+
+// Converts the BLF files in a gzip, zstd or zip file without unpacking them to
+// disk and finishes the converter. A background thread decompresses into a
+// bounded queue of buffers while the converter reads from it. The BLF entries
+// of a zip archive are converted in name order into one output, each entry
+// timestamped from its own measurement start. Errors in one entry are passed to
+// on_error and the conversion goes on with the next entry.
+// Throws std::runtime_error if the file cannot be opened or holds no BLF file.
+void convert_compressed(
+	Converter& converter,
+	const std::string& path,
+	input_wrapper wrapper,
+	std::function<void(const std::string& file, const std::exception& e)> on_error);
+
+}
+
+#endif
@@ -0,0 +1,266 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "container_cache.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <random>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <Vector/BLF.h>
+
+#include "blf_format.hpp"
+
+#define CACHE_KEY_BYTES (64 << 10)
+#define CACHE_ENTRY_EXTENSION ".blf"
+
+namespace fs = std::filesystem;
+
+namespace blf_converter {
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path) {
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		file = nullptr;
+		throw std::runtime_error("Unable to open: " + path);
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size)) {
+		CloseHandle(file);
+		throw std::runtime_error("Unable to read: " + path);
+	}
+	length = (size_t)file_size.QuadPart;
+	if (length == 0) {
+		return;
+	}
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	address = mapping ? (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (!address) {
+		if (mapping) CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("Unable to map: " + path);
+	}
+}
+
+MappedFile::~MappedFile() {
+	if (address) UnmapViewOfFile(address);
+	if (mapping) CloseHandle(mapping);
+	if (file) CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("Unable to open: " + path);
+	}
+	struct stat st;
+	if (fstat(fd, &st) != 0) {
+		close(fd);
+		throw std::runtime_error("Unable to read: " + path);
+	}
+	length = (size_t)st.st_size;
+	if (length > 0) {
+		void* p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (p == MAP_FAILED) {
+			close(fd);
+			throw std::runtime_error("Unable to map: " + path);
+		}
+		madvise(p, length, MADV_SEQUENTIAL);
+		address = (const uint8_t*)p;
+	}
+	// The mapping stays valid without the descriptor
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (address) munmap((void*)address, length);
+}
+
+#endif
+
+static void put_le16(uint8_t* p, uint16_t value) {
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+}
+
+static void put_le32(uint8_t* p, uint32_t value) {
+	put_le16(p, (uint16_t)value);
+	put_le16(p + 2, (uint16_t)(value >> 16));
+}
+
+// FNV-1a
+static void hash_bytes(uint64_t* hash, const void* data, size_t length) {
+	const uint8_t* p = (const uint8_t*)data;
+	for (size_t i = 0; i < length; i++) {
+		*hash = (*hash ^ p[i]) * 0x100000001B3ull;
+	}
+}
+
+ContainerCache::ContainerCache(const std::string& directory, uint64_t size_limit)
+	: directory(directory), size_limit(size_limit)
+{
+	std::error_code ec;
+	fs::create_directories(directory, ec);
+	if (!fs::is_directory(directory)) {
+		throw std::runtime_error("Unable to create cache directory: " + directory);
+	}
+}
+
+std::string ContainerCache::entry_path(const std::string& input) const {
+	std::error_code ec;
+	uint64_t size = fs::file_size(input, ec);
+	if (ec) {
+		throw std::runtime_error("Unable to read: " + input);
+	}
+	int64_t mtime = (int64_t)fs::last_write_time(input, ec).time_since_epoch().count();
+
+	std::vector<char> head(std::min<uint64_t>(size, CACHE_KEY_BYTES));
+	std::ifstream in(input, std::ios_base::in | std::ios_base::binary);
+	if (!in.read(head.data(), head.size())) {
+		throw std::runtime_error("Unable to read: " + input);
+	}
+
+	uint64_t hash = 0xCBF29CE484222325ull;
+	hash_bytes(&hash, &size, sizeof(size));
+	hash_bytes(&hash, &mtime, sizeof(mtime));
+	hash_bytes(&hash, head.data(), head.size());
+
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx", (unsigned long long)hash);
+	return (fs::path(directory) / (std::string(name) + CACHE_ENTRY_EXTENSION)).string();
+}
+
+std::unique_ptr<MappedFile> ContainerCache::find(const std::string& input) {
+	std::string path = entry_path(input);
+	std::error_code ec;
+	if (!fs::is_regular_file(path, ec)) {
+		return nullptr;
+	}
+	// The modification time of an entry is its last use
+	fs::last_write_time(path, fs::file_time_type::clock::now(), ec);
+	try {
+		return std::make_unique<MappedFile>(path);
+	}
+	catch (std::runtime_error&) {
+		// Evicted meanwhile
+		return nullptr;
+	}
+}
+
+std::unique_ptr<CacheEntryWriter> ContainerCache::create(const std::string& input) {
+	return std::make_unique<CacheEntryWriter>(*this, input, entry_path(input));
+}
+
+void ContainerCache::evict() {
+	std::vector<std::pair<fs::file_time_type, fs::path>> entries;
+	uint64_t total = 0;
+	std::error_code ec;
+	for (const auto& entry : fs::directory_iterator(directory, ec)) {
+		if (entry.path().extension() != CACHE_ENTRY_EXTENSION) {
+			continue;
+		}
+		uint64_t size = entry.file_size(ec);
+		if (ec) {
+			continue;
+		}
+		total += size;
+		entries.emplace_back(entry.last_write_time(ec), entry.path());
+	}
+	std::sort(entries.begin(), entries.end());
+	for (const auto& entry : entries) {
+		if (total <= size_limit) {
+			break;
+		}
+		uint64_t size = fs::file_size(entry.second, ec);
+		if (!ec && fs::remove(entry.second, ec)) {
+			total -= size;
+		}
+	}
+}
+
+CacheEntryWriter::CacheEntryWriter(ContainerCache& cache, const std::string& input, const std::string& path)
+	: cache(cache), path(path)
+{
+	// The file statistics header is kept as is
+	std::ifstream in(input, std::ios_base::in | std::ios_base::binary);
+	uint8_t prefix[8];
+	if (!in.read((char*)prefix, sizeof(prefix)) || read_le32(prefix) != BLF_FILE_SIGNATURE) {
+		throw std::runtime_error("Not a BLF file: " + input);
+	}
+	std::vector<char> header(std::max((size_t)read_le32(prefix + 4), (size_t)BLF_FILE_STATISTICS_SIZE));
+	std::copy(prefix, prefix + sizeof(prefix), header.begin());
+	if (!in.read(header.data() + sizeof(prefix), header.size() - sizeof(prefix))) {
+		throw std::runtime_error("Not a BLF file: " + input);
+	}
+
+	// Concurrent conversions of the same file each write their own temporary file
+	std::random_device random;
+	temp_path = path + "." + std::to_string(random()) + ".tmp";
+	out.open(temp_path, std::ios_base::out | std::ios_base::binary);
+	if (!out.is_open()) {
+		throw std::runtime_error("Unable to open: " + temp_path);
+	}
+	out.write(header.data(), header.size());
+}
+
+CacheEntryWriter::~CacheEntryWriter() {
+	if (!committed) {
+		out.close();
+		std::error_code ec;
+		fs::remove(temp_path, ec);
+	}
+}
+
+void CacheEntryWriter::add_container(const uint8_t* data, size_t length) {
+	uint8_t header[BLF_LOG_CONTAINER_HEADER_SIZE] = { 0 };
+	uint32_t object_size = (uint32_t)(BLF_LOG_CONTAINER_HEADER_SIZE + length);
+	put_le32(header, BLF_OBJECT_SIGNATURE);
+	put_le16(header + 4, BLF_OBJECT_HEADER_BASE_SIZE);
+	put_le16(header + 6, 1);
+	put_le32(header + 8, object_size);
+	put_le32(header + 12, (uint32_t)Vector::BLF::ObjectType::LOG_CONTAINER);
+	put_le16(header + 16, BLF_COMPRESSION_NONE);
+	put_le32(header + 24, (uint32_t)length);
+	out.write((const char*)header, sizeof(header));
+	out.write((const char*)data, length);
+
+	static const char padding[4] = { 0 };
+	out.write(padding, object_size % 4);
+}
+
+void CacheEntryWriter::commit() {
+	out.close();
+	if (!out) {
+		throw std::runtime_error("Unable to write: " + temp_path);
+	}
+	std::error_code ec;
+	fs::rename(temp_path, path, ec);
+	if (ec) {
+		throw std::runtime_error("Unable to write: " + path);
+	}
+	committed = true;
+	cache.evict();
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_CONTAINER_CACHE_H
+#define _APP_CONTAINER_CACHE_H
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+
+namespace blf_converter {
+
+// Read only memory mapping of a whole file. Throws std::runtime_error.
+class MappedFile {
+public:
+	explicit MappedFile(const std::string& path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	const uint8_t* data() const { return address; }
+	size_t size() const { return length; }
+
+private:
+	const uint8_t* address = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	void* file = nullptr;
+	void* mapping = nullptr;
+#endif
+};
+
+class CacheEntryWriter;
+
+// Directory of inflated copies of BLF files, so that repeated conversions of the
+// same file skip zlib. An entry is a BLF file whose log containers are stored
+// uncompressed, named after the size, modification time and first 64 KiB of the
+// input. Entries are evicted least recently used first once the directory
+// exceeds the size limit.
+class ContainerCache {
+public:
+	ContainerCache(const std::string& directory, uint64_t size_limit);
+
+	// Mapped entry of the input file, nullptr if there is none.
+	// Throws std::runtime_error if the input cannot be read.
+	std::unique_ptr<MappedFile> find(const std::string& input);
+
+	// Starts the entry of the input file, throws std::runtime_error
+	std::unique_ptr<CacheEntryWriter> create(const std::string& input);
+
+private:
+	std::string directory;
+	uint64_t size_limit;
+
+	std::string entry_path(const std::string& input) const;
+	void evict();
+
+	friend class CacheEntryWriter;
+};
+
+// Collects the inflated log containers of one input file. The entry only becomes
+// visible with commit(), an abandoned entry is removed.
+class CacheEntryWriter {
+public:
+	CacheEntryWriter(ContainerCache& cache, const std::string& input, const std::string& path);
+	~CacheEntryWriter();
+
+	// Object stream of one log container
+	void add_container(const uint8_t* data, size_t length);
+
+	// Throws std::runtime_error on I/O errors
+	void commit();
+
+private:
+	ContainerCache& cache;
+	std::string path;
+	std::string temp_path;
+	std::ofstream out;
+	bool committed = false;
+};
+
+}
+
+#endif
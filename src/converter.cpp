@@ -0,0 +1,207 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "converter.hpp"
+
+#include <ctime>
+#include <functional>
+#include <stdexcept>
+
+using namespace Vector::BLF;
+
+#define READ_CHUNK_SIZE (1 << 20)
+
+namespace blf_converter {
+
+uint64_t calculate_startdate(const FileStatistics& statistics) {
+	return systemtime_to_ns(statistics.measurementStartTime);
+}
+
+uint64_t systemtime_to_ns(const Vector::BLF::SYSTEMTIME& startTime) {
+	struct tm tms = { 0 };
+	tms.tm_year = startTime.year - 1900;
+	tms.tm_mon = startTime.month - 1;
+	tms.tm_mday = startTime.day;
+	tms.tm_hour = startTime.hour;
+	tms.tm_min = startTime.minute;
+	tms.tm_sec = startTime.second;
+
+	time_t ret = mktime(&tms);
+	if (ret < 0 )
+	{
+		return 0;
+	}
+	
+	ret *= 1000;
+	ret += startTime.milliseconds;
+	ret *= 1000 * 1000;
+
+	return ret;
+}
+
+uint64_t local_clock_ns(uint64_t ns) {
+	time_t seconds = (time_t)(ns / 1000000000);
+	struct tm utc;
+#ifdef _WIN32
+	gmtime_s(&utc, &seconds);
+#else
+	gmtime_r(&seconds, &utc);
+#endif
+	// mktime reads the UTC fields as local standard time like systemtime_to_ns,
+	// which shifts them by the offset of the time zone
+	utc.tm_isdst = 0;
+	time_t shifted = mktime(&utc);
+	int64_t offset_ns = ((int64_t)shifted - (int64_t)seconds) * 1000000000;
+	if (shifted < 0 || offset_ns > (int64_t)ns) {
+		// Unknown start dates stay at 1970-01-01
+		return 0;
+	}
+	return (uint64_t)((int64_t)ns - offset_ns);
+}
+
+Converter::Converter(ObjectSink& sink)
+	: sink(sink), blf([this](ObjectHeaderBase* ohb) { on_object(ohb); })
+{
+}
+
+void Converter::push(const uint8_t* data, size_t length) {
+	blf.push(data, length);
+}
+
+void Converter::push_uncompressed(const uint8_t* data, size_t length) {
+	blf.push_uncompressed(data, length);
+}
+
+void Converter::begin_file() {
+	blf.reset();
+}
+
+void Converter::begin_recording() {
+	blf.reset();
+	date_known = false;
+}
+
+void Converter::end_file() {
+	blf.end_of_file();
+}
+
+void Converter::finish() {
+	uint64_t start = tracer ? Tracer::now() : 0;
+	sink.flush();
+	if (tracer) {
+		tracer->span("flush", start, Tracer::now());
+	}
+}
+
+void Converter::set_tracer(Tracer* t) {
+	tracer = t;
+	blf.set_tracer(t);
+}
+
+void Converter::convert(std::istream& in) {
+	std::vector<char> chunk(READ_CHUNK_SIZE);
+	while (in) {
+		in.read(chunk.data(), chunk.size());
+		push((const uint8_t*)chunk.data(), (size_t)in.gcount());
+	}
+	end_file();
+	finish();
+}
+
+// Feeds the file to a reader decoding only APP_TEXT objects
+static std::vector<pcapng_exporter::channel_mapping> scan_mappings(std::function<void(BlfReader& reader)> feed) {
+	std::vector<pcapng_exporter::channel_mapping> result;
+	std::vector<pcapng_exporter::channel_mapping> mappings;
+	channel_state channels;
+	BlfReader reader([&](ObjectHeaderBase* ohb) {
+		mappings.clear();
+		configure_channels(&mappings, &channels, reinterpret_cast<AppText*>(ohb));
+		result.insert(result.end(), mappings.begin(), mappings.end());
+	});
+	reader.set_object_filter([](uint32_t object_type) {
+		return object_type == (uint32_t)ObjectType::APP_TEXT;
+	});
+
+	try {
+		feed(reader);
+	}
+	catch (std::runtime_error&) {
+		// Damaged files, keep what was found so far, the data pass reports the error
+	}
+	return result;
+}
+
+std::vector<pcapng_exporter::channel_mapping> scan_channel_mappings(std::istream& in) {
+	return scan_mappings([&in](BlfReader& reader) {
+		std::vector<char> chunk(READ_CHUNK_SIZE);
+		while (in) {
+			in.read(chunk.data(), chunk.size());
+			reader.push((const uint8_t*)chunk.data(), (size_t)in.gcount());
+		}
+	});
+}
+
+std::vector<pcapng_exporter::channel_mapping> scan_channel_mappings(const uint8_t* data, size_t length) {
+	return scan_mappings([data, length](BlfReader& reader) {
+		reader.push(data, length);
+	});
+}
+
+bool Converter::prescan(std::istream& in) {
+	auto start = in.tellg();
+	if (start < 0) {
+		return false;
+	}
+	uint64_t scan_start = tracer ? Tracer::now() : 0;
+	auto found = scan_channel_mappings(in);
+	if (tracer) {
+		tracer->span("prescan", scan_start, Tracer::now());
+	}
+	in.clear();
+	in.seekg(start);
+	if (!in) {
+		return false;
+	}
+	for (const auto& mapping : found) {
+		sink.add_mapping(mapping);
+	}
+	mappings_known = true;
+	return true;
+}
+
+void Converter::prescan(const uint8_t* data, size_t length) {
+	uint64_t scan_start = tracer ? Tracer::now() : 0;
+	auto found = scan_channel_mappings(data, length);
+	if (tracer) {
+		tracer->span("prescan", scan_start, Tracer::now());
+	}
+	for (const auto& mapping : found) {
+		sink.add_mapping(mapping);
+	}
+	mappings_known = true;
+}
+
+void Converter::on_object(ObjectHeaderBase* ohb) {
+	if (!date_known) {
+		date_offset_ns = calculate_startdate(blf.statistics());
+		date_known = true;
+	}
+	if (ohb->objectType == ObjectType::APP_TEXT) {
+		if (mappings_known) {
+			return;
+		}
+		trace_scope scope(tracer, TRACE_MAPPING);
+		mappings.clear();
+		configure_channels(&mappings, &channels, reinterpret_cast<AppText*>(ohb));
+		for (const auto& mapping : mappings) {
+			sink.add_mapping(mapping);
+		}
+		return;
+	}
+	trace_scope scope(tracer, TRACE_ENCODE);
+	sink.write_object(ohb, date_offset_ns);
+}
+
+}
@@ -0,0 +1,105 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_CONVERTER_H
+#define _APP_CONVERTER_H
+
+#include <cstdint>
+#include <istream>
+#include <vector>
+
+#include <Vector/BLF.h>
+#include <pcapng_exporter/pcapng_exporter.hpp>
+
+#include "blf_reader.hpp"
+#include "channels.hpp"
+#include "encoder.hpp"
+
+namespace blf_converter {
+
+// Converts one BLF stream. All state lives in the instance, so several
+// conversions can run concurrently in the same process.
+//
+//   PcapngWriter writer([](const uint8_t* data, size_t length) { ... });
+//   PacketEncoder encoder(writer);
+//   Converter converter(encoder);
+//   converter.push(chunk, chunk_length); // as often as needed
+//   converter.finish();
+class Converter {
+public:
+	explicit Converter(ObjectSink& sink);
+
+	// Feeds raw BLF bytes, in chunks of any size
+	void push(const uint8_t* data, size_t length);
+
+	// Feeds the already inflated object stream of log containers
+	void push_uncompressed(const uint8_t* data, size_t length);
+
+	// Starts the next file of a split recording. Its objects count from the start
+	// of the measurement, so the start date of the first file applies to all files.
+	// Channels, mappings and the sink carry over.
+	void begin_file();
+
+	// Starts the next of several separate recordings, e.g. the files of an
+	// archive. Its objects count from its own start date, channels, mappings and
+	// the sink carry over.
+	void begin_recording();
+
+	// Ends the input of the current file, throws std::runtime_error if it ended
+	// within an object, e.g. because the file is truncated
+	void end_file();
+
+	// Flushes the sink, to be called once the whole input was pushed
+	void finish();
+
+	// Pushes the whole stream and finishes the conversion. Throws std::runtime_error
+	// on damaged or truncated input, the caller then still calls finish().
+	void convert(std::istream& in);
+
+	// Reads the channel mappings of the whole file before converting it, so they
+	// apply from the first packet on. The stream is rewound to where it was,
+	// returns false if it is not seekable.
+	bool prescan(std::istream& in);
+
+	// Same for a file held in memory
+	void prescan(const uint8_t* data, size_t length);
+
+	const BlfReader& reader() const { return blf; }
+
+	// Receives the inflated object stream of every log container, e.g. for caching
+	void set_container_callback(BlfReader::container_callback callback) { blf.set_container_callback(std::move(callback)); }
+
+	// Records the time spent per stage, nullptr disables tracing
+	void set_tracer(Tracer* t);
+
+private:
+	ObjectSink& sink;
+	BlfReader blf;
+	channel_state channels;
+	std::vector<pcapng_exporter::channel_mapping> mappings;
+	Tracer* tracer = nullptr;
+	bool mappings_known = false;
+	bool date_known = false;
+	uint64_t date_offset_ns = 0;
+
+	void on_object(Vector::BLF::ObjectHeaderBase* ohb);
+};
+
+// Collects the channel mappings of all APP_TEXT objects, other objects are not decoded
+std::vector<pcapng_exporter::channel_mapping> scan_channel_mappings(std::istream& in);
+std::vector<pcapng_exporter::channel_mapping> scan_channel_mappings(const uint8_t* data, size_t length);
+
+// Measurement start as nanoseconds since the epoch, 0 if unknown
+uint64_t calculate_startdate(const Vector::BLF::FileStatistics& statistics);
+
+// Local time of a BLF timestamp as nanoseconds since the epoch, 0 if invalid
+uint64_t systemtime_to_ns(const Vector::BLF::SYSTEMTIME& time);
+
+// Inverse of systemtime_to_ns: the local time fields the BLF file held, counted
+// in nanoseconds from 1970-01-01 00:00 of the local calendar, for printing dates
+uint64_t local_clock_ns(uint64_t ns);
+
+}
+
+#endif
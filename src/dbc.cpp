@@ -0,0 +1,181 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "dbc.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace blf_converter {
+
+static std::string trim(const std::string& text) {
+	size_t start = text.find_first_not_of(" \t\r");
+	if (start == std::string::npos) {
+		return "";
+	}
+	size_t end = text.find_last_not_of(" \t\r");
+	return text.substr(start, end - start + 1);
+}
+
+static bool starts_with(const std::string& text, const char* prefix) {
+	return text.compare(0, strlen(prefix), prefix) == 0;
+}
+
+// " SG_ Name [M|mN] : start|length@order sign (factor,offset) [min|max] "unit" receivers"
+static dbc_signal parse_signal(const std::string& line, dbc_message* message) {
+	dbc_signal signal = {};
+	size_t colon = line.find(':');
+	if (colon == std::string::npos) {
+		throw std::invalid_argument("Expected ':'");
+	}
+
+	std::istringstream head(line.substr(3, colon - 3));
+	std::string multiplex;
+	head >> signal.name >> multiplex;
+	if (signal.name.empty()) {
+		throw std::invalid_argument("Missing signal name");
+	}
+	if (multiplex == "M") {
+		message->multiplexor = (int)message->signals.size();
+	}
+	else if (!multiplex.empty() && multiplex[0] == 'm') {
+		signal.multiplex_value = std::stoll(multiplex.substr(1));
+	}
+
+	unsigned start = 0, length = 0;
+	char order = 0, sign = 0;
+	if (sscanf(line.c_str() + colon + 1, " %u|%u@%c%c (%lf ,%lf )", &start, &length, &order, &sign, &signal.factor, &signal.offset) != 6
+		|| (order != '0' && order != '1') || (sign != '+' && sign != '-')) {
+		throw std::invalid_argument("Expected start|length@order sign (factor,offset)");
+	}
+	signal.start_bit = start;
+	signal.length = length;
+	signal.big_endian = order == '0';
+	signal.is_signed = sign == '-';
+
+	size_t unit_start = line.find('"', colon);
+	size_t unit_end = unit_start == std::string::npos ? std::string::npos : line.find('"', unit_start + 1);
+	if (unit_end != std::string::npos) {
+		signal.unit = line.substr(unit_start + 1, unit_end - unit_start - 1);
+	}
+	return signal;
+}
+
+static void compile_signal(dbc_signal& signal, dbc_message& message) {
+	if (signal.length < 1 || signal.length > 64) {
+		throw std::invalid_argument("Invalid length of signal " + signal.name);
+	}
+	if ((signal.value_type == dbc_value_type::FLOAT32 && signal.length != 32)
+		|| (signal.value_type == dbc_value_type::FLOAT64 && signal.length != 64)) {
+		throw std::invalid_argument("Invalid length of float signal " + signal.name);
+	}
+	signal.mask = signal.length == 64 ? ~(uint64_t)0 : ((uint64_t)1 << signal.length) - 1;
+
+	if (signal.big_endian) {
+		// The start bit is the most significant one, bytes count down towards the
+		// least significant bit. In the reversed buffer they count up as for Intel signals.
+		int64_t msb = (int64_t)(63 - signal.start_bit / 8) * 8 + signal.start_bit % 8;
+		int64_t lsb = msb - (signal.length - 1);
+		if (signal.start_bit >= 512 || lsb < 0) {
+			throw std::invalid_argument("Signal " + signal.name + " exceeds 64 bytes");
+		}
+		signal.lsb = (uint32_t)lsb;
+		signal.required_bytes = 64 - signal.lsb / 8;
+		message.has_motorola = true;
+	}
+	else {
+		if (signal.start_bit + signal.length > 512) {
+			throw std::invalid_argument("Signal " + signal.name + " exceeds 64 bytes");
+		}
+		signal.lsb = signal.start_bit;
+		signal.required_bytes = (signal.start_bit + signal.length + 7) / 8;
+		message.has_intel = true;
+	}
+}
+
+dbc_database parse_dbc(const std::string& text) {
+	dbc_database database;
+	dbc_message* message = nullptr;
+	std::istringstream in(text);
+	std::string raw_line;
+	size_t line_number = 0;
+	try {
+		while (std::getline(in, raw_line)) {
+			line_number++;
+			std::string line = trim(raw_line);
+			if (line.empty()) {
+				// Signals follow their message without blank lines
+				message = nullptr;
+			}
+			else if (starts_with(line, "BO_ ")) {
+				std::istringstream fields(line.substr(4));
+				unsigned long id;
+				std::string name;
+				if (!(fields >> id >> name)) {
+					throw std::invalid_argument("Expected BO_ id name:");
+				}
+				if (name.back() == ':') {
+					name.pop_back();
+				}
+				message = &database.messages[(uint32_t)id];
+				*message = dbc_message();
+				message->id = (uint32_t)id;
+				message->name = name;
+			}
+			else if (starts_with(line, "SG_ ") && message) {
+				message->signals.push_back(parse_signal(line, message));
+			}
+			else if (starts_with(line, "SIG_VALTYPE_ ")) {
+				// SIG_VALTYPE_ id name : 1;
+				std::istringstream fields(line.substr(13));
+				unsigned long id;
+				std::string name, colon;
+				int type = 0;
+				fields >> id >> name >> colon >> type;
+				auto it = database.messages.find((uint32_t)id);
+				if (it == database.messages.end()) {
+					continue;
+				}
+				for (auto& signal : it->second.signals) {
+					if (signal.name == name) {
+						signal.value_type = type == 1 ? dbc_value_type::FLOAT32 : type == 2 ? dbc_value_type::FLOAT64 : dbc_value_type::INTEGER;
+					}
+				}
+			}
+		}
+		line_number = 0;
+		for (auto& item : database.messages) {
+			for (auto& signal : item.second.signals) {
+				compile_signal(signal, item.second);
+			}
+		}
+	}
+	catch (std::exception& e) {
+		if (line_number) {
+			throw std::runtime_error("DBC line " + std::to_string(line_number) + ": " + e.what());
+		}
+		throw std::runtime_error(std::string("DBC: ") + e.what());
+	}
+	return database;
+}
+
+dbc_database load_dbc(const std::string& path) {
+	std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+	if (!in.is_open()) {
+		throw std::runtime_error("Unable to open: " + path);
+	}
+	std::ostringstream text;
+	text << in.rdbuf();
+	try {
+		return parse_dbc(text.str());
+	}
+	catch (std::runtime_error& e) {
+		throw std::runtime_error(path + ": " + e.what());
+	}
+}
+
+}
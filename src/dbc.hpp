@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_DBC_H
+#define _APP_DBC_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "blf_format.hpp"
+
+// Set in message ids of extended CAN frames, as in DBC files
+#define DBC_EXTENDED_ID 0x80000000
+
+// Frames of up to 64 bytes, plus 8 bytes read beyond the last signal
+#define DBC_BUFFER_SIZE 72
+
+namespace blf_converter {
+
+enum class dbc_value_type : uint8_t {
+	INTEGER, FLOAT32, FLOAT64
+};
+
+struct dbc_signal {
+	std::string name;
+	std::string unit;
+	// As written in the DBC file: start bit of Intel signals is their least, of
+	// Motorola signals their most significant bit
+	uint32_t start_bit;
+	uint32_t length;
+	bool big_endian;
+	bool is_signed;
+	dbc_value_type value_type = dbc_value_type::INTEGER;
+	double factor;
+	double offset;
+	// Multiplexed signals are only present for this value of the multiplexor, -1 for all others
+	int64_t multiplex_value = -1;
+
+	// Compiled: position of the least significant bit in the frame buffer (Intel)
+	// or in the reversed frame buffer (Motorola), its mask and the frame length it needs
+	uint32_t lsb;
+	uint64_t mask;
+	uint32_t required_bytes;
+};
+
+struct dbc_message {
+	uint32_t id;
+	std::string name;
+	std::vector<dbc_signal> signals;
+	// Index of the multiplexor signal, -1 if there is none
+	int multiplexor = -1;
+	bool has_intel = false;
+	bool has_motorola = false;
+};
+
+// Messages by id (DBC_EXTENDED_ID set for extended frames)
+struct dbc_database {
+	std::unordered_map<uint32_t, dbc_message> messages;
+};
+
+// Reads messages, signals (with simple multiplexing) and signal value types,
+// all other sections are skipped. Throws std::runtime_error with the line of errors.
+dbc_database parse_dbc(const std::string& text);
+dbc_database load_dbc(const std::string& path);
+
+inline uint64_t extract_bits(const uint8_t* buffer, const dbc_signal& signal) {
+	const uint8_t* p = buffer + signal.lsb / 8;
+	uint32_t shift = signal.lsb % 8;
+	// The ninth byte holds the top bits of 64 bit signals not aligned to a byte,
+	// shifted in two steps so that a shift of 0 drops it without a branch
+	uint64_t raw = read_le64(p) >> shift | (uint64_t)p[8] << 1 << (63 - shift);
+	return raw & signal.mask;
+}
+
+inline double physical_value(const dbc_signal& signal, uint64_t raw) {
+	switch (signal.value_type) {
+	case dbc_value_type::FLOAT32: {
+		uint32_t bits = (uint32_t)raw;
+		float value;
+		memcpy(&value, &bits, sizeof(value));
+		return value * signal.factor + signal.offset;
+	}
+	case dbc_value_type::FLOAT64: {
+		double value;
+		memcpy(&value, &raw, sizeof(value));
+		return value * signal.factor + signal.offset;
+	}
+	default: {
+		// Sign extension by shifting the top bit of the signal to bit 63 and back
+		uint32_t unused = 64 - signal.length;
+		double extended = (double)((int64_t)(raw << unused) >> unused);
+		double value = signal.is_signed ? extended : (double)raw;
+		return value * signal.factor + signal.offset;
+	}
+	}
+}
+
+// Calls on_value(signal index, physical value) for every signal of the message
+// contained in the frame
+template<class Callback>
+void decode_signals(const dbc_message& message, const uint8_t* data, size_t length, Callback on_value) {
+	length = length < 64 ? length : 64;
+	uint8_t forward[DBC_BUFFER_SIZE];
+	uint8_t reversed[DBC_BUFFER_SIZE];
+	if (message.has_intel) {
+		memcpy(forward, data, length);
+		memset(forward + length, 0, sizeof(forward) - length);
+	}
+	if (message.has_motorola) {
+		// Byte i of the frame becomes byte 63 - i, so Motorola signals read like Intel ones
+		memset(reversed, 0, sizeof(reversed));
+		for (size_t i = 0; i < length; i++) {
+			reversed[63 - i] = data[i];
+		}
+	}
+
+	int64_t multiplex = -1;
+	if (message.multiplexor >= 0) {
+		const dbc_signal& signal = message.signals[message.multiplexor];
+		if (signal.required_bytes <= length) {
+			multiplex = (int64_t)extract_bits(signal.big_endian ? reversed : forward, signal);
+		}
+	}
+
+	for (size_t i = 0; i < message.signals.size(); i++) {
+		const dbc_signal& signal = message.signals[i];
+		if (signal.required_bytes > length || (signal.multiplex_value >= 0 && signal.multiplex_value != multiplex)) {
+			continue;
+		}
+		uint64_t raw = extract_bits(signal.big_endian ? reversed : forward, signal);
+		on_value(i, physical_value(signal, raw));
+	}
+}
+
+}
+
+#endif
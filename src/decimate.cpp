@@ -0,0 +1,68 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "decimate.hpp"
+
+#include <algorithm>
+
+#define NANOS_PER_SEC 1000000000
+
+namespace blf_converter {
+
+DecimationSink::DecimationSink(ObjectSink& next, uint32_t keep_every, double max_rate)
+	: next(next),
+	keep_every(keep_every > 0 ? keep_every : 1),
+	frame_cost_ns(max_rate > 0 ? (uint64_t)(NANOS_PER_SEC / max_rate) : 0),
+	bucket_ns(std::max<uint64_t>(NANOS_PER_SEC, frame_cost_ns))
+{
+}
+
+void DecimationSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (make_frame_view(ohb, date_offset_ns, &view) && !keep(view)) {
+		return;
+	}
+	kept_count++;
+	next.write_object(ohb, date_offset_ns);
+}
+
+bool DecimationSink::keep(const frame_view& view) {
+	if (view.flags & FRAME_FLAG_ERROR) {
+		return true;
+	}
+	message_state& state = messages[view.key()];
+	if (state.seen++ % keep_every != 0) {
+		count_drops++;
+		return false;
+	}
+	if (!frame_cost_ns) {
+		return true;
+	}
+	if (!state.started) {
+		state.started = true;
+		state.credit_ns = bucket_ns;
+	}
+	else if (view.timestamp_ns > state.last_ns) {
+		// Objects are not strictly ordered, older frames add no tokens
+		state.credit_ns = std::min(bucket_ns, state.credit_ns + (view.timestamp_ns - state.last_ns));
+	}
+	state.last_ns = std::max(state.last_ns, view.timestamp_ns);
+	if (state.credit_ns < frame_cost_ns) {
+		rate_drops++;
+		return false;
+	}
+	state.credit_ns -= frame_cost_ns;
+	return true;
+}
+
+void DecimationSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	next.add_mapping(mapping);
+}
+
+void DecimationSink::flush() {
+	next.flush();
+}
+
+}
@@ -0,0 +1,59 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_DECIMATE_H
+#define _APP_DECIMATE_H
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "encoder.hpp"
+#include "frame_view.hpp"
+
+namespace blf_converter {
+
+// Drops frames before they are encoded: only every Nth frame per message
+// (interface and identifier) is kept, and at most max_rate frames per second
+// per message. The rate is limited by a token bucket per message that holds
+// max_rate frames (at least one) and refills at max_rate per second, so that
+// jitter of a message running at the limit drops nothing. Error frames and
+// objects that are no bus frames always pass.
+class DecimationSink : public ObjectSink {
+public:
+	// keep_every 1 and max_rate 0 keep everything
+	DecimationSink(ObjectSink& next, uint32_t keep_every, double max_rate);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+	uint64_t kept() const { return kept_count; }
+	uint64_t dropped_by_count() const { return count_drops; }
+	uint64_t dropped_by_rate() const { return rate_drops; }
+
+private:
+	struct message_state {
+		uint64_t seen = 0;
+		// Tokens of the bucket counted in ns, a frame takes frame_cost_ns
+		uint64_t credit_ns = 0;
+		uint64_t last_ns = 0;
+		bool started = false;
+	};
+
+	ObjectSink& next;
+	uint32_t keep_every;
+	uint64_t frame_cost_ns;
+	uint64_t bucket_ns;
+	std::unordered_map<uint64_t, message_state> messages;
+
+	uint64_t kept_count = 0;
+	uint64_t count_drops = 0;
+	uint64_t rate_drops = 0;
+
+	bool keep(const frame_view& view);
+};
+
+}
+
+#endif
@@ -0,0 +1,994 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "encoder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "endianness.h"
+#include <pcapng_exporter/lin.h>
+#include <pcapng_exporter/linktype.h>
+
+using namespace Vector::BLF;
+
+#define HAS_FLAG(var,pos) ((var) & (1<<(pos)))
+
+#define NANOS_PER_SEC 1000000000
+// Mask used to avoid overflow issues with Timestamp
+#define TIMESTAMP_MASK 0x7fffffffffffffff
+
+#define DIR_IN    1
+#define DIR_OUT   2
+
+namespace blf_converter {
+
+// Enumerations
+enum class FlexRayPacketType
+{
+	FlexRayFrame = 1,    // FlexRay Frame
+	FlexRaySymbol = 2     // FlexRay Symbol
+};
+
+class CanFrame {
+private:
+	uint8_t raw[72] = { 0 };
+public:
+
+	uint32_t id() {
+		return ntoh32(*(uint32_t*)raw) & 0x1fffffff;
+	}
+
+	void id(uint32_t value) {
+		uint8_t id_flags = *raw & 0xE0;
+		*(uint32_t*)raw = hton32(value);
+		*raw |= id_flags;
+	}
+
+	bool ext() {
+		return (*raw & 0x80) != 0;
+	}
+	void ext(bool value) {
+		uint8_t masked = *raw & 0x7F;
+		*raw = masked | value << 7;
+	}
+
+	bool rtr() {
+		return (*raw & 0x40) != 0;
+	}
+	void rtr(bool value) {
+		uint8_t masked = *raw & 0xBF;
+		*raw = masked | value << 6;
+	}
+
+	bool err() {
+		return (*raw & 0x20) != 0;
+	}
+	void err(bool value) {
+		uint8_t masked = *raw & 0xDF;
+		*raw = masked | value << 5;
+	}
+
+	bool brs() {
+		return (*(raw + 5) & 0x01) != 0;
+	}
+	void brs(bool value) {
+		uint8_t masked = *(raw + 5) & 0xFE;
+		*(raw + 5) = masked | value << 0;
+	}
+
+	bool esi() {
+		return (*(raw + 5) & 0x02) != 0;
+	}
+	void esi(bool value) {
+		uint8_t masked = *(raw + 5) & 0xFD;
+		*(raw + 5) = masked | value << 1;
+	}
+	
+	bool fdf() {
+		return (*(raw + 5) & 0x04) != 0;
+	}
+	void fdf(bool value) {
+		uint8_t masked = *(raw + 5) & 0xFB;
+		*(raw + 5) = masked | value << 2;
+	}
+
+	uint8_t len() {
+		return *(raw + 4);
+	}
+	void len(uint8_t value) {
+		*(raw + 4) = value;
+	}
+
+	const uint8_t* data() {
+		return raw + 8;
+	}
+	void data(const uint8_t* value, size_t size) {
+		memcpy(raw + 8, value, size);
+	}
+
+	const uint8_t* bytes() {
+		return raw;
+	}
+
+	const uint8_t size() {
+		return len() + 8;
+	}
+
+};
+
+template<class ObjectHeaderGeneric>
+std::uint64_t calculate_ts_res(ObjectHeaderGeneric* oh)
+{
+	uint64_t ts_resol = 0;
+	switch (oh->objectFlags) {
+	case ObjectHeader::ObjectFlags::TimeTenMics:
+		ts_resol = 100000;
+		break;
+	case ObjectHeader::ObjectFlags::TimeOneNans:
+		ts_resol = NANOS_PER_SEC;
+		break;
+	default:
+		fprintf(stderr, "ERROR: The timestamp format is unknown (not 10us nor ns)!\n");
+		break;
+	}
+	return ts_resol;
+}
+
+template<class ObjectHeaderGeneric>
+pcapng_exporter::frame_header generate_header(
+	ObjectHeaderGeneric* oh,
+	std::uint64_t date_offset_ns)
+{
+	pcapng_exporter::frame_header header = pcapng_exporter::frame_header();
+	header.channel_id = oh->channel;
+	header.timestamp_resolution = calculate_ts_res(oh);
+	uint64_t relative_timestamp = (NANOS_PER_SEC / header.timestamp_resolution) * oh->objectTimeStamp;
+	// To avoid overflow issues that are handled differently in different OS
+	uint64_t ts = (relative_timestamp & TIMESTAMP_MASK) + (date_offset_ns & TIMESTAMP_MASK);
+	header.timestamp.tv_sec = ts / NANOS_PER_SEC;
+	header.timestamp.tv_nsec = ts % NANOS_PER_SEC;
+	return header;
+}
+
+// Only the first snap length bytes of data are read, so callers may pass a buffer
+// holding just these when the frame is longer
+template <class ObjHeader>
+int write_packet(
+	packet_output& out,
+	uint16_t link_type,
+	ObjHeader* oh,
+	uint32_t length,
+	const uint8_t* data,
+	uint64_t date_offset_ns,
+	uint32_t flags = 0,
+	uint32_t hw_channel = 0
+) {
+	uint64_t ts_resol = calculate_ts_res(oh);
+	if (ts_resol == 0) return -3;
+
+	light_packet_header header = { 0 };
+	uint64_t relative_timestamp = (NANOS_PER_SEC / ts_resol) * oh->objectTimeStamp;
+	uint64_t ts = (relative_timestamp & TIMESTAMP_MASK) + (date_offset_ns & TIMESTAMP_MASK);
+	header.timestamp.tv_sec = ts / NANOS_PER_SEC;
+	header.timestamp.tv_nsec = ts % NANOS_PER_SEC;
+	header.captured_length = std::min(length, out.snaplen.get(link_type));
+	header.original_length = length;
+	header.flags = flags;
+
+	out.sink.write_packet(link_type, oh->channel, hw_channel, header, data);
+
+	return 0;
+}
+
+// CAN_MESSAGE = 1
+void write(packet_output& out, CanMessage* obj, uint64_t date_offset_ns) {
+	CanFrame can;
+
+	can.id(obj->id);
+	can.rtr(HAS_FLAG(obj->flags, 7));
+	can.len(obj->dlc);
+	can.data(obj->data.data(), obj->data.size());
+
+	uint32_t flags = HAS_FLAG(obj->flags, 0) ? DIR_OUT : DIR_IN;
+	write_packet(out, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns, flags);
+}
+
+// CAN_MESSAGE2
+void write(packet_output& out, CanMessage2* obj, uint64_t date_offset_ns) {
+	CanFrame can;
+
+	can.id(obj->id);
+	can.rtr(HAS_FLAG(obj->flags, 7));
+	can.len(obj->dlc);
+	can.data(obj->data.data(), obj->data.size());
+
+	uint32_t flags = HAS_FLAG(obj->flags, 0) ? DIR_OUT : DIR_IN;
+
+	write_packet(out, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns, flags);
+}
+
+template <class CanError>
+void write_can_error(packet_output& out, CanError* obj, uint64_t date_offset_ns) {
+
+	CanFrame can;
+	can.err(true);
+	can.len(8);
+	write_packet(out, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns);
+}
+
+// CAN_ERROR = 2
+void write(packet_output& out, CanErrorFrame* obj, uint64_t date_offset_ns) {
+
+	write_can_error(out, obj, date_offset_ns);
+}
+
+// CAN_ERROR_EXT = 73
+void write(packet_output& out, CanErrorFrameExt* obj, uint64_t date_offset_ns) {
+
+	write_can_error(out, obj, date_offset_ns);
+}
+
+// CAN_FD_MESSAGE = 100
+void write(packet_output& out, CanFdMessage* obj, uint64_t date_offset_ns) {
+
+	CanFrame can;
+
+	can.id(obj->id);
+
+	can.rtr(HAS_FLAG(obj->flags, 7));
+
+	// https://www.tcpdump.org/linktypes/LINKTYPE_CAN_SOCKETCAN.html : set CANFD_FDF flags
+	can.fdf(HAS_FLAG(obj->canFdFlags, 0));
+	can.brs(HAS_FLAG(obj->canFdFlags, 1));
+	can.esi(HAS_FLAG(obj->canFdFlags, 2));
+
+	can.len(obj->validDataBytes);
+	can.data(obj->data.data(), obj->data.size());
+
+	uint32_t flags = HAS_FLAG(obj->flags, 0) ? DIR_OUT : DIR_IN;
+
+	write_packet(out, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns, flags);
+}
+
+// CAN_FD_MESSAGE_64 = 101
+void write(packet_output& out, CanFdMessage64* obj, uint64_t date_offset_ns) {
+
+	CanFrame can;
+
+	can.id(obj->id);
+
+	can.rtr(HAS_FLAG(obj->flags, 4));
+
+	// https://www.tcpdump.org/linktypes/LINKTYPE_CAN_SOCKETCAN.html : set CANFD_FDF flags
+	can.fdf(HAS_FLAG(obj->flags, 12));
+	can.brs(HAS_FLAG(obj->flags, 13));
+	can.esi(HAS_FLAG(obj->flags, 14));
+
+	can.len(obj->validDataBytes);
+	can.data(obj->data.data(), obj->data.size());
+
+	// TODO obj->crc
+
+	uint32_t flags = HAS_FLAG(obj->flags, 6) || HAS_FLAG(obj->flags, 7) ? DIR_OUT : DIR_IN;
+
+	write_packet(out, LINKTYPE_CAN, obj, can.size(), can.bytes(), date_offset_ns);
+}
+
+// CAN_FD_ERROR_64 = 104
+void write(packet_output& out, CanFdErrorFrame64* obj, uint64_t date_offset_ns) {
+
+	write_can_error(out, obj, date_offset_ns);
+}
+
+// ETHERNET_FRAME = 71
+void write(packet_output& out, EthernetFrame* obj, uint64_t date_offset_ns) {
+
+	uint32_t flags = 0;
+	switch (obj->dir)
+	{
+	case 0:
+		flags = DIR_IN;
+		break;
+	case 1:
+		flags = DIR_OUT;
+		break;
+	}
+
+	uint32_t header_length = obj->tpid ? 18 : 14;
+	uint32_t length = header_length + (uint32_t)obj->payLoad.size();
+	uint32_t captured = std::min(length, out.snaplen.ethernet);
+
+	std::vector<uint8_t> eth;
+	// Pre allocate to remove need of reallocation
+	eth.reserve(std::max(captured, header_length));
+
+	eth.insert(eth.end(), obj->destinationAddress.begin(), obj->destinationAddress.end());
+	eth.insert(eth.end(), obj->sourceAddress.begin(), obj->sourceAddress.end());
+
+	if (obj->tpid) {
+		std::array<uint8_t, 4> vlan = {
+			(uint8_t)(obj->tpid >> 8),
+			(uint8_t)obj->tpid,
+			(uint8_t)(obj->tci >> 8),
+			(uint8_t)obj->tci
+		};
+		eth.insert(eth.end(), vlan.begin(), vlan.end());
+	}
+
+	eth.push_back((uint8_t)(obj->type >> 8));
+	eth.push_back((uint8_t)obj->type);
+
+	// Payload bytes beyond the snap length are never copied
+	if (captured > header_length) {
+		eth.insert(eth.end(), obj->payLoad.begin(), obj->payLoad.begin() + (captured - header_length));
+	}
+
+	write_packet(out, LINKTYPE_ETHERNET, obj, length, eth.data(), date_offset_ns, flags);
+}
+
+template <class TEthernetFrame>
+void write_ethernet_frame(packet_output& out, TEthernetFrame* obj, uint64_t date_offset_ns) {
+	uint32_t flags = 0;
+	switch (obj->dir)
+	{
+	case 0:
+		flags = DIR_IN;
+		break;
+	case 1:
+		flags = DIR_OUT;
+		break;
+	}
+
+	write_packet(out, LINKTYPE_ETHERNET, obj, (uint32_t)obj->frameData.size(), obj->frameData.data(), date_offset_ns, flags, obj->hardwareChannel);
+}
+
+// ETHERNET_FRAME_EX = 120
+void write(packet_output& out, EthernetFrameEx* obj, uint64_t date_offset_ns) {
+
+	write_ethernet_frame(out, obj, date_offset_ns);
+}
+
+// ETHERNET_FRAME_FORWARDED = 121
+void write(packet_output& out, EthernetFrameForwarded* obj, uint64_t date_offset_ns) {
+
+	write_ethernet_frame(out, obj, date_offset_ns);
+}
+
+void set_measurment_header(uint8_t& measurementHeader, FlexRayPacketType packetType, uint16_t channelMask = 0)
+{
+	/// Measurement Header (1 byte)
+	// TI[0..6]: Type Index
+	// 0x01: FlexRay Frame
+	// 0x02: FlexRay Symbol
+	switch (packetType)
+	{
+	case FlexRayPacketType::FlexRayFrame:
+		measurementHeader = 0x01;
+		break;
+	case FlexRayPacketType::FlexRaySymbol:
+		measurementHeader = 0x02;
+		break;
+	}
+	// CH: Channel, indicates the Channel
+	// 1	: Channel A
+	// 2/3	: Channel B
+	switch (channelMask)
+	{
+	case 1: /* Channel A */
+		break;
+	case 2: /* Channel B */
+	case 3: /* Channel B */
+		measurementHeader |= 0x80;
+		break;
+	}
+}
+
+void set_header_crc(uint16_t channelMask, uint16_t headerCrc1, uint16_t headerCrc2, uint16_t& headerCrc)
+{
+	// CH: Channel, indicates the Channel
+	// 1	: Channel A
+	// 2/3	: Channel B
+	switch (channelMask)
+	{
+	case 1: /* Channel A */
+		headerCrc = headerCrc1;
+		break;
+	case 2: /* Channel B */
+	case 3: /* Channel B */
+		headerCrc = headerCrc2;
+		break;
+	}
+}
+
+void set_header_flags(uint16_t frameState, uint8_t& headerFlags)
+{
+	if (HAS_FLAG(frameState, 0))
+	{
+		headerFlags |= 0x08; // Payload preample indicator bit set to 1
+	}
+	if (HAS_FLAG(frameState, 1))
+	{
+		headerFlags |= 0x02; // Sync. frame indicator bit set to 1
+	}
+	if (HAS_FLAG(frameState, 2))
+	{
+		headerFlags |= 0x10; // Reserved bit set to 1
+	}
+	if (!HAS_FLAG(frameState, 3))
+	{
+		headerFlags |= 0x04; // Null frame indicator bit set to 1
+	}
+	if (HAS_FLAG(frameState, 4))
+	{
+		headerFlags |= 0x01; // Startup frame indicator bit set to 1
+	}
+}
+
+void set_header_flags_rcv_msg(uint32_t frameFlags, uint8_t& headerFlags)
+{
+	if (!HAS_FLAG(frameFlags, 0))
+	{
+		headerFlags |= 0x04; // Null frame indicator bit set to 1
+	}
+	if (HAS_FLAG(frameFlags, 2))
+	{
+		headerFlags |= 0x02; // Sync. frame indicator bit set to 1
+	}
+	if (HAS_FLAG(frameFlags, 3))
+	{
+		headerFlags |= 0x01; // Startup frame indicator bit set to 1
+	}
+	if (HAS_FLAG(frameFlags, 4))
+	{
+		headerFlags |= 0x08; // Payload preample indicator bit set to 1
+	}
+	if (HAS_FLAG(frameFlags, 5))
+	{
+		headerFlags |= 0x10; // Reserved bit set to 1
+	}
+}
+
+void set_header(uint64_t& header, uint8_t headerFlags, uint64_t payloadLength, uint8_t cycleCount = 0, uint16_t frameId = 0, uint16_t headerCrc = 0)
+{
+	header = (static_cast<uint64_t>(headerFlags) << 35) | (static_cast<uint64_t>(payloadLength & 0x7F) << 17);
+	if (cycleCount != 0)
+	{
+		header |= static_cast<uint64_t>(cycleCount & 0x3F);
+	}
+	if (frameId != 0)
+	{
+		header |= (static_cast<uint64_t>(frameId & 0x07FF) << 24);
+	}
+	if (headerCrc != 0)
+	{
+		header |= (static_cast<uint64_t>(headerCrc & 0x07FF) << 6);
+	}
+
+	// Convert from Host Byte Order to Network Byte Order (network order is big endian)
+	header = hton64(header);
+}
+
+// FLEXRAY_DATA = 29
+void write(packet_output& out, FlexRayData* obj, uint64_t date_offset_ns) {
+
+	uint64_t header = 0;
+	uint8_t headerFlags = 0;
+	std::array<uint8_t, 261> flexrayData;
+
+	memset(&flexrayData, 0, sizeof(flexrayData));
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame);
+
+	/// Error Flags Information (1 byte) -> set to 0
+
+	/// FlexRay Frame Header (5 bytes)
+	//  - Header flags
+	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
+	//  - Payload length
+	uint64_t len = obj->dataBytes.size() / 2;
+	set_header(header, headerFlags, len, 0, obj->messageId, obj->crc);
+
+	// Copy only 5 bytes of header to flexrayData
+	uint8_t* headerPtr = (uint8_t*)&header;
+	memcpy(&flexrayData[2], headerPtr + 3, 5);
+
+	// FlexRay Frame Payload (0-254 bytes)
+	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
+}
+
+// FLEXRAY_SYNC = 30
+void write(packet_output& out, FlexRaySync* obj, uint64_t date_offset_ns) {
+
+	uint64_t header = 0;
+	uint8_t headerFlags = 0;
+	std::array<uint8_t, 261> flexrayData;
+
+	memset(&flexrayData, 0, sizeof(flexrayData));
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame);
+
+	/// Error Flags Information (1 byte) -> set to 0
+
+	/// FlexRay Frame Header (5 bytes)
+	//  - Header flags
+	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
+	headerFlags |= 0x02; // Sync. frame indicator bit set to 1
+
+	/// FlexRay Frame Header (5 bytes)
+	//  - Payload length
+	uint64_t len = obj->dataBytes.size() / 2;
+	set_header(header, headerFlags, len, obj->cycle, obj->messageId, obj->crc);
+
+	// Copy only 5 bytes of header to flexrayData
+	uint8_t* headerPtr = (uint8_t*)&header;
+	memcpy(&flexrayData[2], headerPtr + 3, 5);
+
+	// FlexRay Frame Payload (0-254 bytes)
+	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
+}
+
+// FLEXRAY_CYCLE = 40
+void write(packet_output& out, FlexRayV6StartCycleEvent* obj, uint64_t date_offset_ns) {
+
+	uint64_t header = 0;
+	uint8_t headerFlags = 0;
+	std::array<uint8_t, 261> flexrayData;
+
+	memset(&flexrayData, 0, sizeof(flexrayData));
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame);
+
+	/// Error Flags Information (1 byte) -> set to 0
+
+	/// FlexRay Frame Header (5 bytes)
+	//  - Header flags
+	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
+	//  - Payload length
+	uint64_t len = obj->dataBytes.size() / 2;
+	set_header(header, headerFlags, len);
+
+	// Copy only 5 bytes of header to flexrayData
+	uint8_t* headerPtr = (uint8_t*)&header;
+	memcpy(&flexrayData[2], headerPtr + 3, 5);
+
+	// FlexRay Frame Payload (0-254 bytes)
+	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
+}
+
+// FLEXRAY_MESSAGE = 41
+void write(packet_output& out, FlexRayV6Message* obj, uint64_t date_offset_ns) {
+
+	uint64_t header = 0;
+	uint8_t headerFlags = 0;
+	std::array<uint8_t, 261> flexrayData;
+
+	memset(&flexrayData, 0, sizeof(flexrayData));
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame);
+
+	/// Error Flags Information (1 byte) -> set to 0
+
+	/// FlexRay Frame Header (5 bytes)
+	set_header_flags(obj->frameState, headerFlags);
+	uint64_t len = obj->dataBytes.size() / 2;
+	set_header(header, headerFlags, len, obj->cycle, obj->frameId, obj->headerCrc);
+
+	// Copy only 5 bytes of header to flexrayData
+	uint8_t* headerPtr = (uint8_t*)&header;
+	memcpy(&flexrayData[2], headerPtr + 3, 5);
+
+	// FlexRay Frame Payload (0-254 bytes)
+	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
+}
+
+// FR_ERROR = 47
+void write(packet_output& out, FlexRayVFrError* obj, uint64_t date_offset_ns) {
+
+	uint64_t header = 0;
+	uint8_t headerFlags = 0;
+	std::array<uint8_t, 7> flexrayData;
+
+	memset(&flexrayData, 0, sizeof(flexrayData));
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame, obj->channelMask);
+
+	/// Error Flags Information (1 byte)
+	flexrayData[1] |= 0x02; // Coding error bit (CODERR) set to 1
+
+	/// FlexRay Frame Header (5 bytes)
+	//  - Header flags
+	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
+	set_header(header, headerFlags, 0, obj->cycle);
+
+	// Copy only 5 bytes of header to flexrayData
+	uint8_t* headerPtr = (uint8_t*)&header;
+	memcpy(&flexrayData[2], headerPtr + 3, 5);
+
+	/// FlexRay Frame Payload (0-254 bytes) -> no payload
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, 7, flexrayData.data(), date_offset_ns);
+}
+
+// FR_STATUS = 48
+void write(packet_output& out, FlexRayVFrStatus* obj, uint64_t date_offset_ns) {
+
+	std::array<uint8_t, 2> flexraySymbolData;
+
+	memset(&flexraySymbolData, 0, sizeof(flexraySymbolData));
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(flexraySymbolData[0], FlexRayPacketType::FlexRaySymbol, obj->channelMask);
+
+	/// Symbol length (1 byte)
+	if (obj->tag == 3) /* BUSDOCTOR */
+	{
+		flexraySymbolData[1] = obj->data[1] & 0xFF;
+	}
+	if (obj->tag == 5) /* VN-Interface */
+	{
+		flexraySymbolData[1] = obj->data[0] & 0xFF;
+	}
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, 2, flexraySymbolData.data(), date_offset_ns);
+}
+
+// FR_STARTCYCLE = 49
+void write(packet_output& out, FlexRayVFrStartCycle* obj, uint64_t date_offset_ns) {
+
+	uint64_t header = 0;
+	uint8_t headerFlags = 0;
+	std::array<uint8_t, 19> flexrayData;
+
+	memset(&flexrayData, 0, sizeof(flexrayData));
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame, obj->channelMask);
+
+	/// Error Flags Information (1 byte) -> set to 0
+
+	/// FlexRay Frame Header (5 bytes)
+	//  - Header flags
+	headerFlags |= 0x04; // Null Frame: False (indicator bit set to 1)
+	//  - Payload length
+	uint64_t len = obj->dataBytes.size() / 2;
+	set_header(header, headerFlags, len, obj->cycle);
+
+	// Copy only 5 bytes of header to flexrayData
+	uint8_t* headerPtr = (uint8_t*)&header;
+	memcpy(&flexrayData[2], headerPtr + 3, 5);
+
+	// FlexRay Frame Payload (0-254 bytes)
+	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
+}
+
+// FR_RCVMESSAGE = 50
+void write(packet_output& out, FlexRayVFrReceiveMsg* obj, uint64_t date_offset_ns) {
+
+	uint64_t header = 0;
+	uint16_t headerCrc = 0;
+	uint8_t headerFlags = 0;
+	std::array<uint8_t, 261> flexrayData;
+
+	memset(&flexrayData, 0, sizeof(flexrayData));
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(flexrayData[0], FlexRayPacketType::FlexRayFrame, obj->channelMask);
+
+	/// Error Flags Information (1 byte) -> case Error flag (error frame or invalid frame) set to 1
+	if (HAS_FLAG(obj->frameFlags, 6))
+	{
+		flexrayData[1] |= 0x10; // FCRCERR bit set to 1
+	}
+
+	/// FlexRay Frame Header (5 bytes)
+	//  - Header flags
+	set_header_flags_rcv_msg(obj->frameFlags, headerFlags);
+	// 	- Header CRC
+	set_header_crc(obj->channelMask, obj->headerCrc1, obj->headerCrc2, headerCrc);
+	//  - Payload length
+	uint64_t len = obj->dataBytes.size() / 2;
+	set_header(header, headerFlags, len, obj->cycle, obj->frameId, headerCrc);
+
+	// Copy only 5 bytes of header to flexrayData
+	uint8_t* headerPtr = (uint8_t*)&header;
+	memcpy(&flexrayData[2], headerPtr + 3, 5);
+
+	// FlexRay Frame Payload (0-254 bytes)
+	std::copy(obj->dataBytes.begin(), obj->dataBytes.end(), flexrayData.begin() + 7);
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
+}
+
+// FR_RCVMESSAGE_EX = 66
+void write(packet_output& out, FlexRayVFrReceiveMsgEx* obj, uint64_t date_offset_ns) {
+
+	uint64_t header = 0;
+	uint16_t headerCrc = 0;
+	uint8_t headerFlags = 0;
+	uint8_t measurementHeader = 0;
+	uint8_t errorFlagsInfo = 0;
+	std::vector<uint8_t> flexrayData;
+
+	flexrayData.clear();
+
+	/// Measurement Header (1 byte)
+	set_measurment_header(measurementHeader, FlexRayPacketType::FlexRayFrame, obj->channelMask);
+
+	flexrayData.push_back(measurementHeader);
+
+	/// Error Flags Information (1 byte) -> case Error flag (error frame or invalid frame) set to 1
+	if (HAS_FLAG(obj->frameFlags, 6))
+	{
+		errorFlagsInfo |= 0x10; // FCRCERR bit set to 1
+	}
+	flexrayData.push_back(errorFlagsInfo);
+
+	/// FlexRay Frame Header (5 bytes)
+	//  - Header flags
+	set_header_flags_rcv_msg(obj->frameFlags, headerFlags);
+	// 	- Header CRC
+	set_header_crc(obj->channelMask, obj->headerCrc1, obj->headerCrc2, headerCrc);
+	//  - Payload length
+	uint64_t len = obj->dataBytes.size() / 2;
+	set_header(header, headerFlags, len, obj->cycle, obj->frameId, headerCrc);
+
+	// Copy only 5 bytes of header to flexrayData
+	uint8_t* headerPtr = (uint8_t*)&header;
+	std::vector<uint8_t> headerVec(headerPtr + 3, headerPtr + 8);
+	flexrayData.insert(flexrayData.end(), headerVec.begin(), headerVec.end());
+
+	// FlexRay Frame Payload (0-254 bytes)
+	flexrayData.insert(flexrayData.end(), obj->dataBytes.begin(), obj->dataBytes.end());
+
+	write_packet(out, LINKTYPE_FLEXRAY, obj, obj->dataBytes.size() + 7, flexrayData.data(), date_offset_ns);
+}
+
+template<class LinErrorBase>
+int write_lin_error(
+	packet_output& out,
+	LinErrorBase* lerr,
+	std::uint8_t errors,
+	uint64_t date_offset_ns)
+{
+	pcapng_exporter::frame_header header = generate_header(lerr, date_offset_ns);
+	if (header.timestamp_resolution == 0) return -3;
+	lin_frame frame = lin_frame();
+	frame.errors = errors;
+	out.sink.write_lin(header, frame);
+	return 0;
+}
+
+template<class LinMessageBase>
+int write_lin_message(
+	packet_output& out,
+	LinMessageBase* msg,
+	uint64_t date_offset_ns)
+{
+	pcapng_exporter::frame_header header = generate_header(msg, date_offset_ns);
+	if (header.timestamp_resolution == 0) return -3;
+	lin_frame frame = lin_frame();
+	frame.pid = msg->id;
+	frame.payload_length = (std::uint8_t)(msg->data.size());
+	memcpy(frame.data, &(msg->data), frame.payload_length);
+	frame.checksum = msg->crc;
+	out.sink.write_lin(header, frame);
+	return 0;
+}
+
+uint32_t snap_lengths::get(uint16_t link_type) const {
+	switch (link_type) {
+	case LINKTYPE_CAN:
+		return can;
+	case LINKTYPE_ETHERNET:
+		return ethernet;
+	case LINKTYPE_FLEXRAY:
+		return flexray;
+	default:
+		return UINT32_MAX;
+	}
+}
+
+snap_lengths parse_snaplen(const std::string& text) {
+	snap_lengths snaplen;
+	size_t start = 0;
+	while (start < text.size()) {
+		size_t end = text.find(',', start);
+		if (end == std::string::npos) end = text.size();
+		std::string item = text.substr(start, end - start);
+		size_t eq = item.find('=');
+		if (eq == std::string::npos) throw std::invalid_argument("Expected link=bytes: " + item);
+		std::string link = item.substr(0, eq);
+		unsigned long bytes = std::stoul(item.substr(eq + 1));
+		if (bytes == 0 || bytes > UINT32_MAX) throw std::invalid_argument("Invalid length: " + item);
+		if (link == "eth" || link == "ethernet") snaplen.ethernet = (uint32_t)bytes;
+		else if (link == "can") snaplen.can = (uint32_t)bytes;
+		else if (link == "flexray") snaplen.flexray = (uint32_t)bytes;
+		else throw std::invalid_argument("Unknown link type: " + link);
+		start = end + 1;
+	}
+	return snaplen;
+}
+
+PacketEncoder::PacketEncoder(PacketSink& sink, const snap_lengths& snaplen)
+	: out{ sink, snaplen }
+{
+}
+
+void PacketEncoder::write_object(ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	std::uint8_t errors = 0;
+	switch (ohb->objectType) {
+
+	case ObjectType::CAN_MESSAGE:
+		write(out, reinterpret_cast<CanMessage*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::CAN_ERROR:
+		write(out, reinterpret_cast<CanErrorFrame*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::CAN_FD_MESSAGE:
+		write(out, reinterpret_cast<CanFdMessage*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::CAN_FD_MESSAGE_64:
+		write(out, reinterpret_cast<CanFdMessage64*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::CAN_FD_ERROR_64:
+		write(out, reinterpret_cast<CanFdErrorFrame64*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::ETHERNET_FRAME:
+		write(out, reinterpret_cast<EthernetFrame*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::CAN_ERROR_EXT:
+		write(out, reinterpret_cast<CanErrorFrameExt*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::CAN_MESSAGE2:
+		write(out, reinterpret_cast<CanMessage2*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::ETHERNET_FRAME_EX:
+		write(out, reinterpret_cast<EthernetFrameEx*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::ETHERNET_FRAME_FORWARDED:
+		write(out, reinterpret_cast<EthernetFrameForwarded*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FLEXRAY_DATA:
+		write(out, reinterpret_cast<FlexRayData*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FLEXRAY_SYNC:
+		write(out, reinterpret_cast<FlexRaySync*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FLEXRAY_CYCLE:
+		write(out, reinterpret_cast<FlexRayV6StartCycleEvent*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FLEXRAY_MESSAGE:
+		write(out, reinterpret_cast<FlexRayV6Message*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FLEXRAY_STATUS:
+		// We do not have reliable BLF file or clear documentation for this type
+		break;
+
+	case ObjectType::FR_ERROR:
+		write(out, reinterpret_cast<FlexRayVFrError*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FR_STATUS:
+		write(out, reinterpret_cast<FlexRayVFrStatus*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FR_STARTCYCLE:
+		write(out, reinterpret_cast<FlexRayVFrStartCycle*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FR_RCVMESSAGE:
+		write(out, reinterpret_cast<FlexRayVFrReceiveMsg*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::FR_RCVMESSAGE_EX:
+		write(out, reinterpret_cast<FlexRayVFrReceiveMsgEx*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::LIN_MESSAGE:
+		write_lin_message(out, reinterpret_cast<LinMessage*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::LIN_MESSAGE2:
+		write_lin_message(out, reinterpret_cast<LinMessage2*>(ohb), date_offset_ns);
+		break;
+
+	case ObjectType::LIN_CRC_ERROR:
+		errors = LIN_ERROR_CHECKSUM;
+		write_lin_error(out, reinterpret_cast<LinCrcError*>(ohb), errors, date_offset_ns);
+		break;
+
+	case ObjectType::LIN_CRC_ERROR2:
+		errors = LIN_ERROR_CHECKSUM;
+		write_lin_error(out, reinterpret_cast<LinCrcError2*>(ohb), errors, date_offset_ns);
+		break;
+
+	case ObjectType::LIN_RCV_ERROR:
+		errors = LIN_ERROR_FRAMING;
+		write_lin_error(out, reinterpret_cast<LinReceiveError*>(ohb), errors, date_offset_ns);
+		break;
+
+	case ObjectType::LIN_RCV_ERROR2:
+		errors = LIN_ERROR_FRAMING;
+		write_lin_error(out, reinterpret_cast<LinReceiveError2*>(ohb), errors, date_offset_ns);
+		break;
+
+	case ObjectType::LIN_SLV_TIMEOUT:
+		errors = LIN_ERROR_NOSLAVE;
+		write_lin_error(out, reinterpret_cast<LinSlaveTimeout*>(ohb), errors, date_offset_ns);
+		break;
+
+	case ObjectType::LIN_SND_ERROR:
+		errors = LIN_ERROR_FRAMING;
+		write_lin_error(out, reinterpret_cast<LinSendError*>(ohb), errors, date_offset_ns);
+		break;
+
+	case ObjectType::LIN_SND_ERROR2:
+		errors = LIN_ERROR_FRAMING;
+		write_lin_error(out, reinterpret_cast<LinSendError2*>(ohb), errors, date_offset_ns);
+		break;
+
+	case ObjectType::LIN_SYN_ERROR:
+		errors = LIN_ERROR_FRAMING;
+		write_lin_error(out, reinterpret_cast<LinSyncError*>(ohb), errors, date_offset_ns);
+		break;
+
+	case ObjectType::LIN_SYN_ERROR2:
+		errors = LIN_ERROR_FRAMING;
+		write_lin_error(out, reinterpret_cast<LinSyncError2*>(ohb), errors, date_offset_ns);
+		break;
+
+	default:
+#ifdef DEBUG
+		std::cerr << (std::uint32_t)(ohb->objectType) << " is not implemented." << std::endl;
+#endif
+		break;
+
+	}
+}
+
+void PacketEncoder::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	out.sink.add_mapping(mapping);
+}
+
+void PacketEncoder::flush() {
+	out.sink.flush();
+}
+
+}
@@ -0,0 +1,72 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_ENCODER_H
+#define _APP_ENCODER_H
+
+#include <cstdint>
+#include <string>
+
+#include <Vector/BLF.h>
+#include <pcapng_exporter/pcapng_exporter.hpp>
+
+#include "sink.hpp"
+
+namespace blf_converter {
+
+// Destination of decoded BLF objects.
+// Objects are only valid for the duration of the call.
+class ObjectSink {
+public:
+	virtual ~ObjectSink() = default;
+
+	virtual void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) = 0;
+
+	// Channel mapping found in the BLF metadata (AppText objects)
+	virtual void add_mapping(const pcapng_exporter::channel_mapping& mapping) {}
+
+	// Called once all objects have been written
+	virtual void flush() {}
+};
+
+// Drops all objects, for passes that only collect statistics or summaries
+class NullSink : public ObjectSink {
+public:
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override {}
+};
+
+// Maximum number of captured bytes per link type, longer frames are truncated
+// but keep their original length. LIN frames are never truncated.
+struct snap_lengths {
+	uint32_t can = UINT32_MAX;
+	uint32_t ethernet = UINT32_MAX;
+	uint32_t flexray = UINT32_MAX;
+
+	uint32_t get(uint16_t link_type) const;
+};
+
+// Parses snap lengths such as "eth=128,flexray=64,can=16", throws std::invalid_argument
+snap_lengths parse_snaplen(const std::string& text);
+
+struct packet_output {
+	PacketSink& sink;
+	snap_lengths snaplen;
+};
+
+// Encodes BLF objects into link layer frames (SocketCAN, Ethernet, FlexRay, LIN)
+class PacketEncoder : public ObjectSink {
+public:
+	explicit PacketEncoder(PacketSink& sink, const snap_lengths& snaplen = snap_lengths());
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+private:
+	packet_output out;
+};
+
+}
+
+#endif
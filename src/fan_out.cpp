@@ -0,0 +1,122 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "fan_out.hpp"
+
+#include "frame_view.hpp"
+
+namespace blf_converter {
+
+static std::unique_ptr<FilterProgram> compile(const std::string& filter) {
+	if (filter.empty()) {
+		return nullptr;
+	}
+	return std::make_unique<FilterProgram>(filter);
+}
+
+void FanOutSink::add_packet_output(PacketSink& sink, const std::string& filter, const snap_lengths& snaplen) {
+	encoder_group* group = nullptr;
+	for (auto& g : groups) {
+		if (g->snaplen.can == snaplen.can && g->snaplen.ethernet == snaplen.ethernet && g->snaplen.flexray == snaplen.flexray) {
+			group = g.get();
+		}
+	}
+	if (!group) {
+		groups.push_back(std::make_unique<encoder_group>());
+		group = groups.back().get();
+		group->snaplen = snaplen;
+		group->encoder = std::make_unique<PacketEncoder>(group->select, snaplen);
+	}
+	SelectSink::selected_output output;
+	output.filter = compile(filter);
+	output.sink = &sink;
+	group->select.outputs.push_back(std::move(output));
+}
+
+void FanOutSink::add_object_output(ObjectSink& sink, const std::string& filter) {
+	object_output output;
+	output.filter = compile(filter);
+	output.sink = &sink;
+	object_outputs.push_back(std::move(output));
+}
+
+void FanOutSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	bool frame = make_frame_view(ohb, date_offset_ns, &view);
+	auto matches = [&](const target& t) {
+		return !frame || !t.filter || t.filter->matches(view);
+	};
+
+	for (auto& output : object_outputs) {
+		if (matches(output)) {
+			output.sink->write_object(ohb, date_offset_ns);
+		}
+	}
+	for (auto& group : groups) {
+		bool any = false;
+		for (auto& output : group->select.outputs) {
+			output.selected = matches(output);
+			any |= output.selected;
+		}
+		// Encoded once for all selected outputs of the group
+		if (any) {
+			group->encoder->write_object(ohb, date_offset_ns);
+		}
+	}
+}
+
+void FanOutSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	for (auto& output : object_outputs) {
+		output.sink->add_mapping(mapping);
+	}
+	for (auto& group : groups) {
+		group->encoder->add_mapping(mapping);
+	}
+}
+
+void FanOutSink::flush() {
+	for (auto& output : object_outputs) {
+		output.sink->flush();
+	}
+	for (auto& group : groups) {
+		group->encoder->flush();
+	}
+}
+
+void FanOutSink::SelectSink::write_packet(
+	uint16_t link_type,
+	uint32_t channel,
+	uint32_t hw_channel,
+	const light_packet_header& header,
+	const uint8_t* data
+) {
+	for (auto& output : outputs) {
+		if (output.selected) {
+			output.sink->write_packet(link_type, channel, hw_channel, header, data);
+		}
+	}
+}
+
+void FanOutSink::SelectSink::write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) {
+	for (auto& output : outputs) {
+		if (output.selected) {
+			output.sink->write_lin(header, frame);
+		}
+	}
+}
+
+void FanOutSink::SelectSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	for (auto& output : outputs) {
+		output.sink->add_mapping(mapping);
+	}
+}
+
+void FanOutSink::SelectSink::flush() {
+	for (auto& output : outputs) {
+		output.sink->flush();
+	}
+}
+
+}
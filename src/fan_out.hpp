@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_FAN_OUT_H
+#define _APP_FAN_OUT_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "encoder.hpp"
+#include "filter.hpp"
+#include "sink.hpp"
+
+namespace blf_converter {
+
+// Dispatches one decoded object stream to several outputs, each with an
+// optional filter expression. Packet outputs with the same snap lengths share
+// one encoder: a frame is encoded once and the same bytes are handed to every
+// output whose filter it matches. Objects that are no bus frames reach all outputs.
+class FanOutSink : public ObjectSink {
+public:
+	// An empty filter passes everything. Throws std::invalid_argument for invalid filters.
+	void add_packet_output(PacketSink& sink, const std::string& filter, const snap_lengths& snaplen);
+	void add_object_output(ObjectSink& sink, const std::string& filter);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+private:
+	struct target {
+		std::unique_ptr<FilterProgram> filter;
+		bool selected = false;
+	};
+
+	struct object_output : target {
+		ObjectSink* sink;
+	};
+
+	// Forwards the packets of the shared encoder to the selected outputs
+	class SelectSink : public PacketSink {
+	public:
+		struct selected_output : target {
+			PacketSink* sink;
+		};
+		std::vector<selected_output> outputs;
+
+		void write_packet(
+			uint16_t link_type,
+			uint32_t channel,
+			uint32_t hw_channel,
+			const light_packet_header& header,
+			const uint8_t* data) override;
+
+		void write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) override;
+
+		void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+
+		void flush() override;
+	};
+
+	struct encoder_group {
+		snap_lengths snaplen;
+		SelectSink select;
+		std::unique_ptr<PacketEncoder> encoder;
+	};
+
+	std::vector<object_output> object_outputs;
+	std::vector<std::unique_ptr<encoder_group>> groups;
+};
+
+}
+
+#endif
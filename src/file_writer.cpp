@@ -0,0 +1,252 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "file_writer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+// Alignment of the buffers and of the size of full buffers, the block size direct I/O needs
+#define WRITE_ALIGNMENT 4096
+
+// Largest append(), the buffers hold this much more than the capacity
+#define MAX_APPEND (1 << 20)
+
+namespace blf_converter {
+
+#ifdef _WIN32
+static uint8_t* allocate_aligned(size_t size) {
+	void* data = _aligned_malloc(size, WRITE_ALIGNMENT);
+	if (!data) {
+		throw std::bad_alloc();
+	}
+	return (uint8_t*)data;
+}
+
+void AsyncFileWriter::aligned_deleter::operator()(uint8_t* data) const {
+	_aligned_free(data);
+}
+
+static int open_output(const std::string& path) {
+	return _open(path.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+}
+
+// Only the I/O thread writes, so plain sequential writes keep the order
+static bool write_at(int fd, const uint8_t* data, size_t length, uint64_t) {
+	while (length > 0) {
+		unsigned int part = length > (1u << 30) ? (1u << 30) : (unsigned int)length;
+		int n = _write(fd, data, part);
+		if (n <= 0) {
+			return false;
+		}
+		data += n;
+		length -= n;
+	}
+	return true;
+}
+
+static void close_output(int fd) {
+	_close(fd);
+}
+#else
+static uint8_t* allocate_aligned(size_t size) {
+	void* data = nullptr;
+	if (posix_memalign(&data, WRITE_ALIGNMENT, size) != 0) {
+		throw std::bad_alloc();
+	}
+	return (uint8_t*)data;
+}
+
+void AsyncFileWriter::aligned_deleter::operator()(uint8_t* data) const {
+	free(data);
+}
+
+static int open_output(const std::string& path) {
+	return open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+}
+
+static bool write_at(int fd, const uint8_t* data, size_t length, uint64_t offset) {
+	while (length > 0) {
+		ssize_t n = pwrite(fd, data, length, (off_t)offset);
+		if (n < 0 && errno == EINTR) {
+			continue;
+		}
+		if (n <= 0) {
+			return false;
+		}
+		data += n;
+		length -= n;
+		offset += n;
+	}
+	return true;
+}
+
+static void close_output(int fd) {
+	::close(fd);
+}
+#endif
+
+AsyncFileWriter::AsyncFileWriter(const std::string& path, size_t buffer_size, size_t buffer_count)
+	: capacity(std::max((size_t)WRITE_ALIGNMENT, (buffer_size + WRITE_ALIGNMENT - 1) & ~(size_t)(WRITE_ALIGNMENT - 1)))
+{
+	fd = open_output(path);
+	if (fd < 0) {
+		throw std::runtime_error("Unable to open: " + path);
+	}
+	current.data.reset(allocate_aligned(capacity + MAX_APPEND));
+	for (size_t i = 1; i < buffer_count; i++) {
+		free_buffers.emplace_back();
+		free_buffers.back().data.reset(allocate_aligned(capacity + MAX_APPEND));
+	}
+	io_thread = std::thread([this] { run(); });
+}
+
+AsyncFileWriter::~AsyncFileWriter() {
+	finish();
+}
+
+void AsyncFileWriter::preallocate(uint64_t size) {
+#ifdef __linux__
+	// Best effort, not all file systems support it
+	if (size > 0 && fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, (off_t)size) == 0) {
+		preallocated = true;
+	}
+#else
+	(void)size;
+#endif
+}
+
+void AsyncFileWriter::write(const uint8_t* data, size_t length) {
+	while (length > 0) {
+		while (current.size >= capacity) {
+			submit();
+		}
+		// Up to the capacity, so that nothing is carried over to the next buffer
+		size_t part = std::min(length, capacity - current.size);
+		memcpy(current.data.get() + current.size, data, part);
+		current.size += part;
+		data += part;
+		length -= part;
+	}
+}
+
+uint8_t* AsyncFileWriter::append(size_t length) {
+	if (length > MAX_APPEND) {
+		throw std::runtime_error("Block of " + std::to_string(length) + " bytes is too large for the output buffer");
+	}
+	// The previous append is filled by now
+	while (current.size >= capacity) {
+		submit();
+	}
+	uint8_t* data = current.data.get() + current.size;
+	current.size += length;
+	return data;
+}
+
+size_t AsyncFileWriter::max_append() {
+	return MAX_APPEND;
+}
+
+void AsyncFileWriter::submit() {
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return !free_buffers.empty() || !error.empty(); });
+	if (!error.empty()) {
+		// Data is dropped from here on, close() reports the error again
+		current.size = 0;
+		if (!error_thrown) {
+			error_thrown = true;
+			throw std::runtime_error(error);
+		}
+		return;
+	}
+	buffer next = std::move(free_buffers.back());
+	free_buffers.pop_back();
+	// What was appended past the capacity starts the next buffer, so that all
+	// but the last write keep the aligned size
+	next.size = current.size - capacity;
+	memcpy(next.data.get(), current.data.get() + capacity, next.size);
+	current.size = capacity;
+	full_buffers.push_back(std::move(current));
+	current = std::move(next);
+	changed.notify_all();
+}
+
+void AsyncFileWriter::run() {
+	bool thread_named = false;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		changed.wait(lock, [this] { return !full_buffers.empty() || closing; });
+		if (full_buffers.empty()) {
+			return;
+		}
+		buffer full = std::move(full_buffers.front());
+		full_buffers.pop_front();
+
+		bool failed = !error.empty();
+		lock.unlock();
+		uint64_t start = tracer ? Tracer::now() : 0;
+		bool ok = failed || write_at(fd, full.data.get(), full.size, written);
+		if (tracer) {
+			if (!thread_named) {
+				tracer->name_thread("io");
+				thread_named = true;
+			}
+			tracer->span("write", start, Tracer::now(), full.size);
+		}
+		written += full.size;
+		lock.lock();
+
+		if (!ok) {
+			error = std::string("Write failed: ") + strerror(errno);
+		}
+		free_buffers.push_back(std::move(full));
+		changed.notify_all();
+	}
+}
+
+void AsyncFileWriter::finish() {
+	if (fd < 0) {
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		if (current.size > 0) {
+			full_buffers.push_back(std::move(current));
+		}
+		closing = true;
+		changed.notify_all();
+	}
+	io_thread.join();
+#ifdef __linux__
+	// Frees the blocks reserved past the end of the data
+	if (preallocated) {
+		(void)ftruncate(fd, (off_t)written);
+	}
+#endif
+	close_output(fd);
+	fd = -1;
+}
+
+void AsyncFileWriter::close() {
+	finish();
+	if (!error.empty()) {
+		throw std::runtime_error(error);
+	}
+}
+
+}
@@ -0,0 +1,91 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_FILE_WRITER_H
+#define _APP_FILE_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "trace.hpp"
+
+namespace blf_converter {
+
+// Output file written by a dedicated I/O thread. Data is collected in large
+// buffers, full buffers are queued for the I/O thread while the caller keeps
+// filling the next one. At most buffer_count buffers exist, write() blocks
+// when the disk falls behind. Buffers are aligned to 4 KiB and all writes but the
+// last one have the buffer size, a multiple of 4 KiB, as direct I/O needs.
+class AsyncFileWriter {
+public:
+	// Throws std::runtime_error if the file cannot be created
+	explicit AsyncFileWriter(const std::string& path, size_t buffer_size = 8 << 20, size_t buffer_count = 4);
+	~AsyncFileWriter();
+
+	AsyncFileWriter(const AsyncFileWriter&) = delete;
+	AsyncFileWriter& operator=(const AsyncFileWriter&) = delete;
+
+	// Reserves disk space for the expected output size, where supported. The file size is not changed,
+	// space that is not written is freed again when the file is closed.
+	void preallocate(uint64_t size);
+
+	void write(const uint8_t* data, size_t length);
+
+	// Space for length bytes at the end of the output, so that encoders write in place
+	// without a copy. The caller fills it before the next call to append(), write() or
+	// close(). length is at most max_append(), throws std::runtime_error otherwise.
+	uint8_t* append(size_t length);
+	static size_t max_append();
+
+	// Writes the remaining data and closes the file, throws std::runtime_error on I/O errors
+	void close();
+
+	size_t buffer_size() const { return capacity; }
+
+	// Records a span per written buffer, to be set before the first write()
+	void set_tracer(Tracer* t) { tracer = t; }
+
+private:
+	int fd = -1;
+	Tracer* tracer = nullptr;
+	size_t capacity;
+	bool preallocated = false;
+	// Bytes written by the I/O thread
+	uint64_t written = 0;
+
+	struct aligned_deleter {
+		void operator()(uint8_t* data) const;
+	};
+	// capacity bytes are written, the rest holds what was appended past them
+	struct buffer {
+		std::unique_ptr<uint8_t, aligned_deleter> data;
+		size_t size = 0;
+	};
+
+	buffer current;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<buffer> full_buffers;
+	std::vector<buffer> free_buffers;
+	bool closing = false;
+	std::string error;
+	bool error_thrown = false;
+
+	std::thread io_thread;
+
+	void submit();
+	void run();
+	void finish();
+};
+
+}
+
+#endif
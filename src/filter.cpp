@@ -0,0 +1,493 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "filter.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+
+#include <pcapng_exporter/linktype.h>
+
+#define FILTER_MAX_STACK 64
+
+namespace blf_converter {
+
+enum class field : uint8_t {
+	CHANNEL, HW_CHANNEL, ID, LEN, TX, IS_ERROR,
+	CAN, CAN_ID, CAN_DLC, CAN_EXT, CAN_RTR, CAN_FD, CAN_BRS, CAN_ESI,
+	ETH, ETH_TYPE, ETH_VLAN, ETH_PCP,
+	FR, FR_SLOT, FR_CYCLE,
+	LIN, LIN_ID, LIN_ERRORS
+};
+
+static const struct {
+	const char* name;
+	field id;
+} fields[] = {
+	{ "channel", field::CHANNEL },
+	{ "hw_channel", field::HW_CHANNEL },
+	{ "id", field::ID },
+	{ "len", field::LEN },
+	{ "tx", field::TX },
+	{ "error", field::IS_ERROR },
+	{ "can", field::CAN },
+	{ "can.id", field::CAN_ID },
+	{ "can.dlc", field::CAN_DLC },
+	{ "can.ext", field::CAN_EXT },
+	{ "can.rtr", field::CAN_RTR },
+	{ "can.fd", field::CAN_FD },
+	{ "can.brs", field::CAN_BRS },
+	{ "can.esi", field::CAN_ESI },
+	{ "eth", field::ETH },
+	{ "eth.type", field::ETH_TYPE },
+	{ "eth.vlan", field::ETH_VLAN },
+	{ "vlan", field::ETH_VLAN },
+	{ "eth.pcp", field::ETH_PCP },
+	{ "fr", field::FR },
+	{ "fr.slot", field::FR_SLOT },
+	{ "fr.cycle", field::FR_CYCLE },
+	{ "lin", field::LIN },
+	{ "lin.id", field::LIN_ID },
+	{ "lin.errors", field::LIN_ERRORS },
+};
+
+// A missing value makes comparisons false
+struct filter_value {
+	int64_t value;
+	bool present;
+};
+
+static filter_value load_field(field f, const frame_view& view) {
+	bool can = view.link_type == LINKTYPE_CAN;
+	bool eth = view.link_type == LINKTYPE_ETHERNET;
+	bool fr = view.link_type == LINKTYPE_FLEXRAY;
+	bool lin = view.link_type == LINKTYPE_LIN;
+	switch (f) {
+	case field::CHANNEL: return { view.channel, true };
+	case field::HW_CHANNEL: return { view.hw_channel, true };
+	case field::ID: return { view.id, true };
+	case field::LEN: return { view.data_length, true };
+	case field::TX: return { (view.flags & FRAME_FLAG_TX) != 0, true };
+	case field::IS_ERROR: return { (view.flags & FRAME_FLAG_ERROR) != 0, true };
+	case field::CAN: return { can, true };
+	case field::CAN_ID: return { view.id, can };
+	case field::CAN_DLC: return { view.dlc, can };
+	case field::CAN_EXT: return { (view.flags & FRAME_FLAG_EXT) != 0, can };
+	case field::CAN_RTR: return { (view.flags & FRAME_FLAG_RTR) != 0, can };
+	case field::CAN_FD: return { (view.flags & FRAME_FLAG_FDF) != 0, can };
+	case field::CAN_BRS: return { (view.flags & FRAME_FLAG_BRS) != 0, can };
+	case field::CAN_ESI: return { (view.flags & FRAME_FLAG_ESI) != 0, can };
+	case field::ETH: return { eth, true };
+	case field::ETH_TYPE: return { view.id, eth };
+	case field::ETH_VLAN: return { view.tci & 0x0FFF, eth && (view.flags & FRAME_FLAG_VLAN) };
+	case field::ETH_PCP: return { view.tci >> 13, eth && (view.flags & FRAME_FLAG_VLAN) };
+	case field::FR: return { fr, true };
+	case field::FR_SLOT: return { view.id, fr };
+	case field::FR_CYCLE: return { view.cycle, fr };
+	case field::LIN: return { lin, true };
+	case field::LIN_ID: return { view.id, lin };
+	case field::LIN_ERRORS: return { view.lin_errors, lin };
+	}
+	return { 0, false };
+}
+
+// Recursive descent parser emitting the postfix program
+class FilterParser {
+public:
+	FilterParser(const std::string& text, FilterProgram& program)
+		: text(text), program(program)
+	{
+	}
+
+	void parse() {
+		next();
+		parse_or();
+		if (!token.empty()) {
+			fail("Unexpected " + token);
+		}
+	}
+
+private:
+	using op = FilterProgram::op;
+
+	const std::string& text;
+	FilterProgram& program;
+	size_t pos = 0;
+	size_t token_pos = 0;
+	std::string token;
+	size_t depth = 0;
+
+	[[noreturn]] void fail(const std::string& message) {
+		throw std::invalid_argument(message + " at position " + std::to_string(token_pos + 1));
+	}
+
+	void next() {
+		while (pos < text.size() && isspace((unsigned char)text[pos])) {
+			pos++;
+		}
+		token_pos = pos;
+		if (pos >= text.size()) {
+			token.clear();
+			return;
+		}
+		char c = text[pos];
+		size_t end = pos + 1;
+		if (isalnum((unsigned char)c) || c == '_') {
+			while (end < text.size() && (isalnum((unsigned char)text[end]) || text[end] == '_' || text[end] == '.')) {
+				end++;
+			}
+		}
+		else {
+			static const char* two_char[] = { "||", "&&", "==", "!=", "<=", ">=" };
+			for (const char* t : two_char) {
+				if (text.compare(pos, 2, t) == 0) {
+					end = pos + 2;
+				}
+			}
+		}
+		token = text.substr(pos, end - pos);
+		pos = end;
+	}
+
+	bool accept(const char* t) {
+		if (token == t) {
+			next();
+			return true;
+		}
+		return false;
+	}
+
+	void expect(const char* t) {
+		if (!accept(t)) {
+			fail(std::string("Expected ") + t);
+		}
+	}
+
+	void emit(op code, int64_t operand = 0) {
+		switch (code) {
+		case op::PUSH:
+		case op::FIELD:
+		case op::PAYLOAD:
+			depth++;
+			break;
+		case op::IN_SET:
+		case op::NOT:
+		case op::NEG:
+		case op::BIT_NOT:
+			break;
+		default:
+			depth--;
+			break;
+		}
+		if (depth > FILTER_MAX_STACK) {
+			fail("Expression too complex");
+		}
+		program.stack_depth = std::max(program.stack_depth, depth);
+		program.program.push_back({ code, operand });
+	}
+
+	int64_t parse_number() {
+		if (token.empty() || !isdigit((unsigned char)token[0])) {
+			fail(token.empty() ? "Expected a number" : "Expected a number instead of " + token);
+		}
+		size_t used = 0;
+		int64_t value;
+		try {
+			value = (int64_t)std::stoull(token, &used, 0);
+		}
+		catch (std::exception&) {
+			used = 0;
+		}
+		if (used != token.size()) {
+			fail("Invalid number " + token);
+		}
+		next();
+		return value;
+	}
+
+	void parse_or() {
+		parse_and();
+		while (accept("||")) {
+			parse_and();
+			emit(op::LOGICAL_OR);
+		}
+	}
+
+	void parse_and() {
+		parse_comparison();
+		while (accept("&&")) {
+			parse_comparison();
+			emit(op::LOGICAL_AND);
+		}
+	}
+
+	void parse_comparison() {
+		parse_bit_or();
+		static const struct {
+			const char* token;
+			op code;
+		} comparisons[] = {
+			{ "==", op::EQ }, { "!=", op::NE }, { "<=", op::LE }, { ">=", op::GE }, { "<", op::LT }, { ">", op::GT },
+		};
+		while (true) {
+			if (accept("in")) {
+				parse_set();
+				continue;
+			}
+			bool found = false;
+			for (const auto& comparison : comparisons) {
+				if (accept(comparison.token)) {
+					parse_bit_or();
+					emit(comparison.code);
+					found = true;
+					break;
+				}
+			}
+			if (!found) {
+				return;
+			}
+		}
+	}
+
+	// [a, b-c, ...] of constants
+	void parse_set() {
+		expect("[");
+		std::vector<std::pair<int64_t, int64_t>> ranges;
+		do {
+			int64_t low = parse_number();
+			int64_t high = low;
+			if (accept("-")) {
+				high = parse_number();
+			}
+			if (high < low) {
+				fail("Empty range");
+			}
+			ranges.push_back({ low, high });
+		} while (accept(","));
+		expect("]");
+
+		// Merged for a binary search
+		std::sort(ranges.begin(), ranges.end());
+		std::vector<std::pair<int64_t, int64_t>> merged;
+		for (const auto& range : ranges) {
+			if (!merged.empty() && range.first <= merged.back().second + 1) {
+				merged.back().second = std::max(merged.back().second, range.second);
+			}
+			else {
+				merged.push_back(range);
+			}
+		}
+		program.sets.push_back(std::move(merged));
+		emit(op::IN_SET, (int64_t)program.sets.size() - 1);
+	}
+
+	void parse_bit_or() {
+		parse_bit_xor();
+		while (accept("|")) {
+			parse_bit_xor();
+			emit(op::BIT_OR);
+		}
+	}
+
+	void parse_bit_xor() {
+		parse_bit_and();
+		while (accept("^")) {
+			parse_bit_and();
+			emit(op::BIT_XOR);
+		}
+	}
+
+	void parse_bit_and() {
+		parse_additive();
+		while (accept("&")) {
+			parse_additive();
+			emit(op::BIT_AND);
+		}
+	}
+
+	void parse_additive() {
+		parse_multiplicative();
+		while (true) {
+			if (accept("+")) {
+				parse_multiplicative();
+				emit(op::ADD);
+			}
+			else if (accept("-")) {
+				parse_multiplicative();
+				emit(op::SUB);
+			}
+			else {
+				return;
+			}
+		}
+	}
+
+	void parse_multiplicative() {
+		parse_unary();
+		while (true) {
+			if (accept("*")) {
+				parse_unary();
+				emit(op::MUL);
+			}
+			else if (accept("/")) {
+				parse_unary();
+				emit(op::DIV);
+			}
+			else if (accept("%")) {
+				parse_unary();
+				emit(op::MOD);
+			}
+			else {
+				return;
+			}
+		}
+	}
+
+	void parse_unary() {
+		if (accept("!")) {
+			parse_unary();
+			emit(op::NOT);
+		}
+		else if (accept("-")) {
+			parse_unary();
+			emit(op::NEG);
+		}
+		else if (accept("~")) {
+			parse_unary();
+			emit(op::BIT_NOT);
+		}
+		else {
+			parse_primary();
+		}
+	}
+
+	void parse_primary() {
+		if (accept("(")) {
+			parse_or();
+			expect(")");
+			return;
+		}
+		if (token.empty()) {
+			fail("Unexpected end of expression");
+		}
+		if (isdigit((unsigned char)token[0])) {
+			emit(op::PUSH, parse_number());
+			return;
+		}
+		if (accept("payload")) {
+			expect("[");
+			int64_t index = parse_number();
+			expect("]");
+			emit(op::PAYLOAD, index);
+			return;
+		}
+		for (const auto& f : fields) {
+			if (token == f.name) {
+				next();
+				emit(op::FIELD, (int64_t)f.id);
+				return;
+			}
+		}
+		fail("Unknown field " + token);
+	}
+};
+
+FilterProgram::FilterProgram(const std::string& expression) {
+	FilterParser(expression, *this).parse();
+}
+
+static bool truthy(const filter_value& v) {
+	return v.present && v.value != 0;
+}
+
+bool FilterProgram::matches(const frame_view& view) const {
+	filter_value stack[FILTER_MAX_STACK];
+	size_t top = 0;
+	for (const auto& ins : program) {
+		switch (ins.code) {
+		case op::PUSH:
+			stack[top++] = { ins.operand, true };
+			continue;
+		case op::FIELD:
+			stack[top++] = load_field((field)ins.operand, view);
+			continue;
+		case op::PAYLOAD:
+			if ((uint64_t)ins.operand < view.data_length) {
+				stack[top++] = { view.data[ins.operand], true };
+			}
+			else {
+				stack[top++] = { 0, false };
+			}
+			continue;
+		case op::IN_SET: {
+			filter_value& v = stack[top - 1];
+			const auto& set = sets[(size_t)ins.operand];
+			auto it = std::upper_bound(set.begin(), set.end(), std::make_pair(v.value, INT64_MAX));
+			v = { v.present && it != set.begin() && v.value <= std::prev(it)->second, true };
+			continue;
+		}
+		case op::NOT:
+			stack[top - 1] = { !truthy(stack[top - 1]), true };
+			continue;
+		case op::NEG:
+			stack[top - 1].value = -stack[top - 1].value;
+			continue;
+		case op::BIT_NOT:
+			stack[top - 1].value = ~stack[top - 1].value;
+			continue;
+		default:
+			break;
+		}
+
+		filter_value b = stack[--top];
+		filter_value& a = stack[top - 1];
+		bool present = a.present && b.present;
+		switch (ins.code) {
+		case op::LOGICAL_AND: a = { truthy(a) && truthy(b), true }; break;
+		case op::LOGICAL_OR: a = { truthy(a) || truthy(b), true }; break;
+		case op::EQ: a = { present && a.value == b.value, true }; break;
+		case op::NE: a = { present && a.value != b.value, true }; break;
+		case op::LT: a = { present && a.value < b.value, true }; break;
+		case op::LE: a = { present && a.value <= b.value, true }; break;
+		case op::GT: a = { present && a.value > b.value, true }; break;
+		case op::GE: a = { present && a.value >= b.value, true }; break;
+		case op::ADD: a = { a.value + b.value, present }; break;
+		case op::SUB: a = { a.value - b.value, present }; break;
+		case op::MUL: a = { a.value * b.value, present }; break;
+		case op::DIV: a = { b.value ? a.value / b.value : 0, present && b.value }; break;
+		case op::MOD: a = { b.value ? a.value % b.value : 0, present && b.value }; break;
+		case op::BIT_AND: a = { a.value & b.value, present }; break;
+		case op::BIT_OR: a = { a.value | b.value, present }; break;
+		case op::BIT_XOR: a = { a.value ^ b.value, present }; break;
+		default: break;
+		}
+	}
+	return top == 1 && truthy(stack[0]);
+}
+
+FilterSink::FilterSink(ObjectSink& next, const std::string& expression)
+	: next(next), filter(expression)
+{
+}
+
+void FilterSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (make_frame_view(ohb, date_offset_ns, &view) && !filter.matches(view)) {
+		drop_count++;
+		return;
+	}
+	next.write_object(ohb, date_offset_ns);
+}
+
+void FilterSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	next.add_mapping(mapping);
+}
+
+void FilterSink::flush() {
+	next.flush();
+}
+
+}
@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_FILTER_H
+#define _APP_FILTER_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "encoder.hpp"
+#include "frame_view.hpp"
+
+namespace blf_converter {
+
+// Filter expressions over the fields of bus frames, for example
+//
+//   can.id in [0x100-0x1FF] && payload[0] & 0x80
+//   eth.type == 0x88F7 && vlan == 20
+//   fr.slot == 42 && fr.cycle % 4 == 0
+//
+// Fields: channel, hw_channel, id, len, tx, error, payload[N],
+// can, can.id, can.dlc, can.ext, can.rtr, can.fd, can.brs, can.esi,
+// eth, eth.type, eth.vlan (also vlan), eth.pcp, fr, fr.slot, fr.cycle,
+// lin, lin.id, lin.errors. The bus names alone are 1 for frames of that bus.
+//
+// Operators as in C: || && ! == != < <= > >= | ^ & + - * / % ~ and parentheses,
+// except that the bitwise operators bind tighter than comparisons.
+// "x in [a, b-c]" tests for a value or an inclusive range.
+//
+// Fields of another bus, bytes beyond the payload and divisions by zero have no
+// value, comparisons with them are false.
+class FilterProgram {
+public:
+	// Throws std::invalid_argument with the position of syntax errors
+	explicit FilterProgram(const std::string& expression);
+
+	bool matches(const frame_view& view) const;
+
+	enum class op : uint8_t {
+		PUSH, FIELD, PAYLOAD, IN_SET,
+		NOT, NEG, BIT_NOT,
+		ADD, SUB, MUL, DIV, MOD, BIT_AND, BIT_OR, BIT_XOR,
+		EQ, NE, LT, LE, GT, GE, LOGICAL_AND, LOGICAL_OR
+	};
+
+	// Postfix program, evaluated with a stack
+	struct instruction {
+		op code;
+		int64_t operand;
+	};
+
+private:
+	std::vector<instruction> program;
+	// Sorted, non overlapping ranges of the "in" sets
+	std::vector<std::vector<std::pair<int64_t, int64_t>>> sets;
+	size_t stack_depth = 0;
+
+	friend class FilterParser;
+};
+
+// Passes only bus frames matching the filter, other objects always pass
+class FilterSink : public ObjectSink {
+public:
+	FilterSink(ObjectSink& next, const std::string& expression);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+	uint64_t dropped() const { return drop_count; }
+
+private:
+	ObjectSink& next;
+	FilterProgram filter;
+	uint64_t drop_count = 0;
+};
+
+}
+
+#endif
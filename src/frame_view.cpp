@@ -0,0 +1,325 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "frame_view.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <pcapng_exporter/lin.h>
+#include <pcapng_exporter/linktype.h>
+
+using namespace Vector::BLF;
+
+#define HAS_FLAG(var,pos) ((var) & (1<<(pos)))
+
+// BLF marks extended CAN identifiers with the most significant bit
+#define BLF_CAN_EXT_ID 0x80000000
+
+namespace blf_converter {
+
+template<class T>
+static void set_common(frame_view* view, T* obj, uint16_t link_type, uint64_t date_offset_ns) {
+	view->link_type = link_type;
+	view->channel = obj->channel;
+	view->timestamp_ns = object_timestamp_ns(obj, date_offset_ns);
+}
+
+static void set_can_id(frame_view* view, uint32_t id) {
+	view->id = id & ~BLF_CAN_EXT_ID;
+	if (id & BLF_CAN_EXT_ID) {
+		view->flags |= FRAME_FLAG_EXT;
+	}
+}
+
+template<class T>
+static void set_can_message(frame_view* view, T* obj, uint32_t data_length, uint64_t date_offset_ns) {
+	set_common(view, obj, LINKTYPE_CAN, date_offset_ns);
+	set_can_id(view, obj->id);
+	if (HAS_FLAG(obj->flags, 0)) view->flags |= FRAME_FLAG_TX;
+	if (HAS_FLAG(obj->flags, 7)) view->flags |= FRAME_FLAG_RTR;
+	view->dlc = obj->dlc;
+	view->data = obj->data.data();
+	view->data_length = std::min(data_length, (uint32_t)obj->data.size());
+}
+
+template<class T>
+static void set_can_error(frame_view* view, T* obj, uint64_t date_offset_ns) {
+	set_common(view, obj, LINKTYPE_CAN, date_offset_ns);
+	view->flags |= FRAME_FLAG_ERROR;
+}
+
+template<class T>
+static void set_lin_message(frame_view* view, T* obj, uint64_t date_offset_ns) {
+	set_common(view, obj, LINKTYPE_LIN, date_offset_ns);
+	view->id = obj->id;
+	view->dlc = obj->dlc;
+	if (obj->dir) view->flags |= FRAME_FLAG_TX;
+	view->data = obj->data.data();
+	view->data_length = std::min((uint32_t)obj->dlc, (uint32_t)obj->data.size());
+}
+
+template<class T>
+static void set_lin_error(frame_view* view, T* obj, uint8_t errors, uint64_t date_offset_ns) {
+	set_common(view, obj, LINKTYPE_LIN, date_offset_ns);
+	view->flags |= FRAME_FLAG_ERROR;
+	view->lin_errors = errors;
+}
+
+template<class T>
+static void set_lin_error_id(frame_view* view, T* obj, uint8_t errors, uint64_t date_offset_ns) {
+	set_lin_error(view, obj, errors, date_offset_ns);
+	view->id = obj->id;
+	view->dlc = obj->dlc;
+}
+
+static void set_ethernet_type(frame_view* view, const uint8_t* frame, size_t length) {
+	if (length < 14) {
+		view->header = frame;
+		view->header_length = (uint8_t)length;
+		return;
+	}
+	uint16_t type = (uint16_t)(frame[12] << 8 | frame[13]);
+	size_t header_length = 14;
+	if ((type == 0x8100 || type == 0x88A8) && length >= 18) {
+		view->flags |= FRAME_FLAG_VLAN;
+		view->tci = (uint16_t)(frame[14] << 8 | frame[15]);
+		type = (uint16_t)(frame[16] << 8 | frame[17]);
+		header_length = 18;
+	}
+	view->id = type;
+	view->header = frame;
+	view->header_length = (uint8_t)header_length;
+	view->data = frame + header_length;
+	view->data_length = (uint32_t)(length - header_length);
+}
+
+static void set_ethernet_frame(frame_view* view, EthernetFrame* obj, uint64_t date_offset_ns) {
+	set_common(view, obj, LINKTYPE_ETHERNET, date_offset_ns);
+	if (obj->dir == 1) view->flags |= FRAME_FLAG_TX;
+
+	uint8_t* p = view->header_storage;
+	memcpy(p, obj->destinationAddress.data(), 6);
+	memcpy(p + 6, obj->sourceAddress.data(), 6);
+	p += 12;
+	if (obj->tpid) {
+		view->flags |= FRAME_FLAG_VLAN;
+		view->tci = obj->tci;
+		*p++ = (uint8_t)(obj->tpid >> 8);
+		*p++ = (uint8_t)obj->tpid;
+		*p++ = (uint8_t)(obj->tci >> 8);
+		*p++ = (uint8_t)obj->tci;
+	}
+	*p++ = (uint8_t)(obj->type >> 8);
+	*p++ = (uint8_t)obj->type;
+
+	view->id = obj->type;
+	view->header = view->header_storage;
+	view->header_length = (uint8_t)(p - view->header_storage);
+	view->data = obj->payLoad.data();
+	view->data_length = (uint32_t)obj->payLoad.size();
+}
+
+template<class T>
+static void set_ethernet_frame_ex(frame_view* view, T* obj, uint64_t date_offset_ns) {
+	set_common(view, obj, LINKTYPE_ETHERNET, date_offset_ns);
+	view->hw_channel = obj->hardwareChannel;
+	if (obj->dir == 1) view->flags |= FRAME_FLAG_TX;
+	set_ethernet_type(view, obj->frameData.data(), obj->frameData.size());
+}
+
+template<class T>
+static void set_flexray(frame_view* view, T* obj, uint32_t slot, uint8_t cycle, const uint8_t* data, size_t length, uint64_t date_offset_ns) {
+	set_common(view, obj, LINKTYPE_FLEXRAY, date_offset_ns);
+	view->id = slot;
+	view->cycle = cycle;
+	view->data = data;
+	view->data_length = (uint32_t)length;
+}
+
+bool make_frame_view(ObjectHeaderBase* ohb, uint64_t date_offset_ns, frame_view* view) {
+	memset(view, 0, sizeof(frame_view));
+	switch (ohb->objectType) {
+
+	case ObjectType::CAN_MESSAGE: {
+		auto obj = reinterpret_cast<CanMessage*>(ohb);
+		set_can_message(view, obj, obj->dlc, date_offset_ns);
+		return true;
+	}
+
+	case ObjectType::CAN_MESSAGE2: {
+		auto obj = reinterpret_cast<CanMessage2*>(ohb);
+		set_can_message(view, obj, (uint32_t)obj->data.size(), date_offset_ns);
+		return true;
+	}
+
+	case ObjectType::CAN_FD_MESSAGE: {
+		auto obj = reinterpret_cast<CanFdMessage*>(ohb);
+		set_common(view, obj, LINKTYPE_CAN, date_offset_ns);
+		set_can_id(view, obj->id);
+		if (HAS_FLAG(obj->flags, 0)) view->flags |= FRAME_FLAG_TX;
+		if (HAS_FLAG(obj->flags, 7)) view->flags |= FRAME_FLAG_RTR;
+		if (HAS_FLAG(obj->canFdFlags, 0)) view->flags |= FRAME_FLAG_FDF;
+		if (HAS_FLAG(obj->canFdFlags, 1)) view->flags |= FRAME_FLAG_BRS;
+		if (HAS_FLAG(obj->canFdFlags, 2)) view->flags |= FRAME_FLAG_ESI;
+		view->dlc = obj->dlc;
+		view->data = obj->data.data();
+		view->data_length = std::min((uint32_t)obj->validDataBytes, (uint32_t)obj->data.size());
+		return true;
+	}
+
+	case ObjectType::CAN_FD_MESSAGE_64: {
+		auto obj = reinterpret_cast<CanFdMessage64*>(ohb);
+		set_common(view, obj, LINKTYPE_CAN, date_offset_ns);
+		set_can_id(view, obj->id);
+		if (HAS_FLAG(obj->flags, 6) || HAS_FLAG(obj->flags, 7)) view->flags |= FRAME_FLAG_TX;
+		if (HAS_FLAG(obj->flags, 4)) view->flags |= FRAME_FLAG_RTR;
+		if (HAS_FLAG(obj->flags, 12)) view->flags |= FRAME_FLAG_FDF;
+		if (HAS_FLAG(obj->flags, 13)) view->flags |= FRAME_FLAG_BRS;
+		if (HAS_FLAG(obj->flags, 14)) view->flags |= FRAME_FLAG_ESI;
+		view->dlc = obj->dlc;
+		view->data = obj->data.data();
+		view->data_length = std::min((uint32_t)obj->validDataBytes, (uint32_t)obj->data.size());
+		return true;
+	}
+
+	case ObjectType::CAN_ERROR:
+		set_can_error(view, reinterpret_cast<CanErrorFrame*>(ohb), date_offset_ns);
+		return true;
+
+	case ObjectType::CAN_ERROR_EXT:
+		set_can_error(view, reinterpret_cast<CanErrorFrameExt*>(ohb), date_offset_ns);
+		return true;
+
+	case ObjectType::CAN_FD_ERROR_64:
+		set_can_error(view, reinterpret_cast<CanFdErrorFrame64*>(ohb), date_offset_ns);
+		// Error on a CAN FD bus
+		view->flags |= FRAME_FLAG_FDF;
+		return true;
+
+	case ObjectType::LIN_MESSAGE:
+		set_lin_message(view, reinterpret_cast<LinMessage*>(ohb), date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_MESSAGE2:
+		set_lin_message(view, reinterpret_cast<LinMessage2*>(ohb), date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_CRC_ERROR:
+		set_lin_error_id(view, reinterpret_cast<LinCrcError*>(ohb), LIN_ERROR_CHECKSUM, date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_CRC_ERROR2:
+		set_lin_error_id(view, reinterpret_cast<LinCrcError2*>(ohb), LIN_ERROR_CHECKSUM, date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_RCV_ERROR:
+		set_lin_error_id(view, reinterpret_cast<LinReceiveError*>(ohb), LIN_ERROR_FRAMING, date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_RCV_ERROR2:
+		set_lin_error_id(view, reinterpret_cast<LinReceiveError2*>(ohb), LIN_ERROR_FRAMING, date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_SND_ERROR:
+		set_lin_error_id(view, reinterpret_cast<LinSendError*>(ohb), LIN_ERROR_FRAMING, date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_SND_ERROR2:
+		set_lin_error_id(view, reinterpret_cast<LinSendError2*>(ohb), LIN_ERROR_FRAMING, date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_SLV_TIMEOUT:
+		set_lin_error(view, reinterpret_cast<LinSlaveTimeout*>(ohb), LIN_ERROR_NOSLAVE, date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_SYN_ERROR:
+		set_lin_error(view, reinterpret_cast<LinSyncError*>(ohb), LIN_ERROR_FRAMING, date_offset_ns);
+		return true;
+
+	case ObjectType::LIN_SYN_ERROR2:
+		set_lin_error(view, reinterpret_cast<LinSyncError2*>(ohb), LIN_ERROR_FRAMING, date_offset_ns);
+		return true;
+
+	case ObjectType::ETHERNET_FRAME:
+		set_ethernet_frame(view, reinterpret_cast<EthernetFrame*>(ohb), date_offset_ns);
+		return true;
+
+	case ObjectType::ETHERNET_FRAME_EX:
+		set_ethernet_frame_ex(view, reinterpret_cast<EthernetFrameEx*>(ohb), date_offset_ns);
+		return true;
+
+	case ObjectType::ETHERNET_FRAME_FORWARDED:
+		set_ethernet_frame_ex(view, reinterpret_cast<EthernetFrameForwarded*>(ohb), date_offset_ns);
+		return true;
+
+	case ObjectType::FLEXRAY_DATA: {
+		auto obj = reinterpret_cast<FlexRayData*>(ohb);
+		set_flexray(view, obj, obj->messageId, 0, obj->dataBytes.data(), obj->dataBytes.size(), date_offset_ns);
+		return true;
+	}
+
+	case ObjectType::FLEXRAY_SYNC: {
+		auto obj = reinterpret_cast<FlexRaySync*>(ohb);
+		set_flexray(view, obj, obj->messageId, obj->cycle, obj->dataBytes.data(), obj->dataBytes.size(), date_offset_ns);
+		return true;
+	}
+
+	case ObjectType::FLEXRAY_CYCLE: {
+		auto obj = reinterpret_cast<FlexRayV6StartCycleEvent*>(ohb);
+		set_flexray(view, obj, 0, 0, obj->dataBytes.data(), obj->dataBytes.size(), date_offset_ns);
+		view->flags |= FRAME_FLAG_STATUS;
+		return true;
+	}
+
+	case ObjectType::FLEXRAY_MESSAGE: {
+		auto obj = reinterpret_cast<FlexRayV6Message*>(ohb);
+		set_flexray(view, obj, obj->frameId, obj->cycle, obj->dataBytes.data(), obj->dataBytes.size(), date_offset_ns);
+		return true;
+	}
+
+	case ObjectType::FR_ERROR: {
+		auto obj = reinterpret_cast<FlexRayVFrError*>(ohb);
+		set_flexray(view, obj, 0, obj->cycle, nullptr, 0, date_offset_ns);
+		view->flags |= FRAME_FLAG_ERROR;
+		return true;
+	}
+
+	case ObjectType::FR_STATUS: {
+		auto obj = reinterpret_cast<FlexRayVFrStatus*>(ohb);
+		set_flexray(view, obj, 0, obj->cycle, nullptr, 0, date_offset_ns);
+		view->flags |= FRAME_FLAG_STATUS;
+		return true;
+	}
+
+	case ObjectType::FR_STARTCYCLE: {
+		auto obj = reinterpret_cast<FlexRayVFrStartCycle*>(ohb);
+		set_flexray(view, obj, 0, obj->cycle, obj->dataBytes.data(), obj->dataBytes.size(), date_offset_ns);
+		view->flags |= FRAME_FLAG_STATUS;
+		return true;
+	}
+
+	case ObjectType::FR_RCVMESSAGE: {
+		auto obj = reinterpret_cast<FlexRayVFrReceiveMsg*>(ohb);
+		size_t length = std::min((size_t)obj->byteCount, obj->dataBytes.size());
+		set_flexray(view, obj, obj->frameId, obj->cycle, obj->dataBytes.data(), length, date_offset_ns);
+		if (obj->dir) view->flags |= FRAME_FLAG_TX;
+		return true;
+	}
+
+	case ObjectType::FR_RCVMESSAGE_EX: {
+		auto obj = reinterpret_cast<FlexRayVFrReceiveMsgEx*>(ohb);
+		size_t length = std::min((size_t)obj->byteCount, obj->dataBytes.size());
+		set_flexray(view, obj, obj->frameId, (uint8_t)obj->cycle, obj->dataBytes.data(), length, date_offset_ns);
+		if (obj->dir) view->flags |= FRAME_FLAG_TX;
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+}
@@ -0,0 +1,80 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_FRAME_VIEW_H
+#define _APP_FRAME_VIEW_H
+
+#include <cstdint>
+
+#include <Vector/BLF.h>
+
+#define FRAME_FLAG_TX    0x0001
+#define FRAME_FLAG_ERROR 0x0002
+#define FRAME_FLAG_EXT   0x0004 // CAN extended identifier
+#define FRAME_FLAG_RTR   0x0008
+#define FRAME_FLAG_FDF   0x0010
+#define FRAME_FLAG_BRS   0x0020
+#define FRAME_FLAG_ESI   0x0040
+#define FRAME_FLAG_VLAN  0x0080
+#define FRAME_FLAG_STATUS 0x0100 // FlexRay status or start of cycle event, not a frame
+
+namespace blf_converter {
+
+// Bus independent fields of the frame carried by a BLF object
+struct frame_view {
+	uint16_t link_type;
+	uint32_t channel;
+	uint32_t hw_channel;
+	uint64_t timestamp_ns;
+	// CAN / LIN identifier, FlexRay slot or EtherType
+	uint32_t id;
+	uint32_t flags;
+	uint8_t dlc;
+	// FlexRay cycle
+	uint8_t cycle;
+	// Ethernet VLAN tag control information
+	uint16_t tci;
+	// LIN error bits (LIN_ERROR_*)
+	uint8_t lin_errors;
+	// Frame data: CAN / LIN / FlexRay payload, Ethernet payload after the EtherType
+	const uint8_t* data;
+	uint32_t data_length;
+	// Ethernet header (addresses, VLAN tag, EtherType), the full frame is header followed by data
+	const uint8_t* header;
+	uint8_t header_length;
+	uint8_t header_storage[18];
+
+	// Identifies the message: link type, channel id (100000 * hw_channel + channel) and
+	// identifier, extended CAN identifiers are kept apart from standard ones
+	uint64_t key() const {
+		uint64_t channel_id = 100000 * hw_channel + channel;
+		uint32_t ext = flags & FRAME_FLAG_EXT ? 0x80000000 : 0;
+		return (uint64_t)(link_type & 0xFF) << 56 | (channel_id & 0xFFFFFF) << 32 | id | ext;
+	}
+};
+
+// Nanoseconds since the epoch, 0 if the timestamp format is unknown
+template<class ObjectHeaderGeneric>
+uint64_t object_timestamp_ns(const ObjectHeaderGeneric* oh, uint64_t date_offset_ns) {
+	uint64_t ts_factor;
+	switch (oh->objectFlags) {
+	case Vector::BLF::ObjectHeader::ObjectFlags::TimeTenMics:
+		ts_factor = 10000;
+		break;
+	case Vector::BLF::ObjectHeader::ObjectFlags::TimeOneNans:
+		ts_factor = 1;
+		break;
+	default:
+		return 0;
+	}
+	return ((ts_factor * oh->objectTimeStamp) & 0x7fffffffffffffff) + (date_offset_ns & 0x7fffffffffffffff);
+}
+
+// Fills view for bus frames (CAN, LIN, Ethernet, FlexRay), returns false for all other objects.
+// The view points into the object and is only valid as long as the object.
+bool make_frame_view(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns, frame_view* view);
+
+}
+
+#endif
@@ -0,0 +1,181 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "info.hpp"
+
+#include <cstdio>
+
+#include "blf_format.hpp"
+#include "converter.hpp"
+#include "json.hpp"
+
+#define NANOS_PER_SEC 1000000000
+
+using namespace Vector::BLF;
+
+namespace blf_converter {
+
+static uint64_t stream_size(std::istream& in) {
+	in.seekg(0, std::ios_base::end);
+	auto end = in.tellg();
+	in.seekg(0);
+	return end < 0 ? 0 : (uint64_t)end;
+}
+
+bool read_blf_info(std::istream& in, bool walk_containers, blf_info* info) {
+	*info = blf_info();
+	info->file_size = stream_size(in);
+
+	uint8_t header[BLF_FILE_STATISTICS_SIZE];
+	in.read((char*)header, sizeof(header));
+	if (!parse_file_statistics(header, (size_t)in.gcount(), &info->statistics)) {
+		return false;
+	}
+	info->has_statistics = true;
+	if (!walk_containers) {
+		return true;
+	}
+
+	// Only the object headers are read, the container payload is skipped by seeking
+	info->walked = true;
+	uint64_t pos = info->statistics.statisticsSize;
+	uint8_t object[BLF_LOG_CONTAINER_HEADER_SIZE];
+	while (pos < info->file_size) {
+		in.clear();
+		in.seekg(pos);
+		in.read((char*)object, sizeof(object));
+		size_t length = (size_t)in.gcount();
+		if (length < BLF_OBJECT_HEADER_BASE_SIZE) {
+			info->truncated = true;
+			break;
+		}
+		object_header_base base = parse_object_header_base(object);
+		if (base.signature != BLF_OBJECT_SIGNATURE || base.object_size < BLF_OBJECT_HEADER_BASE_SIZE) {
+			info->truncated = true;
+			break;
+		}
+		if (pos + base.object_size > info->file_size) {
+			info->truncated = true;
+			break;
+		}
+		if (base.object_type == (uint32_t)ObjectType::LOG_CONTAINER) {
+			if (length < BLF_LOG_CONTAINER_HEADER_SIZE || base.object_size < BLF_LOG_CONTAINER_HEADER_SIZE) {
+				info->truncated = true;
+				break;
+			}
+			log_container_header container = parse_log_container_header(object);
+			info->containers++;
+			if (container.compression_method != BLF_COMPRESSION_NONE) {
+				info->compressed_containers++;
+			}
+			info->container_bytes += base.object_size - BLF_LOG_CONTAINER_HEADER_SIZE;
+			info->uncompressed_bytes += container.uncompressed_size;
+		}
+		else {
+			info->other_objects++;
+		}
+		pos += base.object_size + base.padding();
+	}
+	in.clear();
+	return true;
+}
+
+static const char* application_name(uint8_t id) {
+	switch (id) {
+	case 1: return "CANalyzer";
+	case 2: return "CANoe";
+	case 3: return "CANstress";
+	case 4: return "CANlog";
+	case 5: return "CANape";
+	case 6: return "CANcaseXL log";
+	case 7: return "Vector Logger Configurator";
+	case 200: return "Porsche Logger";
+	case 201: return "CAETEC Logger";
+	case 202: return "Vector Network Simulator";
+	case 203: return "IPETRONIK logger";
+	case 204: return "RT PK";
+	case 205: return "PikeTec";
+	case 206: return "Sparks";
+	default: return "Unknown";
+	}
+}
+
+static std::string format_systemtime(const SYSTEMTIME& time) {
+	char text[32];
+	snprintf(text, sizeof(text), "%04u-%02u-%02u %02u:%02u:%02u.%03u",
+		time.year, time.month, time.day, time.hour, time.minute, time.second, time.milliseconds);
+	return text;
+}
+
+static double duration_seconds(const FileStatistics& statistics) {
+	uint64_t start = systemtime_to_ns(statistics.measurementStartTime);
+	uint64_t last = systemtime_to_ns(statistics.lastObjectTime);
+	if (start == 0 || last < start) {
+		return 0;
+	}
+	return (double)(last - start) / NANOS_PER_SEC;
+}
+
+void write_blf_info(std::ostream& out, const std::string& path, const blf_info& info, bool json) {
+	const FileStatistics& stats = info.statistics;
+	std::string application = std::string(application_name(stats.applicationId)) + " " +
+		std::to_string(stats.applicationMajor) + "." + std::to_string(stats.applicationMinor) + "." +
+		std::to_string(stats.applicationBuild);
+
+	if (json) {
+		// One line per file, so the output of many files can be concatenated
+		out << "{\"file\":" << json_quote(path);
+		out << ",\"valid\":" << (info.has_statistics ? "true" : "false");
+		out << ",\"file_size\":" << info.file_size;
+		if (info.has_statistics) {
+			out << ",\"application\":" << json_quote(application);
+			out << ",\"api_number\":" << stats.apiNumber;
+			out << ",\"compression_level\":" << (unsigned)stats.compressionLevel;
+			out << ",\"measurement_start\":" << json_quote(format_systemtime(stats.measurementStartTime));
+			out << ",\"last_object\":" << json_quote(format_systemtime(stats.lastObjectTime));
+			out << ",\"duration\":" << duration_seconds(stats);
+			out << ",\"object_count\":" << stats.objectCount;
+			out << ",\"compressed_size\":" << stats.fileSize;
+			out << ",\"uncompressed_size\":" << stats.uncompressedFileSize;
+		}
+		if (info.walked) {
+			out << ",\"containers\":" << info.containers;
+			out << ",\"compressed_containers\":" << info.compressed_containers;
+			out << ",\"container_bytes\":" << info.container_bytes;
+			out << ",\"container_uncompressed_bytes\":" << info.uncompressed_bytes;
+			out << ",\"other_objects\":" << info.other_objects;
+			out << ",\"truncated\":" << (info.truncated ? "true" : "false");
+		}
+		out << "}" << std::endl;
+		return;
+	}
+
+	out << "File:                 " << path << "\n";
+	if (!info.has_statistics) {
+		out << "                      not a BLF file" << std::endl;
+		return;
+	}
+	out << "Application:          " << application << "\n";
+	out << "API number:           " << stats.apiNumber << "\n";
+	out << "Compression level:    " << (unsigned)stats.compressionLevel << "\n";
+	out << "Measurement start:    " << format_systemtime(stats.measurementStartTime) << "\n";
+	out << "Last object:          " << format_systemtime(stats.lastObjectTime) << "\n";
+	out << "Duration:             " << duration_seconds(stats) << " s\n";
+	out << "Objects:              " << stats.objectCount << "\n";
+	out << "Compressed size:      " << stats.fileSize << " bytes\n";
+	out << "Uncompressed size:    " << stats.uncompressedFileSize << " bytes\n";
+	out << "File size:            " << info.file_size << " bytes\n";
+	if (info.walked) {
+		out << "Containers:           " << info.containers << " (" << info.compressed_containers << " compressed)\n";
+		out << "Container payload:    " << info.container_bytes << " bytes, " << info.uncompressed_bytes << " bytes inflated\n";
+		out << "Other objects:        " << info.other_objects << "\n";
+		if (info.truncated) {
+			out << "                      file is truncated or damaged\n";
+		}
+	}
+	out.flush();
+}
+
+}
@@ -0,0 +1,41 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_INFO_H
+#define _APP_INFO_H
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+
+#include <Vector/BLF.h>
+
+namespace blf_converter {
+
+// Summary of a BLF file, read without decoding or inflating any object
+struct blf_info {
+	Vector::BLF::FileStatistics statistics = {};
+	bool has_statistics = false;
+	uint64_t file_size = 0;
+
+	// Only filled by the container walk
+	bool walked = false;
+	bool truncated = false;
+	uint64_t containers = 0;
+	uint64_t compressed_containers = 0;
+	uint64_t container_bytes = 0;
+	uint64_t uncompressed_bytes = 0;
+	uint64_t other_objects = 0;
+};
+
+// Reads the file statistics and, with walk_containers, the headers of all
+// top level objects. Returns false if the input is not a BLF file.
+bool read_blf_info(std::istream& in, bool walk_containers, blf_info* info);
+
+void write_blf_info(std::ostream& out, const std::string& path, const blf_info& info, bool json);
+
+}
+
+#endif
@@ -0,0 +1,38 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "interface_stats.hpp"
+
+#include "frame_view.hpp"
+
+namespace blf_converter {
+
+InterfaceCounterSink::InterfaceCounterSink(ObjectSink& next)
+	: next(next)
+{
+}
+
+void InterfaceCounterSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (make_frame_view(ohb, date_offset_ns, &view)) {
+		uint64_t key = (uint64_t)view.link_type << 32 | (100000 * view.hw_channel + view.channel);
+		if (key != last_key) {
+			last_key = key;
+			last_count = &counts[key];
+		}
+		(*last_count)++;
+	}
+	next.write_object(ohb, date_offset_ns);
+}
+
+void InterfaceCounterSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	next.add_mapping(mapping);
+}
+
+void InterfaceCounterSink::flush() {
+	next.flush();
+}
+
+}
@@ -0,0 +1,37 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_INTERFACE_STATS_H
+#define _APP_INTERFACE_STATS_H
+
+#include "encoder.hpp"
+#include "pcapng_writer.hpp"
+
+namespace blf_converter {
+
+// Counts the bus frames of every interface as read from the BLF file, before
+// filters and reductions. Frames counted here but never written are reported
+// as dropped in the Interface Statistics Blocks of PcapngWriter.
+class InterfaceCounterSink : public ObjectSink {
+public:
+	explicit InterfaceCounterSink(ObjectSink& next);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+	const PcapngWriter::interface_counts& received() const { return counts; }
+
+private:
+	ObjectSink& next;
+	PcapngWriter::interface_counts counts;
+
+	// Consecutive frames are mostly on the same interface
+	uint64_t last_key = UINT64_MAX;
+	uint64_t* last_count = nullptr;
+};
+
+}
+
+#endif
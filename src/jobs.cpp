@@ -0,0 +1,113 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "jobs.hpp"
+
+#include <stdexcept>
+
+#include "json.hpp"
+
+namespace blf_converter {
+
+static std::string member_string(const std::string& path, const nlohmann::json& job, const char* key, const std::string& fallback = "") {
+	auto value = job.find(key);
+	if (value == job.end()) {
+		return fallback;
+	}
+	if (!value->is_string()) {
+		throw std::invalid_argument(path + ": \"" + key + "\" must be a string");
+	}
+	return value->get<std::string>();
+}
+
+static bool ends_with(const std::string& text, const std::string& suffix) {
+	return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+JobOutputs::JobOutputs(const std::string& path, const std::vector<pcapng_exporter::channel_mapping>& mappings) {
+	nlohmann::json document = load_json(path);
+	auto outputs = document.find("outputs");
+	if (outputs == document.end() || !outputs->is_array() || outputs->empty()) {
+		throw std::invalid_argument(path + ": expected a non empty \"outputs\" array");
+	}
+
+	for (const auto& job : *outputs) {
+		if (!job.is_object()) {
+			throw std::invalid_argument(path + ": every output must be an object");
+		}
+		std::string output = member_string(path, job, "path");
+		if (output.empty()) {
+			throw std::invalid_argument(path + ": every output needs a \"path\"");
+		}
+		std::string format = member_string(path, job, "format", "pcapng");
+		std::string filter = member_string(path, job, "filter");
+		snap_lengths snaplen = parse_snaplen(member_string(path, job, "snaplen"));
+
+		if (format == "pcapng") {
+			file_writers.push_back(std::make_unique<AsyncFileWriter>(output));
+			pcapng_writers.push_back(std::make_unique<PcapngWriter>(*file_writers.back()));
+			for (const auto& mapping : mappings) {
+				pcapng_writers.back()->add_mapping(mapping);
+			}
+			fan_out.add_packet_output(*pcapng_writers.back(), filter, snaplen);
+		}
+		else if (format == "pcap") {
+			std::string base = ends_with(output, ".pcap") ? output.substr(0, output.size() - 5) : output;
+			pcap_writers.push_back(std::make_unique<PcapWriter>(base));
+			for (const auto& mapping : mappings) {
+				pcap_writers.back()->add_mapping(mapping);
+			}
+			fan_out.add_packet_output(*pcap_writers.back(), filter, snaplen);
+		}
+		else if (format == "columnar") {
+			columnar_files.push_back(std::make_unique<std::ofstream>(output, std::ios_base::out | std::ios_base::binary));
+			std::ofstream* file = columnar_files.back().get();
+			if (!file->is_open()) {
+				throw std::runtime_error("Unable to open: " + output);
+			}
+			columnar_sinks.push_back(std::make_unique<ColumnarSink>([file](const uint8_t* data, size_t length) {
+				file->write((const char*)data, length);
+			}));
+			fan_out.add_object_output(*columnar_sinks.back(), filter);
+		}
+		else if (format == "stats") {
+			statistics.emplace_back(output, std::make_unique<StatisticsSink>(discard));
+			fan_out.add_object_output(*statistics.back().second, filter);
+		}
+		else {
+			throw std::invalid_argument(path + ": unknown output format " + format);
+		}
+	}
+}
+
+void JobOutputs::close() {
+	for (const auto& entry : statistics) {
+		std::ofstream report(entry.first);
+		if (ends_with(entry.first, ".csv")) {
+			entry.second->write_csv(report);
+		}
+		else {
+			entry.second->write_json(report);
+		}
+		report.close();
+		if (!report) {
+			throw std::runtime_error("Unable to write: " + entry.first);
+		}
+	}
+	for (auto& file : columnar_files) {
+		file->close();
+		if (!*file) {
+			throw std::runtime_error("Unable to write columnar output");
+		}
+	}
+	for (auto& writer : pcap_writers) {
+		writer->close();
+	}
+	for (auto& writer : file_writers) {
+		writer->close();
+	}
+}
+
+}
@@ -0,0 +1,59 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_JOBS_H
+#define _APP_JOBS_H
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <pcapng_exporter/pcapng_exporter.hpp>
+
+#include "columnar.hpp"
+#include "fan_out.hpp"
+#include "file_writer.hpp"
+#include "pcap_writer.hpp"
+#include "pcapng_writer.hpp"
+#include "statistics.hpp"
+
+namespace blf_converter {
+
+// Outputs listed in a --jobs file, all written in one pass over the input:
+//
+//   {"outputs": [
+//     {"path": "all.pcapng"},
+//     {"path": "eth.pcapng", "filter": "eth", "snaplen": "eth=128"},
+//     {"path": "errors.pcap", "format": "pcap", "filter": "error"},
+//     {"path": "stats.csv", "format": "stats"}
+//   ]}
+//
+// Formats are pcapng (default), pcap, columnar and stats (JSON, CSV if the path
+// ends with .csv). Filters and snap lengths use the syntax of --filter and --snaplen.
+class JobOutputs {
+public:
+	// Throws std::runtime_error for unreadable files and std::invalid_argument for invalid jobs
+	JobOutputs(const std::string& path, const std::vector<pcapng_exporter::channel_mapping>& mappings);
+
+	ObjectSink& sink() { return fan_out; }
+
+	// Writes the statistics and closes all files, throws std::runtime_error on I/O errors
+	void close();
+
+private:
+	FanOutSink fan_out;
+	NullSink discard;
+	std::vector<std::unique_ptr<AsyncFileWriter>> file_writers;
+	std::vector<std::unique_ptr<PcapngWriter>> pcapng_writers;
+	std::vector<std::unique_ptr<PcapWriter>> pcap_writers;
+	std::vector<std::unique_ptr<std::ofstream>> columnar_files;
+	std::vector<std::unique_ptr<ColumnarSink>> columnar_sinks;
+	std::vector<std::pair<std::string, std::unique_ptr<StatisticsSink>>> statistics;
+};
+
+}
+
+#endif
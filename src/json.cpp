@@ -0,0 +1,51 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "json.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace blf_converter {
+
+nlohmann::json load_json(const std::string& path) {
+	std::ifstream in(path, std::ios_base::in | std::ios_base::binary);
+	if (!in.is_open()) {
+		throw std::runtime_error("Unable to open: " + path);
+	}
+	try {
+		return nlohmann::json::parse(in);
+	}
+	catch (nlohmann::json::exception& e) {
+		throw std::runtime_error(path + ": " + e.what());
+	}
+}
+
+std::string json_quote(const std::string& text) {
+	std::string out = "\"";
+	for (unsigned char c : text) {
+		switch (c) {
+		case '"': out += "\\\""; break;
+		case '\\': out += "\\\\"; break;
+		case '\n': out += "\\n"; break;
+		case '\r': out += "\\r"; break;
+		case '\t': out += "\\t"; break;
+		default:
+			if (c < 0x20) {
+				char escape[8];
+				snprintf(escape, sizeof(escape), "\\u%04x", c);
+				out += escape;
+			}
+			else {
+				out += (char)c;
+			}
+		}
+	}
+	out += '"';
+	return out;
+}
+
+}
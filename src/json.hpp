@@ -0,0 +1,23 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_JSON_H
+#define _APP_JSON_H
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+namespace blf_converter {
+
+// Reads a configuration file with nlohmann::json, which pcapng_exporter uses
+// for channel maps. Throws std::runtime_error if it cannot be read or parsed.
+nlohmann::json load_json(const std::string& path);
+
+// Escapes and quotes text for JSON output
+std::string json_quote(const std::string& text);
+
+}
+
+#endif
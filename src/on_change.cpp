@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "on_change.hpp"
+
+#include <pcapng_exporter/linktype.h>
+
+// 64 bit FNV-1a
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+namespace blf_converter {
+
+static uint64_t hash_bytes(uint64_t hash, const uint8_t* data, size_t length) {
+	for (size_t i = 0; i < length; i++) {
+		hash ^= data[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+OnChangeSink::OnChangeSink(ObjectSink& next, uint64_t heartbeat_ns)
+	: next(next), heartbeat_ns(heartbeat_ns)
+{
+}
+
+void OnChangeSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (make_frame_view(ohb, date_offset_ns, &view) && !changed(view)) {
+		unchanged_count++;
+		return;
+	}
+	next.write_object(ohb, date_offset_ns);
+}
+
+bool OnChangeSink::changed(const frame_view& view) {
+	if (view.link_type == LINKTYPE_ETHERNET || (view.flags & (FRAME_FLAG_ERROR | FRAME_FLAG_STATUS))) {
+		return true;
+	}
+
+	uint8_t fields[6] = {
+		(uint8_t)view.flags, (uint8_t)(view.flags >> 8), view.dlc, view.lin_errors,
+		(uint8_t)view.data_length, (uint8_t)(view.data_length >> 8) };
+	uint64_t hash = hash_bytes(FNV_OFFSET_BASIS, fields, sizeof(fields));
+	hash = hash_bytes(hash, view.data, view.data_length);
+
+	// Cycle multiplexed FlexRay slots carry a different message per cycle,
+	// slot identifiers use only the low 11 bits of the key
+	uint64_t key = view.key();
+	if (view.link_type == LINKTYPE_FLEXRAY) {
+		key |= (uint64_t)view.cycle << 16;
+	}
+
+	auto it = messages.find(key);
+	if (it == messages.end()) {
+		messages.emplace(key, message_state{ hash, view.timestamp_ns });
+		return true;
+	}
+	message_state& state = it->second;
+	bool beat = heartbeat_ns && view.timestamp_ns >= state.last_written_ns + heartbeat_ns;
+	if (hash == state.hash && !beat) {
+		return false;
+	}
+	state.hash = hash;
+	state.last_written_ns = view.timestamp_ns;
+	return true;
+}
+
+void OnChangeSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	next.add_mapping(mapping);
+}
+
+void OnChangeSink::flush() {
+	next.flush();
+}
+
+}
@@ -0,0 +1,48 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_ON_CHANGE_H
+#define _APP_ON_CHANGE_H
+
+#include <cstdint>
+#include <unordered_map>
+
+#include "encoder.hpp"
+#include "frame_view.hpp"
+
+namespace blf_converter {
+
+// Passes a CAN, LIN or FlexRay frame only when its payload, length or flags
+// differ from the previous frame of the same message (interface, identifier
+// and, for FlexRay, cycle), or when the last passed frame is older than the
+// heartbeat. Ethernet, error frames, FlexRay status events and other objects
+// always pass.
+class OnChangeSink : public ObjectSink {
+public:
+	// heartbeat_ns 0 disables the heartbeat
+	OnChangeSink(ObjectSink& next, uint64_t heartbeat_ns);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+	uint64_t unchanged() const { return unchanged_count; }
+
+private:
+	struct message_state {
+		uint64_t hash;
+		uint64_t last_written_ns;
+	};
+
+	ObjectSink& next;
+	uint64_t heartbeat_ns;
+	std::unordered_map<uint64_t, message_state> messages;
+	uint64_t unchanged_count = 0;
+
+	bool changed(const frame_view& view);
+};
+
+}
+
+#endif
@@ -0,0 +1,433 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "parallel.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <optional>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "blf_format.hpp"
+#include "blf_reader.hpp"
+#include "channels.hpp"
+#include "converter.hpp"
+#include "interface_stats.hpp"
+#include "pcapng_writer.hpp"
+
+using namespace Vector::BLF;
+
+namespace blf_converter {
+
+struct container_ref {
+	uint64_t offset;
+	uint32_t size;
+};
+
+// Start of the first object of a range: offset in the uncompressed content of a container
+struct sync_point {
+	size_t container;
+	size_t offset;
+};
+
+// Reads single log containers of a file, each thread has its own
+class ContainerFile {
+public:
+	explicit ContainerFile(const std::string& path)
+		: in(path, std::ios_base::in | std::ios_base::binary)
+	{
+		if (!in.is_open()) {
+			throw std::runtime_error("Unable to open: " + path);
+		}
+	}
+
+	const uint8_t* read(const container_ref& container, size_t* length) {
+		raw.resize(container.size);
+		in.seekg((std::streamoff)container.offset);
+		in.read((char*)raw.data(), raw.size());
+		if ((size_t)in.gcount() != raw.size()) {
+			throw std::runtime_error("Unexpected end of file");
+		}
+		return inflate_log_container(raw.data(), raw.size(), inflated, length);
+	}
+
+private:
+	std::ifstream in;
+	std::vector<uint8_t> raw;
+	std::vector<uint8_t> inflated;
+};
+
+// Walks the top level object headers, the file ends at the first incomplete or damaged object
+static std::vector<container_ref> find_containers(std::istream& in, const FileStatistics& statistics) {
+	std::vector<container_ref> containers;
+	in.seekg(0, std::ios_base::end);
+	uint64_t file_size = (uint64_t)in.tellg();
+	uint64_t pos = std::max((uint64_t)statistics.statisticsSize, (uint64_t)BLF_FILE_STATISTICS_SIZE);
+	uint8_t data[BLF_OBJECT_HEADER_BASE_SIZE];
+	while (pos + sizeof(data) <= file_size) {
+		in.seekg((std::streamoff)pos);
+		in.read((char*)data, sizeof(data));
+		if (in.gcount() != sizeof(data)) {
+			break;
+		}
+		object_header_base header = parse_object_header_base(data);
+		if (header.signature != BLF_OBJECT_SIGNATURE || header.object_size < BLF_OBJECT_HEADER_BASE_SIZE) {
+			break;
+		}
+		if (pos + header.object_size > file_size) {
+			break;
+		}
+		if (header.object_type == (uint32_t)ObjectType::LOG_CONTAINER) {
+			containers.push_back({ pos, header.object_size });
+		}
+		pos += header.object_size + header.padding();
+	}
+	in.clear();
+	return containers;
+}
+
+// True if a plausible sequence of object headers starts at pos and runs to the end
+// of the data, the last object may continue in the next container
+static bool valid_object_chain(const uint8_t* data, size_t length, size_t pos) {
+	while (length - pos >= BLF_OBJECT_HEADER_BASE_SIZE) {
+		object_header_base header = parse_object_header_base(data + pos);
+		if (header.signature != BLF_OBJECT_SIGNATURE
+			|| (header.header_version != 1 && header.header_version != 2)
+			|| header.header_size < BLF_OBJECT_HEADER_BASE_SIZE
+			|| header.object_size < header.header_size
+			|| header.object_type == 0
+			|| header.object_type == (uint32_t)ObjectType::LOG_CONTAINER) {
+			return false;
+		}
+		if (length - pos < header.object_size + header.padding()) {
+			return true;
+		}
+		pos += header.object_size + header.padding();
+	}
+	return true;
+}
+
+// First object start in the containers [first, last), objects may span containers
+static std::optional<sync_point> find_sync_point(ContainerFile& file, const std::vector<container_ref>& containers, size_t first, size_t last) {
+	for (size_t c = first; c < last; c++) {
+		size_t length;
+		const uint8_t* data = file.read(containers[c], &length);
+		for (size_t pos = 0; pos + BLF_OBJECT_HEADER_BASE_SIZE <= length; pos++) {
+			if (read_le32(data + pos) == BLF_OBJECT_SIGNATURE && valid_object_chain(data, length, pos)) {
+				return sync_point{ c, pos };
+			}
+		}
+	}
+	return std::nullopt;
+}
+
+// Feeds the objects from begin up to end to the reader, returns false if an object crosses end
+static bool read_range(ContainerFile& file, const std::vector<container_ref>& containers, sync_point begin, sync_point end, BlfReader& reader) {
+	for (size_t c = begin.container; c <= end.container && c < containers.size(); c++) {
+		size_t length;
+		const uint8_t* data = file.read(containers[c], &length);
+		size_t from = c == begin.container ? begin.offset : 0;
+		size_t to = c == end.container ? std::min(end.offset, length) : length;
+		if (to > from) {
+			reader.push_uncompressed(data + from, to - from);
+		}
+	}
+	return !reader.has_partial_object();
+}
+
+// Copies a section file to its offset in the output, other sections are copied at the same time
+static void copy_section(const std::string& section, const std::string& output, uint64_t offset, uint64_t size) {
+	uint64_t copied = 0;
+#ifdef __linux__
+	// Copies within the kernel, file systems with reflinks share the blocks instead
+	int in_fd = open(section.c_str(), O_RDONLY);
+	int out_fd = open(output.c_str(), O_WRONLY);
+	if (in_fd >= 0 && out_fd >= 0) {
+		loff_t in_offset = 0;
+		loff_t out_offset = (loff_t)offset;
+		while (copied < size) {
+			ssize_t n = copy_file_range(in_fd, &in_offset, out_fd, &out_offset, size - copied, 0);
+			if (n <= 0) {
+				// Not supported here, the rest is copied below
+				break;
+			}
+			copied += n;
+		}
+	}
+	if (in_fd >= 0) close(in_fd);
+	if (out_fd >= 0) close(out_fd);
+#endif
+	if (copied == size) {
+		return;
+	}
+	std::ifstream in(section, std::ios_base::in | std::ios_base::binary);
+	std::fstream out(output, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+	in.seekg((std::streamoff)copied);
+	out.seekp((std::streamoff)(offset + copied));
+	std::vector<char> buffer(1 << 20);
+	while (copied < size && in) {
+		in.read(buffer.data(), (std::streamsize)std::min((uint64_t)buffer.size(), size - copied));
+		out.write(buffer.data(), in.gcount());
+		copied += in.gcount();
+	}
+	out.close();
+	if (copied != size || !out) {
+		throw std::runtime_error("Unable to write: " + output);
+	}
+}
+
+// Waits for all tasks, rethrows the first exception
+template <class T>
+static std::vector<T> wait_all(std::vector<std::future<T>>& tasks) {
+	std::vector<T> results;
+	std::exception_ptr error;
+	for (auto& task : tasks) {
+		try {
+			results.push_back(task.get());
+		}
+		catch (...) {
+			if (!error) {
+				error = std::current_exception();
+			}
+		}
+	}
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	return results;
+}
+
+bool convert_parallel(
+	const std::string& input,
+	const std::string& output,
+	size_t threads,
+	const std::vector<pcapng_exporter::channel_mapping>& mappings,
+	const snap_lengths& snaplen,
+	bool interface_statistics,
+	std::function<void(const std::exception& e)> on_error
+) {
+	std::ifstream in(input, std::ios_base::in | std::ios_base::binary);
+	if (!in.is_open()) {
+		throw std::runtime_error("Unable to open: " + input);
+	}
+	uint8_t header[BLF_FILE_STATISTICS_SIZE];
+	in.read((char*)header, sizeof(header));
+	FileStatistics statistics;
+	if (!parse_file_statistics(header, (size_t)in.gcount(), &statistics)) {
+		return false;
+	}
+	std::vector<container_ref> containers = find_containers(in, statistics);
+	size_t ranges = std::min(threads, containers.size());
+	if (ranges < 2) {
+		return false;
+	}
+
+	// Ranges of about the same compressed size
+	uint64_t total = 0;
+	for (const auto& container : containers) {
+		total += container.size;
+	}
+	std::vector<size_t> first_container = { 0 };
+	uint64_t sum = 0;
+	for (size_t c = 0; c < containers.size() && first_container.size() < ranges; c++) {
+		if (sum >= total * first_container.size() / ranges && c > first_container.back()) {
+			first_container.push_back(c);
+		}
+		sum += containers[c].size;
+	}
+	first_container.push_back(containers.size());
+
+	// Every range but the first starts at the first object beginning in it
+	std::vector<std::future<std::optional<sync_point>>> sync_tasks;
+	for (size_t r = 1; r + 1 < first_container.size(); r++) {
+		sync_tasks.push_back(std::async(std::launch::async, [&, r] {
+			ContainerFile file(input);
+			return find_sync_point(file, containers, first_container[r], first_container[r + 1]);
+		}));
+	}
+	std::vector<sync_point> starts = { { 0, 0 } };
+	try {
+		for (const auto& sync : wait_all(sync_tasks)) {
+			// Ranges without an object start are part of the previous one
+			if (sync) {
+				starts.push_back(sync.value());
+			}
+		}
+	}
+	catch (std::runtime_error&) {
+		return false;
+	}
+	if (starts.size() < 2) {
+		return false;
+	}
+	starts.push_back({ containers.size(), 0 });
+	size_t sections = starts.size() - 1;
+
+	// Channel names of the whole file, the XML of one channel may be split over several AppText objects
+	std::vector<std::future<std::optional<std::vector<AppText>>>> scan_tasks;
+	for (size_t s = 0; s < sections; s++) {
+		scan_tasks.push_back(std::async(std::launch::async, [&, s]() -> std::optional<std::vector<AppText>> {
+			std::vector<AppText> texts;
+			try {
+				ContainerFile file(input);
+				BlfReader reader([&texts](ObjectHeaderBase* ohb) {
+					texts.push_back(*reinterpret_cast<AppText*>(ohb));
+				});
+				reader.set_object_filter([](uint32_t object_type) {
+					return object_type == (uint32_t)ObjectType::APP_TEXT;
+				});
+				if (!read_range(file, containers, starts[s], starts[s + 1], reader) && s + 1 < sections) {
+					return std::nullopt;
+				}
+			}
+			catch (std::runtime_error&) {
+				return std::nullopt;
+			}
+			return texts;
+		}));
+	}
+	std::vector<pcapng_exporter::channel_mapping> all_mappings = mappings;
+	channel_state channels;
+	for (auto& texts : wait_all(scan_tasks)) {
+		if (!texts) {
+			// The ranges were not split at object boundaries or the file is damaged
+			return false;
+		}
+		for (auto& text : texts.value()) {
+			std::vector<pcapng_exporter::channel_mapping> found;
+			configure_channels(&found, &channels, &text);
+			all_mappings.insert(all_mappings.end(), found.begin(), found.end());
+		}
+	}
+
+	std::vector<std::string> paths;
+	for (size_t s = 0; s < sections; s++) {
+		paths.push_back(s == 0 ? output : output + ".part" + std::to_string(s));
+	}
+	auto remove_outputs = [&paths](size_t first) {
+		for (size_t s = first; s < paths.size(); s++) {
+			std::remove(paths[s].c_str());
+		}
+	};
+
+	uint64_t date_offset_ns = calculate_startdate(statistics);
+	// Set by the last section if the file ends within an object
+	std::string truncated;
+	std::vector<std::future<bool>> convert_tasks;
+	for (size_t s = 0; s < sections; s++) {
+		convert_tasks.push_back(std::async(std::launch::async, [&, s] {
+			std::ofstream out(paths[s], std::ios_base::out | std::ios_base::binary);
+			if (!out.is_open()) {
+				throw std::runtime_error("Unable to open: " + paths[s]);
+			}
+			PcapngWriter writer([&out](const uint8_t* data, size_t length) {
+				out.write((const char*)data, length);
+			});
+			for (const auto& mapping : all_mappings) {
+				writer.add_mapping(mapping);
+			}
+			PacketEncoder encoder(writer, snaplen);
+			InterfaceCounterSink counter(encoder);
+			ObjectSink* first = &encoder;
+			if (interface_statistics) {
+				writer.set_interface_statistics(&counter.received());
+				first = &counter;
+			}
+			BlfReader reader([&](ObjectHeaderBase* ohb) {
+				if (ohb->objectType != ObjectType::APP_TEXT) {
+					first->write_object(ohb, date_offset_ns);
+				}
+			});
+			bool ok;
+			try {
+				ContainerFile file(input);
+				ok = read_range(file, containers, starts[s], starts[s + 1], reader);
+				if (!ok && s + 1 == sections) {
+					ok = true;
+					try {
+						reader.end_of_file();
+					}
+					catch (std::runtime_error& e) {
+						truncated = e.what();
+					}
+				}
+			}
+			catch (std::runtime_error&) {
+				ok = false;
+			}
+			encoder.flush();
+			out.close();
+			if (!out) {
+				throw std::runtime_error("Unable to write: " + paths[s]);
+			}
+			return ok;
+		}));
+	}
+	std::vector<bool> complete;
+	try {
+		complete = wait_all(convert_tasks);
+	}
+	catch (...) {
+		remove_outputs(0);
+		throw;
+	}
+	if (std::find(complete.begin(), complete.end(), false) != complete.end()) {
+		remove_outputs(0);
+		return false;
+	}
+
+	// A PCAPNG file may hold several sections, they follow each other. The first
+	// section already is the output, the others are copied behind it.
+	std::vector<uint64_t> offsets;
+	std::vector<uint64_t> sizes;
+	uint64_t size = 0;
+	try {
+		for (size_t s = 0; s < sections; s++) {
+			offsets.push_back(size);
+			sizes.push_back(std::filesystem::file_size(paths[s]));
+			size += sizes.back();
+		}
+		std::filesystem::resize_file(output, size);
+	}
+	catch (std::filesystem::filesystem_error& e) {
+		remove_outputs(0);
+		throw std::runtime_error(e.what());
+	}
+	std::vector<std::future<void>> copy_tasks;
+	for (size_t s = 1; s < sections; s++) {
+		copy_tasks.push_back(std::async(std::launch::async, [&, s] {
+			copy_section(paths[s], output, offsets[s], sizes[s]);
+		}));
+	}
+	// All copies end before the files are removed
+	for (auto& task : copy_tasks) {
+		task.wait();
+	}
+	try {
+		for (auto& task : copy_tasks) {
+			task.get();
+		}
+	}
+	catch (...) {
+		remove_outputs(0);
+		throw;
+	}
+	remove_outputs(1);
+
+	if (!truncated.empty() && on_error) {
+		on_error(std::runtime_error(truncated));
+	}
+	return true;
+}
+
+}
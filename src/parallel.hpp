@@ -0,0 +1,48 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_PARALLEL_H
+#define _APP_PARALLEL_H
+
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <pcapng_exporter/pcapng_exporter.hpp>
+
+#include "encoder.hpp"
+
+namespace blf_converter {
+
+// Converts one BLF file with several threads. The log containers are split into
+// ranges of about the same size, each range is converted by its own thread into
+// its own PCAPNG section. The sections are then copied to their offsets in the
+// output concurrently.
+//
+// The channel mappings of all AppText objects are collected first, so that all
+// sections name their interfaces the same. Objects spanning two ranges belong
+// to the range they start in.
+//
+// With interface_statistics every section ends with its Interface Statistics Blocks.
+//
+// A file ending within an object is converted up to that object and the error
+// is passed to on_error, like the errors of unfinished sequential conversions.
+//
+// Returns false without writing anything when the file cannot be split, e.g.
+// because it has too few containers, it is then to be converted sequentially.
+// Throws std::runtime_error on I/O errors and damaged files.
+bool convert_parallel(
+	const std::string& input,
+	const std::string& output,
+	size_t threads,
+	const std::vector<pcapng_exporter::channel_mapping>& mappings,
+	const snap_lengths& snaplen,
+	bool interface_statistics = false,
+	std::function<void(const std::exception& e)> on_error = nullptr
+);
+
+}
+
+#endif
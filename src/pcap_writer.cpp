@@ -0,0 +1,182 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "pcap_writer.hpp"
+
+#include <optional>
+#include <stdexcept>
+
+#include <pcapng_exporter/linktype.h>
+
+#include "json.hpp"
+
+// https://www.ietf.org/archive/id/draft-gharris-opsawg-pcap-01.html
+#define PCAP_MAGIC_NANOSECONDS 0xA1B23C4D
+#define PCAP_VERSION_MAJOR 2
+#define PCAP_VERSION_MINOR 4
+#define PCAP_SNAPLEN 262144
+
+namespace blf_converter {
+
+static void put_le16(uint8_t* p, uint16_t value) {
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+}
+
+static void put_le32(uint8_t* p, uint32_t value) {
+	put_le16(p, (uint16_t)value);
+	put_le16(p + 2, (uint16_t)(value >> 16));
+}
+
+static std::string link_name(uint16_t link_type) {
+	switch (link_type) {
+	case LINKTYPE_CAN:
+		return "can";
+	case LINKTYPE_ETHERNET:
+		return "eth";
+	case LINKTYPE_FLEXRAY:
+		return "flexray";
+	case LINKTYPE_LIN:
+		return "lin";
+	default:
+		return std::to_string(link_type);
+	}
+}
+
+// The channel list refers to the pcap files next to it
+static std::string file_name(const std::string& path) {
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? path : path.substr(slash + 1);
+}
+
+PcapWriter::PcapWriter(const std::string& base)
+	: base(base)
+{
+}
+
+PcapWriter::link_output& PcapWriter::find_output(uint16_t link_type) {
+	auto it = outputs.find(link_type);
+	if (it != outputs.end()) {
+		return *it->second;
+	}
+
+	auto output = std::make_unique<link_output>();
+	std::string name = base + "." + link_name(link_type);
+	output->path = name + ".pcap";
+	output->pcap.open(output->path, std::ios_base::out | std::ios_base::binary);
+	output->interface_ids.open(name + ".ifidx", std::ios_base::out | std::ios_base::binary);
+	if (!output->pcap.is_open() || !output->interface_ids.is_open()) {
+		throw std::runtime_error("Unable to open: " + output->path);
+	}
+
+	uint8_t header[24] = { 0 };
+	put_le32(header, PCAP_MAGIC_NANOSECONDS);
+	put_le16(header + 4, PCAP_VERSION_MAJOR);
+	put_le16(header + 6, PCAP_VERSION_MINOR);
+	put_le32(header + 16, PCAP_SNAPLEN);
+	put_le32(header + 20, link_type);
+	output->pcap.write((const char*)header, sizeof(header));
+
+	return *outputs.emplace(link_type, std::move(output)).first->second;
+}
+
+PcapWriter::interface_info& PcapWriter::find_interface(uint16_t link_type, uint32_t channel, uint32_t hw_channel) {
+	uint32_t channel_id = 100000 * hw_channel + channel;
+	uint64_t key = (uint64_t)link_type << 32 | channel_id;
+	auto it = interface_ids.find(key);
+	if (it != interface_ids.end()) {
+		return interfaces[it->second];
+	}
+
+	std::optional<std::string> name;
+	for (const auto& mapping : mappings) {
+		if (mapping.when.chl_id && mapping.when.chl_id.value() != channel_id) continue;
+		if (mapping.when.chl_link && mapping.when.chl_link.value() != link_type) continue;
+		if (mapping.change.inf_name) {
+			name = mapping.change.inf_name;
+			break;
+		}
+	}
+	uint16_t id = (uint16_t)interfaces.size();
+	interfaces.push_back({ id, link_type, channel, hw_channel, name ? name.value() : unmapped_interface_name(link_type, channel, hw_channel, !mappings.empty()), 0 });
+	interface_ids.emplace(key, id);
+	return interfaces.back();
+}
+
+void PcapWriter::write_packet(
+	uint16_t link_type,
+	uint32_t channel,
+	uint32_t hw_channel,
+	const light_packet_header& header,
+	const uint8_t* data
+) {
+	link_output& output = find_output(link_type);
+	interface_info& info = find_interface(link_type, channel, hw_channel);
+	info.packets++;
+
+	uint8_t record[16];
+	put_le32(record, (uint32_t)header.timestamp.tv_sec);
+	put_le32(record + 4, (uint32_t)header.timestamp.tv_nsec);
+	put_le32(record + 8, header.captured_length);
+	put_le32(record + 12, header.original_length);
+	output.pcap.write((const char*)record, sizeof(record));
+	output.pcap.write((const char*)data, header.captured_length);
+
+	uint8_t id[2];
+	put_le16(id, info.id);
+	output.interface_ids.write((const char*)id, sizeof(id));
+}
+
+void PcapWriter::write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) {
+	uint8_t data[LIN_FRAME_MAX_SIZE];
+	light_packet_header lin_header = { 0 };
+	lin_header.timestamp = header.timestamp;
+	lin_header.captured_length = (uint32_t)encode_lin_frame(frame, data);
+	lin_header.original_length = lin_header.captured_length;
+	write_packet(LINKTYPE_LIN, header.channel_id, 0, lin_header, data);
+}
+
+void PcapWriter::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	mappings.push_back(mapping);
+}
+
+void PcapWriter::flush() {
+	for (auto& output : outputs) {
+		output.second->pcap.flush();
+		output.second->interface_ids.flush();
+	}
+}
+
+void PcapWriter::close() {
+	std::string path = base + ".channels.json";
+	std::ofstream out(path);
+	out << "{\"interfaces\": [";
+	for (const auto& info : interfaces) {
+		out << (info.id ? "," : "") << "\n  {"
+			<< "\"id\": " << info.id
+			<< ", \"file\": " << json_quote(file_name(outputs[info.link_type]->path))
+			<< ", \"link_type\": " << info.link_type
+			<< ", \"name\": " << json_quote(info.name)
+			<< ", \"channel\": " << info.channel
+			<< ", \"hw_channel\": " << info.hw_channel
+			<< ", \"packets\": " << info.packets
+			<< "}";
+	}
+	out << "\n]}\n";
+	out.close();
+	if (!out) {
+		throw std::runtime_error("Unable to write: " + path);
+	}
+
+	for (auto& output : outputs) {
+		output.second->pcap.close();
+		output.second->interface_ids.close();
+		if (!output.second->pcap || !output.second->interface_ids) {
+			throw std::runtime_error("Unable to write: " + output.second->path);
+		}
+	}
+}
+
+}
@@ -0,0 +1,73 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_PCAP_WRITER_H
+#define _APP_PCAP_WRITER_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sink.hpp"
+
+namespace blf_converter {
+
+// Writes classic libpcap files with nanosecond timestamps, one per link type:
+// <base>.can.pcap, <base>.eth.pcap, <base>.flexray.pcap and <base>.lin.pcap.
+//
+// Classic pcap has no interfaces, so the channel of every packet is kept in
+// <base>.<link>.ifidx, one uint16 little endian interface id per packet in file
+// order. <base>.channels.json lists the interfaces with their names and channels.
+class PcapWriter : public PacketSink {
+public:
+	explicit PcapWriter(const std::string& base);
+
+	void write_packet(
+		uint16_t link_type,
+		uint32_t channel,
+		uint32_t hw_channel,
+		const light_packet_header& header,
+		const uint8_t* data) override;
+
+	void write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) override;
+
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+
+	void flush() override;
+
+	// Writes the channel list and closes all files, throws std::runtime_error on I/O errors
+	void close();
+
+private:
+	struct link_output {
+		std::string path;
+		std::ofstream pcap;
+		std::ofstream interface_ids;
+	};
+	struct interface_info {
+		uint16_t id;
+		uint16_t link_type;
+		uint32_t channel;
+		uint32_t hw_channel;
+		std::string name;
+		uint64_t packets;
+	};
+
+	std::string base;
+	std::vector<pcapng_exporter::channel_mapping> mappings;
+	std::map<uint16_t, std::unique_ptr<link_output>> outputs;
+	std::unordered_map<uint64_t, uint16_t> interface_ids;
+	std::vector<interface_info> interfaces;
+
+	link_output& find_output(uint16_t link_type);
+	interface_info& find_interface(uint16_t link_type, uint32_t channel, uint32_t hw_channel);
+};
+
+}
+
+#endif
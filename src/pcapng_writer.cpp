@@ -0,0 +1,323 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "pcapng_writer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <pcapng_exporter/linktype.h>
+
+#include "file_writer.hpp"
+
+#define NANOS_PER_SEC 1000000000
+
+// https://www.ietf.org/archive/id/draft-ietf-opsawg-pcapng-01.html
+#define BLOCK_TYPE_SHB 0x0A0D0D0A
+#define BLOCK_TYPE_IDB 0x00000001
+#define BLOCK_TYPE_ISB 0x00000005
+#define BLOCK_TYPE_EPB 0x00000006
+
+#define BYTE_ORDER_MAGIC 0x1A2B3C4D
+
+#define OPT_ENDOFOPT 0
+#define OPT_SHB_USERAPPL 4
+#define OPT_IF_NAME 2
+#define OPT_IF_TSRESOL 9
+#define OPT_EPB_FLAGS 2
+#define OPT_ISB_STARTTIME 2
+#define OPT_ISB_ENDTIME 3
+#define OPT_ISB_IFRECV 4
+#define OPT_ISB_IFDROP 5
+
+#define EPB_FLAGS_DIRECTION_MASK 0x3
+#define EPB_FLAGS_INBOUND 0x1
+#define EPB_FLAGS_OUTBOUND 0x2
+
+#define PAD4(x) (((x) + 3) & ~(size_t)3)
+
+namespace blf_converter {
+
+static uint8_t* put(uint8_t* p, const void* value, size_t length) {
+	if (length) {
+		memcpy(p, value, length);
+	}
+	return p + length;
+}
+
+static uint8_t* put_u16(uint8_t* p, uint16_t value) {
+	return put(p, &value, sizeof(value));
+}
+
+static uint8_t* put_u32(uint8_t* p, uint32_t value) {
+	return put(p, &value, sizeof(value));
+}
+
+static uint8_t* put_option(uint8_t* p, uint16_t code, const void* value, size_t length) {
+	p = put_u16(p, code);
+	p = put_u16(p, (uint16_t)length);
+	p = put(p, value, length);
+	memset(p, 0, PAD4(length) - length);
+	return p + PAD4(length) - length;
+}
+
+// Timestamps are written as high and low 32 bits, also in options
+static uint8_t* put_timestamp_option(uint8_t* p, uint16_t code, uint64_t ts) {
+	uint32_t value[2] = { (uint32_t)(ts >> 32), (uint32_t)ts };
+	return put_option(p, code, value, sizeof(value));
+}
+
+static void write_u64_le(std::ostream& out, uint64_t value) {
+	uint8_t bytes[8];
+	for (int i = 0; i < 8; i++) {
+		bytes[i] = (uint8_t)(value >> (8 * i));
+	}
+	out.write((const char*)bytes, sizeof(bytes));
+}
+
+void write_seek_index(std::ostream& out, const std::vector<index_entry>& entries) {
+	out.write("PCAPNGIX", 8);
+	write_u64_le(out, entries.size());
+	for (const auto& entry : entries) {
+		write_u64_le(out, entry.timestamp_ns);
+		write_u64_le(out, entry.offset);
+	}
+}
+
+PcapngWriter::PcapngWriter(block_callback on_blocks, size_t chunk_size)
+	: on_blocks(std::move(on_blocks)), chunk_size(chunk_size)
+{
+	buffer.reserve(chunk_size + 0x10000);
+}
+
+PcapngWriter::PcapngWriter(AsyncFileWriter& file)
+	: chunk_size(0), file(&file)
+{
+}
+
+uint8_t* PcapngWriter::begin_block(uint32_t type, size_t body_length) {
+	uint32_t total_length = (uint32_t)(body_length + 12);
+	uint8_t* p;
+	if (file) {
+		p = file->append(total_length);
+		emitted += total_length;
+	}
+	else {
+		size_t offset = buffer.size();
+		buffer.resize(offset + total_length);
+		p = buffer.data() + offset;
+	}
+	put_u32(p + total_length - 4, total_length);
+	p = put_u32(p, type);
+	return put_u32(p, total_length);
+}
+
+void PcapngWriter::write_section_header() {
+	static const char application[] = "blf_converter";
+	size_t body_length = 16 + 4 + PAD4(sizeof(application) - 1) + 4;
+	uint8_t* p = begin_block(BLOCK_TYPE_SHB, body_length);
+	p = put_u32(p, BYTE_ORDER_MAGIC);
+	p = put_u16(p, 1);
+	p = put_u16(p, 0);
+	int64_t section_length = -1;
+	p = put(p, &section_length, sizeof(section_length));
+	p = put_option(p, OPT_SHB_USERAPPL, application, sizeof(application) - 1);
+	put_option(p, OPT_ENDOFOPT, nullptr, 0);
+	section_started = true;
+}
+
+void PcapngWriter::write_interface(uint16_t link_type, const std::string& name) {
+	uint8_t tsresol = 9;
+	size_t body_length = 8 + 4 + PAD4(name.size()) + 4 + 4 + 4;
+	uint8_t* p = begin_block(BLOCK_TYPE_IDB, body_length);
+	p = put_u16(p, link_type);
+	p = put_u16(p, 0);
+	p = put_u32(p, 0);
+	p = put_option(p, OPT_IF_NAME, name.data(), name.size());
+	p = put_option(p, OPT_IF_TSRESOL, &tsresol, 1);
+	put_option(p, OPT_ENDOFOPT, nullptr, 0);
+}
+
+PcapngWriter::interface_info& PcapngWriter::find_interface(uint16_t link_type, uint32_t channel, uint32_t hw_channel) {
+	uint32_t channel_id = 100000 * hw_channel + channel;
+	uint64_t key = (uint64_t)link_type << 32 | channel_id;
+	auto it = interfaces.find(key);
+	if (it != interfaces.end()) {
+		return it->second;
+	}
+	if (!section_started) {
+		write_section_header();
+	}
+
+	interface_info info;
+	info.id = (uint32_t)interfaces.size();
+	std::optional<std::string> name;
+	for (const auto& mapping : mappings) {
+		if (mapping.when.chl_id && mapping.when.chl_id.value() != channel_id) continue;
+		if (mapping.when.chl_link && mapping.when.chl_link.value() != link_type) continue;
+		if (!name && mapping.change.inf_name) name = mapping.change.inf_name;
+		if (!info.direction && mapping.change.pkt_dir) info.direction = mapping.change.pkt_dir;
+	}
+	write_interface(link_type, name ? name.value() : unmapped_interface_name(link_type, channel, hw_channel, !mappings.empty()));
+	return interfaces.emplace(key, info).first->second;
+}
+
+void PcapngWriter::write_packet(
+	uint16_t link_type,
+	uint32_t channel,
+	uint32_t hw_channel,
+	const light_packet_header& header,
+	const uint8_t* data
+) {
+	interface_info& info = find_interface(link_type, channel, hw_channel);
+	uint32_t flags = header.flags;
+	if (info.direction) {
+		flags &= ~EPB_FLAGS_DIRECTION_MASK;
+		flags |= info.direction.value() == pcapng_exporter::packet_direction::Rx ? EPB_FLAGS_INBOUND : EPB_FLAGS_OUTBOUND;
+	}
+
+	uint64_t ts = (uint64_t)header.timestamp.tv_sec * NANOS_PER_SEC + (uint64_t)header.timestamp.tv_nsec;
+	if (info.packets++ == 0) {
+		info.first_ns = ts;
+	}
+	info.last_ns = ts;
+	if (indexing) {
+		packets_since_entry++;
+		if (index_entries.empty()
+			|| packets_since_entry >= index_packets
+			|| (ts >= index_entries.back().timestamp_ns && ts - index_entries.back().timestamp_ns >= index_interval_ns)) {
+			index_entries.push_back({ ts, emitted + buffer.size() });
+			packets_since_entry = 0;
+		}
+	}
+
+	size_t options_length = flags ? 8 + 4 : 0;
+	size_t body_length = 20 + PAD4(header.captured_length) + options_length;
+	uint8_t* p = begin_block(BLOCK_TYPE_EPB, body_length);
+	p = put_u32(p, info.id);
+	p = put_u32(p, (uint32_t)(ts >> 32));
+	p = put_u32(p, (uint32_t)ts);
+	p = put_u32(p, header.captured_length);
+	p = put_u32(p, header.original_length);
+	p = put(p, data, header.captured_length);
+	size_t padding = PAD4(header.captured_length) - header.captured_length;
+	memset(p, 0, padding);
+	p += padding;
+	if (flags) {
+		p = put_option(p, OPT_EPB_FLAGS, &flags, sizeof(flags));
+		put_option(p, OPT_ENDOFOPT, nullptr, 0);
+	}
+
+	if (!file && buffer.size() >= chunk_size) {
+		emit();
+	}
+}
+
+void PcapngWriter::write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) {
+	uint8_t data[LIN_FRAME_MAX_SIZE];
+	light_packet_header lin_header = { 0 };
+	lin_header.timestamp = header.timestamp;
+	lin_header.captured_length = (uint32_t)encode_lin_frame(frame, data);
+	lin_header.original_length = lin_header.captured_length;
+	write_packet(LINKTYPE_LIN, header.channel_id, 0, lin_header, data);
+}
+
+void PcapngWriter::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	mappings.push_back(mapping);
+	// Named channels get their interface right away, so that mappings known
+	// before the first packet put all their IDBs at the start of the file
+	if (mapping.when.chl_id && mapping.when.chl_link && mapping.change.inf_name) {
+		uint32_t channel_id = mapping.when.chl_id.value();
+		find_interface(mapping.when.chl_link.value(), channel_id % 100000, channel_id / 100000);
+	}
+}
+
+void PcapngWriter::set_index_interval(uint32_t packets, uint64_t interval_ns) {
+	indexing = true;
+	index_packets = packets ? packets : UINT32_MAX;
+	index_interval_ns = interval_ns ? interval_ns : UINT64_MAX;
+}
+
+void PcapngWriter::set_interface_statistics(const interface_counts* received) {
+	interface_statistics = true;
+	this->received = received;
+}
+
+void PcapngWriter::write_interface_statistics() {
+	if (received) {
+		// Interfaces whose frames were all dropped, in a stable order
+		std::vector<uint64_t> keys;
+		for (const auto& count : *received) {
+			keys.push_back(count.first);
+		}
+		std::sort(keys.begin(), keys.end());
+		for (uint64_t key : keys) {
+			uint32_t channel_id = (uint32_t)key;
+			find_interface((uint16_t)(key >> 32), channel_id % 100000, channel_id / 100000);
+		}
+	}
+
+	// In IDB order, all taken at the time of the last packet
+	std::vector<std::pair<uint64_t, const interface_info*>> sorted;
+	uint64_t end_ns = 0;
+	for (const auto& entry : interfaces) {
+		sorted.emplace_back(entry.first, &entry.second);
+		end_ns = std::max(end_ns, entry.second.last_ns);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) {
+		return a.second->id < b.second->id;
+	});
+
+	for (const auto& entry : sorted) {
+		const interface_info& info = *entry.second;
+		size_t body_length = 12 + 12 + 4;
+		if (info.packets) {
+			body_length += 2 * 12;
+		}
+		if (received) {
+			body_length += 12;
+		}
+		uint8_t* p = begin_block(BLOCK_TYPE_ISB, body_length);
+		p = put_u32(p, info.id);
+		p = put_u32(p, (uint32_t)(end_ns >> 32));
+		p = put_u32(p, (uint32_t)end_ns);
+		if (info.packets) {
+			p = put_timestamp_option(p, OPT_ISB_STARTTIME, info.first_ns);
+			p = put_timestamp_option(p, OPT_ISB_ENDTIME, info.last_ns);
+		}
+		uint64_t recv = info.packets;
+		if (received) {
+			auto it = received->find(entry.first);
+			recv = std::max(recv, it == received->end() ? 0 : it->second);
+		}
+		p = put_option(p, OPT_ISB_IFRECV, &recv, sizeof(recv));
+		if (received) {
+			uint64_t drop = recv - info.packets;
+			p = put_option(p, OPT_ISB_IFDROP, &drop, sizeof(drop));
+		}
+		put_option(p, OPT_ENDOFOPT, nullptr, 0);
+	}
+}
+
+void PcapngWriter::emit() {
+	if (!buffer.empty()) {
+		on_blocks(buffer.data(), buffer.size());
+		emitted += buffer.size();
+		buffer.clear();
+	}
+}
+
+void PcapngWriter::flush() {
+	if (!section_started) {
+		write_section_header();
+	}
+	if (interface_statistics) {
+		write_interface_statistics();
+		interface_statistics = false;
+	}
+	emit();
+}
+
+}
@@ -0,0 +1,112 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_PCAPNG_WRITER_H
+#define _APP_PCAPNG_WRITER_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sink.hpp"
+
+namespace blf_converter {
+
+class AsyncFileWriter;
+
+// Entry of the seek index, offset is the file position of an EPB
+struct index_entry {
+	uint64_t timestamp_ns;
+	uint64_t offset;
+};
+
+// Writes the seek index file: the 8 byte magic "PCAPNGIX", the number of
+// entries as uint64 and the entries (timestamp_ns, offset) as pairs of uint64,
+// all little endian. Entries are in file order.
+void write_seek_index(std::ostream& out, const std::vector<index_entry>& entries);
+
+// Encodes frames as PCAPNG blocks (SHB, IDB, EPB) without going through a file.
+// Blocks are collected and handed to the callback in chunks of about chunk_size bytes,
+// or encoded in place into the buffers of an AsyncFileWriter.
+class PcapngWriter : public PacketSink {
+public:
+	using block_callback = std::function<void(const uint8_t* data, size_t length)>;
+
+	explicit PcapngWriter(block_callback on_blocks, size_t chunk_size = 1 << 20);
+	// file must outlive the writer
+	explicit PcapngWriter(AsyncFileWriter& file);
+
+	void write_packet(
+		uint16_t link_type,
+		uint32_t channel,
+		uint32_t hw_channel,
+		const light_packet_header& header,
+		const uint8_t* data) override;
+
+	void write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) override;
+
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+
+	void flush() override;
+
+	// Records an index entry for the first packet and then whenever at least
+	// packets packets or interval_ns nanoseconds passed since the last entry
+	void set_index_interval(uint32_t packets, uint64_t interval_ns);
+	const std::vector<index_entry>& index() const { return index_entries; }
+
+	// Frames per interface, keyed by link type << 32 | 100000 * hw_channel + channel
+	using interface_counts = std::unordered_map<uint64_t, uint64_t>;
+
+	// Ends the section with an Interface Statistics Block per interface, holding
+	// the first and last packet time and the number of packets. With received,
+	// the frames of an interface that were not written count as dropped, and
+	// interfaces without any written packet get their IDB there.
+	// received must stay valid until the writer is flushed.
+	void set_interface_statistics(const interface_counts* received = nullptr);
+
+private:
+	block_callback on_blocks;
+	size_t chunk_size;
+	std::vector<uint8_t> buffer;
+	AsyncFileWriter* file = nullptr;
+
+	std::vector<pcapng_exporter::channel_mapping> mappings;
+	struct interface_info {
+		uint32_t id;
+		std::optional<pcapng_exporter::packet_direction> direction;
+		uint64_t packets = 0;
+		uint64_t first_ns = 0;
+		uint64_t last_ns = 0;
+	};
+	std::unordered_map<uint64_t, interface_info> interfaces;
+	bool section_started = false;
+	// Bytes handed to the callback or appended to the file
+	uint64_t emitted = 0;
+
+	bool indexing = false;
+	uint32_t index_packets = 0;
+	uint64_t index_interval_ns = 0;
+	uint32_t packets_since_entry = 0;
+	std::vector<index_entry> index_entries;
+
+	bool interface_statistics = false;
+	const interface_counts* received = nullptr;
+
+	interface_info& find_interface(uint16_t link_type, uint32_t channel, uint32_t hw_channel);
+
+	void write_section_header();
+	void write_interface(uint16_t link_type, const std::string& name);
+	void write_interface_statistics();
+
+	uint8_t* begin_block(uint32_t type, size_t body_length);
+	void emit();
+};
+
+}
+
+#endif
@@ -0,0 +1,126 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "reorder.hpp"
+
+#include <algorithm>
+
+#define NANOS_PER_SEC 1000000000
+
+namespace blf_converter {
+
+static uint64_t to_nanos(const struct timespec& ts) {
+	return (uint64_t)ts.tv_sec * NANOS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+ReorderSink::ReorderSink(PacketSink& next, uint64_t window_ns, size_t max_pending, uint64_t max_bytes)
+	: next(next), window_ns(window_ns), max_pending(std::max((size_t)1, max_pending)), max_bytes(max_bytes)
+{
+	heap.reserve(std::min(this->max_pending, (size_t)65536));
+}
+
+bool ReorderSink::is_straggler(uint64_t ts) {
+	if (released_any && ts < released_ts) {
+		straggler_count++;
+		return true;
+	}
+	return false;
+}
+
+void ReorderSink::write_packet(
+	uint16_t link_type,
+	uint32_t channel,
+	uint32_t hw_channel,
+	const light_packet_header& header,
+	const uint8_t* data
+) {
+	uint64_t ts = to_nanos(header.timestamp);
+	if (is_straggler(ts)) {
+		next.write_packet(link_type, channel, hw_channel, header, data);
+		return;
+	}
+
+	pending_frame frame = {};
+	frame.ts = ts;
+	frame.is_lin = false;
+	frame.link_type = link_type;
+	frame.channel = channel;
+	frame.hw_channel = hw_channel;
+	frame.header = header;
+	if (!spare_buffers.empty()) {
+		frame.data = std::move(spare_buffers.back());
+		spare_buffers.pop_back();
+	}
+	frame.data.assign(data, data + header.captured_length);
+	push(std::move(frame));
+}
+
+void ReorderSink::write_lin(const pcapng_exporter::frame_header& header, const lin_frame& lin) {
+	uint64_t ts = to_nanos(header.timestamp);
+	if (is_straggler(ts)) {
+		next.write_lin(header, lin);
+		return;
+	}
+
+	pending_frame frame = {};
+	frame.ts = ts;
+	frame.is_lin = true;
+	frame.lin_header = header;
+	frame.lin = lin;
+	push(std::move(frame));
+}
+
+void ReorderSink::push(pending_frame&& frame) {
+	frame.seq = seq++;
+	newest_ts = std::max(newest_ts, frame.ts);
+	pending_bytes += frame.data.size();
+	heap.push_back(std::move(frame));
+	std::push_heap(heap.begin(), heap.end(), later());
+	release_expired();
+}
+
+void ReorderSink::release(const pending_frame& frame) {
+	if (frame.is_lin) {
+		next.write_lin(frame.lin_header, frame.lin);
+	}
+	else {
+		next.write_packet(frame.link_type, frame.channel, frame.hw_channel, frame.header, frame.data.data());
+	}
+	released_ts = std::max(released_ts, frame.ts);
+	released_any = true;
+}
+
+void ReorderSink::release_expired() {
+	while (!heap.empty()) {
+		const pending_frame& oldest = heap.front();
+		bool expired = oldest.ts + window_ns < newest_ts;
+		if (!expired && heap.size() <= max_pending && pending_bytes <= max_bytes) {
+			break;
+		}
+		std::pop_heap(heap.begin(), heap.end(), later());
+		release(heap.back());
+		pending_bytes -= heap.back().data.size();
+		if (!heap.back().is_lin) {
+			spare_buffers.push_back(std::move(heap.back().data));
+		}
+		heap.pop_back();
+	}
+}
+
+void ReorderSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	next.add_mapping(mapping);
+}
+
+void ReorderSink::flush() {
+	while (!heap.empty()) {
+		std::pop_heap(heap.begin(), heap.end(), later());
+		release(heap.back());
+		heap.pop_back();
+	}
+	pending_bytes = 0;
+	next.flush();
+}
+
+}
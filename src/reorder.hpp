@@ -0,0 +1,83 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_REORDER_H
+#define _APP_REORDER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "sink.hpp"
+
+namespace blf_converter {
+
+// Holds frames in a min-heap and releases them in timestamp order once they
+// are older than the newest seen frame minus the window, or earlier while more
+// than max_pending frames or max_bytes of payload are held. Frames arriving
+// after a newer frame was already released cannot be placed anymore: they are
+// written immediately and counted as stragglers.
+class ReorderSink : public PacketSink {
+public:
+	ReorderSink(PacketSink& next, uint64_t window_ns, size_t max_pending, uint64_t max_bytes = UINT64_MAX);
+
+	void write_packet(
+		uint16_t link_type,
+		uint32_t channel,
+		uint32_t hw_channel,
+		const light_packet_header& header,
+		const uint8_t* data) override;
+
+	void write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) override;
+
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+
+	void flush() override;
+
+	uint64_t stragglers() const { return straggler_count; }
+
+private:
+	struct pending_frame {
+		uint64_t ts;
+		uint64_t seq;
+		bool is_lin;
+		uint16_t link_type;
+		uint32_t channel;
+		uint32_t hw_channel;
+		light_packet_header header;
+		pcapng_exporter::frame_header lin_header;
+		lin_frame lin;
+		std::vector<uint8_t> data;
+	};
+
+	struct later {
+		bool operator()(const pending_frame& a, const pending_frame& b) const {
+			return a.ts != b.ts ? a.ts > b.ts : a.seq > b.seq;
+		}
+	};
+
+	PacketSink& next;
+	uint64_t window_ns;
+	size_t max_pending;
+	uint64_t max_bytes;
+	// Payload bytes of the held frames
+	uint64_t pending_bytes = 0;
+
+	std::vector<pending_frame> heap;
+	// Payload buffers of released frames, reused to avoid an allocation per frame
+	std::vector<std::vector<uint8_t>> spare_buffers;
+	uint64_t seq = 0;
+	uint64_t newest_ts = 0;
+	uint64_t released_ts = 0;
+	bool released_any = false;
+	uint64_t straggler_count = 0;
+
+	bool is_straggler(uint64_t ts);
+	void push(pending_frame&& frame);
+	void release(const pending_frame& frame);
+	void release_expired();
+};
+
+}
+
+#endif
@@ -0,0 +1,165 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "sequence.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <stdexcept>
+
+#include "blf_format.hpp"
+
+// Raw bytes of the next file read ahead, their complete log containers are inflated
+#define PREFETCH_SIZE (4 << 20)
+#define READ_CHUNK_SIZE (1 << 20)
+
+namespace fs = std::filesystem;
+
+namespace blf_converter {
+
+std::vector<std::string> find_sequence(const std::string& first) {
+	std::vector<std::string> files = { first };
+
+	fs::path path(first);
+	std::string stem = path.stem().string();
+	size_t end = stem.size();
+	while (end > 0 && !isdigit((unsigned char)stem[end - 1])) {
+		end--;
+	}
+	size_t start = end;
+	while (start > 0 && isdigit((unsigned char)stem[start - 1])) {
+		start--;
+	}
+	if (start == end) {
+		return files;
+	}
+
+	size_t width = end - start;
+	unsigned long long number = std::stoull(stem.substr(start, width));
+	for (;;) {
+		std::string next = std::to_string(++number);
+		if (next.size() < width) {
+			next.insert(0, width - next.size(), '0');
+		}
+		fs::path candidate = path.parent_path() / (stem.substr(0, start) + next + stem.substr(end) + path.extension().string());
+		if (!fs::is_regular_file(candidate)) {
+			return files;
+		}
+		files.push_back(candidate.string());
+	}
+}
+
+// A file opened ahead, with its header and the inflated object stream of its
+// first log containers. The stream continues at a container boundary.
+struct prefetched_file {
+	std::ifstream in;
+	std::vector<uint8_t> header;
+	std::vector<uint8_t> objects;
+};
+
+static prefetched_file prefetch(const std::string& path) {
+	prefetched_file file;
+	file.in.open(path, std::ios_base::in | std::ios_base::binary);
+	if (!file.in.is_open()) {
+		throw std::runtime_error("Unable to open: " + path);
+	}
+
+	std::vector<uint8_t> raw(PREFETCH_SIZE);
+	file.in.read((char*)raw.data(), raw.size());
+	size_t length = (size_t)file.in.gcount();
+	if (length < BLF_FILE_STATISTICS_SIZE || read_le32(raw.data()) != BLF_FILE_SIGNATURE) {
+		throw std::runtime_error("Not a BLF file: " + path);
+	}
+	size_t pos = std::max((size_t)read_le32(raw.data() + 4), (size_t)BLF_FILE_STATISTICS_SIZE);
+	pos = std::min(pos, length);
+	file.header.assign(raw.begin(), raw.begin() + pos);
+
+	std::vector<uint8_t> buffer;
+	while (length - pos >= BLF_OBJECT_HEADER_BASE_SIZE) {
+		object_header_base header = parse_object_header_base(raw.data() + pos);
+		if (header.signature != BLF_OBJECT_SIGNATURE || header.object_size < BLF_OBJECT_HEADER_BASE_SIZE
+			|| length - pos < header.object_size + header.padding()) {
+			// Incomplete or damaged, left to the reader
+			break;
+		}
+		if (header.object_type == (uint32_t)Vector::BLF::ObjectType::LOG_CONTAINER) {
+			size_t payload_length;
+			const uint8_t* payload;
+			try {
+				payload = inflate_log_container(raw.data() + pos, header.object_size, buffer, &payload_length);
+			}
+			catch (std::runtime_error&) {
+				break;
+			}
+			file.objects.insert(file.objects.end(), payload, payload + payload_length);
+		}
+		pos += header.object_size + header.padding();
+	}
+
+	// The reader goes on with the first object not inflated here
+	file.in.clear();
+	file.in.seekg(pos);
+	if (!file.in) {
+		throw std::runtime_error("Unable to read: " + path);
+	}
+	return file;
+}
+
+void convert_sequence(
+	Converter& converter,
+	const std::vector<std::string>& files,
+	std::function<void(const std::string& file, const std::exception& e)> on_error)
+{
+	std::vector<char> chunk(READ_CHUNK_SIZE);
+	bool first_start_known = false;
+	uint64_t first_start_ns = 0;
+	std::future<prefetched_file> next;
+	if (!files.empty()) {
+		next = std::async(std::launch::async, prefetch, files[0]);
+	}
+
+	for (size_t i = 0; i < files.size(); i++) {
+		try {
+			prefetched_file file = next.get();
+			if (i + 1 < files.size()) {
+				next = std::async(std::launch::async, prefetch, files[i + 1]);
+			}
+
+			converter.begin_file();
+			converter.push(file.header.data(), file.header.size());
+			// Timestamps of all files count from the start of the first one, a
+			// file started later probably counts from its own start
+			if (converter.reader().has_statistics()) {
+				uint64_t start_ns = calculate_startdate(converter.reader().statistics());
+				if (!first_start_known) {
+					first_start_known = true;
+					first_start_ns = start_ns;
+				}
+				else if (start_ns != first_start_ns) {
+					on_error(files[i], std::runtime_error("Measurement start differs from the first file, its timestamps are taken as counting from the start of the first file"));
+				}
+			}
+			converter.push_uncompressed(file.objects.data(), file.objects.size());
+			file.objects = std::vector<uint8_t>();
+			while (file.in) {
+				file.in.read(chunk.data(), chunk.size());
+				converter.push((const uint8_t*)chunk.data(), (size_t)file.in.gcount());
+			}
+			converter.end_file();
+		}
+		catch (std::runtime_error& e) {
+			on_error(files[i], e);
+			if (i + 1 < files.size() && !next.valid()) {
+				next = std::async(std::launch::async, prefetch, files[i + 1]);
+			}
+		}
+	}
+	converter.finish();
+}
+
+}
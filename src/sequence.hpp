@@ -0,0 +1,35 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_SEQUENCE_H
+#define _APP_SEQUENCE_H
+
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "converter.hpp"
+
+namespace blf_converter {
+
+// Files of a split recording starting with first, found by counting up the last
+// number of the file name with the same width (drive_001.blf, drive_002.blf, ...)
+// until a file is missing
+std::vector<std::string> find_sequence(const std::string& first);
+
+// Converts the files of a split recording as one stream and finishes the
+// converter. While a file is converted, the next one is opened and its first log
+// containers are inflated by a background thread. Errors in one file are passed
+// to on_error and the conversion goes on with the next file. A file whose
+// measurement start differs from the first file is passed to on_error as well,
+// but still converted.
+void convert_sequence(
+	Converter& converter,
+	const std::vector<std::string>& files,
+	std::function<void(const std::string& file, const std::exception& e)> on_error);
+
+}
+
+#endif
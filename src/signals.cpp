@@ -0,0 +1,185 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "signals.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <pcapng_exporter/linktype.h>
+
+#include "byte_order.hpp"
+#include "sink.hpp"
+
+#define SIGNALS_VERSION 1
+
+#define PAD4(x) (((x) + 3) & ~(size_t)3)
+#define PAD8(x) (((x) + 7) & ~(size_t)7)
+
+namespace blf_converter {
+
+SignalSink::SignalSink(ObjectSink& next, block_callback on_blocks, size_t batch_rows)
+	: next(next), on_blocks(std::move(on_blocks)), batch_rows(batch_rows)
+{
+}
+
+void SignalSink::add_database(const std::string& selector, std::shared_ptr<const dbc_database> database) {
+	databases.emplace_back(selector, std::move(database));
+	channels.clear();
+}
+
+void SignalSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	mappings.push_back(mapping);
+	// Interface names may have changed
+	channels.clear();
+	next.add_mapping(mapping);
+}
+
+SignalSink::channel_decoder& SignalSink::find_channel(const frame_view& view) {
+	uint32_t channel_id = 100000 * view.hw_channel + view.channel;
+	auto it = channels.find(channel_id);
+	if (it != channels.end()) {
+		return it->second;
+	}
+
+	std::string name = unmapped_interface_name(view.link_type, view.channel, view.hw_channel, !mappings.empty());
+	for (const auto& mapping : mappings) {
+		if (mapping.when.chl_id && mapping.when.chl_id.value() != channel_id) continue;
+		if (mapping.when.chl_link && mapping.when.chl_link.value() != view.link_type) continue;
+		if (mapping.change.inf_name) {
+			name = mapping.change.inf_name.value();
+			break;
+		}
+	}
+
+	channel_decoder& channel = channels[channel_id];
+	for (const auto& database : databases) {
+		const std::string& selector = database.first;
+		if (selector.empty() || selector == name || selector == std::to_string(view.channel)) {
+			channel.databases.push_back(database.second.get());
+		}
+	}
+	return channel;
+}
+
+std::vector<SignalSink::message_decoder>& SignalSink::find_messages(channel_decoder& channel, uint32_t channel_id, uint32_t id) {
+	auto it = channel.messages.find(id);
+	if (it != channel.messages.end()) {
+		return it->second;
+	}
+	// Also remembers ids without any message
+	std::vector<message_decoder>& decoders = channel.messages[id];
+	for (const dbc_database* database : channel.databases) {
+		auto message = database->messages.find(id);
+		if (message != database->messages.end()) {
+			message_decoder decoder;
+			decoder.message = &message->second;
+			for (const auto& signal : message->second.signals) {
+				auto known = series_ids.find({ channel_id, &signal });
+				decoder.series.push_back(known != series_ids.end() ? known->second : UINT32_MAX);
+			}
+			decoders.push_back(std::move(decoder));
+		}
+	}
+	return decoders;
+}
+
+uint32_t SignalSink::declare(uint32_t channel_id, const dbc_message& message, const dbc_signal& signal) {
+	uint32_t id = (uint32_t)series_ids.size();
+	series_ids.emplace(std::make_pair(channel_id, &signal), id);
+
+	std::string name = message.name + "." + signal.name;
+	name.resize(std::min(name.size(), (size_t)UINT16_MAX));
+	std::string unit = signal.unit.substr(0, UINT16_MAX);
+	put_le(declarations, id);
+	put_le(declarations, channel_id);
+	put_le(declarations, message.id);
+	put_le(declarations, (uint16_t)name.size());
+	put_le(declarations, (uint16_t)unit.size());
+	declarations.insert(declarations.end(), name.begin(), name.end());
+	declarations.insert(declarations.end(), unit.begin(), unit.end());
+	declarations.resize(PAD4(declarations.size()), 0);
+	declaration_count++;
+	return id;
+}
+
+void SignalSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (!databases.empty() && make_frame_view(ohb, date_offset_ns, &view)
+		&& view.link_type == LINKTYPE_CAN && !(view.flags & (FRAME_FLAG_ERROR | FRAME_FLAG_RTR))) {
+		uint32_t channel_id = 100000 * view.hw_channel + view.channel;
+		channel_decoder& channel = find_channel(view);
+		uint32_t id = view.id | (view.flags & FRAME_FLAG_EXT ? DBC_EXTENDED_ID : 0);
+		for (auto& decoder : find_messages(channel, channel_id, id)) {
+			decode_signals(*decoder.message, view.data, view.data_length, [&](size_t signal, double value) {
+				uint32_t& index = decoder.series[signal];
+				if (index == UINT32_MAX) {
+					index = declare(channel_id, *decoder.message, decoder.message->signals[signal]);
+				}
+				timestamps.push_back(view.timestamp_ns);
+				series.push_back(index);
+				values.push_back(value);
+			});
+		}
+		if (timestamps.size() >= batch_rows) {
+			write_batch();
+		}
+	}
+	next.write_object(ohb, date_offset_ns);
+}
+
+template<class T>
+static void put_column(std::vector<uint8_t>& out, const std::vector<T>& column) {
+	size_t length = column.size() * sizeof(T);
+	size_t offset = out.size();
+	out.resize(offset + PAD8(length), 0);
+	write_le_array(out.data() + offset, column.data(), column.size());
+}
+
+void SignalSink::write_batch() {
+	out.clear();
+	if (!header_written) {
+		out.insert(out.end(), { 'B', 'L', 'F', 'S' });
+		put_le(out, (uint16_t)SIGNALS_VERSION);
+		out.insert(out.end(), 10, 0);
+		header_written = true;
+	}
+
+	if (declaration_count > 0) {
+		put_le(out, (uint32_t)SIGNALS_BLOCK_SERIES);
+		put_le(out, declaration_count);
+		put_le(out, (uint64_t)PAD8(declarations.size()));
+		out.insert(out.end(), declarations.begin(), declarations.end());
+		out.resize(PAD8(out.size()), 0);
+		declarations.clear();
+		declaration_count = 0;
+	}
+
+	uint32_t rows = (uint32_t)timestamps.size();
+	if (rows > 0) {
+		put_le(out, (uint32_t)SIGNALS_BLOCK_SAMPLES);
+		put_le(out, rows);
+		put_le(out, (uint64_t)(PAD8(rows * sizeof(uint64_t)) + PAD8(rows * sizeof(uint32_t)) + PAD8(rows * sizeof(double))));
+		put_column(out, timestamps);
+		put_column(out, series);
+		put_column(out, values);
+		sample_count += rows;
+		timestamps.clear();
+		series.clear();
+		values.clear();
+	}
+
+	if (!out.empty()) {
+		on_blocks(out.data(), out.size());
+	}
+}
+
+void SignalSink::flush() {
+	// Also writes the header of empty outputs
+	write_batch();
+	next.flush();
+}
+
+}
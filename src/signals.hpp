@@ -0,0 +1,102 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_SIGNALS_H
+#define _APP_SIGNALS_H
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "dbc.hpp"
+#include "encoder.hpp"
+#include "frame_view.hpp"
+
+// Signal time series
+//
+// All integers are little endian. The output starts with a 16 byte header:
+//   char[4] magic "BLFS", u16 version (1), u16 reserved, u64 reserved
+// followed by blocks:
+//   u32 block type (SIGNALS_BLOCK_*)
+//   u32 rows
+//   u64 size of the data following this header, in bytes
+// SIGNALS_BLOCK_SERIES declares rows series, each:
+//   u32 series, u32 channel, u32 message id, u16 name length, u16 unit length,
+//   char name[], char unit[], padded to 4 bytes
+// with the name as "Message.Signal" and the DBC_EXTENDED_ID bit set in the ids of
+// extended frames. The block is padded to 8 bytes. Series are numbered from 0 and
+// declared before their first sample.
+// SIGNALS_BLOCK_SAMPLES holds rows samples as columns, each padded to 8 bytes:
+//   u64 timestamp[rows], u32 series[rows], f64 value[rows]
+// timestamp is in nanoseconds since the epoch, channel is 100000 * hardware channel + channel.
+
+#define SIGNALS_BLOCK_SERIES  1
+#define SIGNALS_BLOCK_SAMPLES 2
+
+namespace blf_converter {
+
+// Decodes the signals of CAN frames with DBC files while the objects pass on to
+// the next sink, and writes them as time series.
+class SignalSink : public ObjectSink {
+public:
+	using block_callback = std::function<void(const uint8_t* data, size_t length)>;
+
+	SignalSink(ObjectSink& next, block_callback on_blocks, size_t batch_rows = 65536);
+
+	// Applies the database to the CAN channels selected by an interface name (see
+	// the channel mapping), a BLF channel number or, if empty, to all of them.
+	// Several databases may apply to one channel.
+	void add_database(const std::string& selector, std::shared_ptr<const dbc_database> database);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+	uint64_t samples() const { return sample_count; }
+
+private:
+	// A message of one channel and the series of its signals, UINT32_MAX until declared
+	struct message_decoder {
+		const dbc_message* message;
+		std::vector<uint32_t> series;
+	};
+
+	struct channel_decoder {
+		std::vector<const dbc_database*> databases;
+		std::unordered_map<uint32_t, std::vector<message_decoder>> messages;
+	};
+
+	ObjectSink& next;
+	block_callback on_blocks;
+	size_t batch_rows;
+	bool header_written = false;
+
+	std::vector<std::pair<std::string, std::shared_ptr<const dbc_database>>> databases;
+	std::vector<pcapng_exporter::channel_mapping> mappings;
+	std::unordered_map<uint32_t, channel_decoder> channels;
+	// Series by channel and signal, kept when the channels are resolved again
+	std::map<std::pair<uint32_t, const dbc_signal*>, uint32_t> series_ids;
+
+	std::vector<uint8_t> declarations;
+	uint32_t declaration_count = 0;
+	std::vector<uint64_t> timestamps;
+	std::vector<uint32_t> series;
+	std::vector<double> values;
+	uint64_t sample_count = 0;
+	std::vector<uint8_t> out;
+
+	channel_decoder& find_channel(const frame_view& view);
+	std::vector<message_decoder>& find_messages(channel_decoder& channel, uint32_t channel_id, uint32_t id);
+	uint32_t declare(uint32_t channel_id, const dbc_message& message, const dbc_signal& signal);
+	void write_batch();
+};
+
+}
+
+#endif
@@ -0,0 +1,153 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "sink.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include <pcapng_exporter/linktype.h>
+
+#define NANOS_PER_SEC 1000000000
+
+namespace blf_converter {
+
+static const char* channel_prefix(uint16_t link_type) {
+	switch (link_type)
+	{
+	case LINKTYPE_ETHERNET: return "ETH-";
+	case LINKTYPE_CAN: return "CAN-";
+	case LINKTYPE_LIN: return "LIN-";
+	case LINKTYPE_FLEXRAY: return "FR-";
+	default: return nullptr;
+	}
+}
+
+std::string fallback_interface_name(uint16_t link_type, uint32_t channel, uint32_t hw_channel) {
+	const char* prefix = channel_prefix(link_type);
+	if (hw_channel == 0 && prefix) {
+		return prefix + std::to_string(channel);
+	}
+	return std::to_string(100000 * hw_channel + channel);
+}
+
+std::string unmapped_interface_name(uint16_t link_type, uint32_t channel, uint32_t hw_channel, bool any_mapping) {
+	if (any_mapping) {
+		return std::to_string(100000 * hw_channel + channel);
+	}
+	return fallback_interface_name(link_type, channel, hw_channel);
+}
+
+ExporterSink::ExporterSink(const std::string& file, const std::string& mapping)
+	: exporter(file, mapping)
+{
+}
+
+void ExporterSink::write_packet(
+	uint16_t link_type,
+	uint32_t channel,
+	uint32_t hw_channel,
+	const light_packet_header& header,
+	const uint8_t* data
+) {
+	light_packet_interface interface = { 0 };
+	interface.link_type = link_type;
+	auto channel_id = 100000 * hw_channel + channel;
+
+	// Unifying interface name for Ethernet link_type with Wireshark.
+	// For other link_types updates, refer to `add_interface_name` in https://gitlab.com/wireshark/wireshark/-/blob/44781615b155d3ae125394454cc317af159c218f/wiretap/blf.c
+	if (exporter.mappings.empty() && hw_channel == 0 && channel_prefix(link_type)) {
+		// Needed to take the name as fallback in get_interface_name of mapping.cpp in pcapng_exporter
+		channel_id = 0;
+	}
+	std::string name = unmapped_interface_name(link_type, channel, hw_channel, !exporter.mappings.empty());
+	char name_str[256] = { 0 };
+	memcpy(name_str, name.c_str(), sizeof(char) * std::min((size_t)255, name.length()));
+	interface.name = name_str;
+
+	/* since we convert to NS, we need to always set the output to NS */
+	interface.timestamp_resolution = NANOS_PER_SEC;
+
+	exporter.write_packet(channel_id, interface, header, data);
+}
+
+void ExporterSink::write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) {
+	exporter.write_lin(header, frame);
+}
+
+void ExporterSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	exporter.mappings.push_back(mapping);
+}
+
+CallbackSink::CallbackSink(std::function<void(const packet&)> on_packet)
+	: on_packet(std::move(on_packet))
+{
+}
+
+void CallbackSink::write_packet(
+	uint16_t link_type,
+	uint32_t channel,
+	uint32_t hw_channel,
+	const light_packet_header& header,
+	const uint8_t* data
+) {
+	packet p = { link_type, channel, hw_channel, &header, data };
+	on_packet(p);
+}
+
+void CallbackSink::write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) {
+	uint8_t data[LIN_FRAME_MAX_SIZE];
+	light_packet_header lin_header = { 0 };
+	lin_header.timestamp = header.timestamp;
+	lin_header.captured_length = (uint32_t)encode_lin_frame(frame, data);
+	lin_header.original_length = lin_header.captured_length;
+	write_packet(LINKTYPE_LIN, header.channel_id, 0, lin_header, data);
+}
+
+TracingSink::TracingSink(PacketSink& next, Tracer& tracer)
+	: next(next), tracer(tracer)
+{
+}
+
+void TracingSink::write_packet(
+	uint16_t link_type,
+	uint32_t channel,
+	uint32_t hw_channel,
+	const light_packet_header& header,
+	const uint8_t* data
+) {
+	trace_scope scope(&tracer, TRACE_OUTPUT);
+	next.write_packet(link_type, channel, hw_channel, header, data);
+}
+
+void TracingSink::write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) {
+	trace_scope scope(&tracer, TRACE_OUTPUT);
+	next.write_lin(header, frame);
+}
+
+void TracingSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	next.add_mapping(mapping);
+}
+
+void TracingSink::flush() {
+	next.flush();
+}
+
+size_t encode_lin_frame(const lin_frame& frame, uint8_t* out) {
+	// https://www.tcpdump.org/linktypes/LINKTYPE_LIN.html
+	uint8_t payload_length = std::min<uint8_t>(frame.payload_length, 8);
+	out[0] = 1; // Message format revision
+	out[1] = 0;
+	out[2] = 0;
+	out[3] = 0;
+	out[4] = (uint8_t)(payload_length << 4); // Message type: frame, checksum type: unknown
+	out[5] = frame.pid;
+	out[6] = frame.checksum;
+	out[7] = frame.errors;
+	memcpy(out + 8, frame.data, payload_length);
+	return 8 + (size_t)payload_length;
+}
+
+}
@@ -0,0 +1,125 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_SINK_H
+#define _APP_SINK_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include <light_pcapng_ext.h>
+#include <pcapng_exporter/lin.h>
+#include <pcapng_exporter/pcapng_exporter.hpp>
+
+#include "trace.hpp"
+
+namespace blf_converter {
+
+// Destination of encoded frames, decoupled from the BLF object encoders
+class PacketSink {
+public:
+	virtual ~PacketSink() = default;
+
+	virtual void write_packet(
+		uint16_t link_type,
+		uint32_t channel,
+		uint32_t hw_channel,
+		const light_packet_header& header,
+		const uint8_t* data) = 0;
+
+	virtual void write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) = 0;
+
+	// Channel mapping found in the BLF metadata (AppText objects)
+	virtual void add_mapping(const pcapng_exporter::channel_mapping& mapping) {}
+
+	// Called once all frames have been written
+	virtual void flush() {}
+};
+
+// Writes frames to a PCAPNG file through pcapng_exporter
+class ExporterSink : public PacketSink {
+public:
+	pcapng_exporter::PcapngExporter exporter;
+
+	ExporterSink(const std::string& file, const std::string& mapping);
+
+	void write_packet(
+		uint16_t link_type,
+		uint32_t channel,
+		uint32_t hw_channel,
+		const light_packet_header& header,
+		const uint8_t* data) override;
+
+	void write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) override;
+
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+};
+
+// A frame as handed to CallbackSink, LIN frames are encoded as LINKTYPE_LIN
+struct packet {
+	uint16_t link_type;
+	uint32_t channel;
+	uint32_t hw_channel;
+	const light_packet_header* header;
+	const uint8_t* data;
+};
+
+// Hands every frame to a user callback, for embedding the converter
+class CallbackSink : public PacketSink {
+public:
+	explicit CallbackSink(std::function<void(const packet&)> on_packet);
+
+	void write_packet(
+		uint16_t link_type,
+		uint32_t channel,
+		uint32_t hw_channel,
+		const light_packet_header& header,
+		const uint8_t* data) override;
+
+	void write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) override;
+
+private:
+	std::function<void(const packet&)> on_packet;
+};
+
+// Adds the time spent in the next sink to TRACE_OUTPUT
+class TracingSink : public PacketSink {
+public:
+	TracingSink(PacketSink& next, Tracer& tracer);
+
+	void write_packet(
+		uint16_t link_type,
+		uint32_t channel,
+		uint32_t hw_channel,
+		const light_packet_header& header,
+		const uint8_t* data) override;
+
+	void write_lin(const pcapng_exporter::frame_header& header, const lin_frame& frame) override;
+
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+
+	void flush() override;
+
+private:
+	PacketSink& next;
+	Tracer& tracer;
+};
+
+// Maximum size of an encoded LINKTYPE_LIN frame
+#define LIN_FRAME_MAX_SIZE 16
+
+// Encodes a LIN frame as LINKTYPE_LIN, returns the number of bytes written
+size_t encode_lin_frame(const lin_frame& frame, uint8_t* out);
+
+// Interface name used when no mapping applies, e.g. CAN-1 or ETH-2
+std::string fallback_interface_name(uint16_t link_type, uint32_t channel, uint32_t hw_channel);
+
+// Name of an output interface that no mapping names. Like PcapngExporter, all
+// outputs name channels by their numeric identifier once any mapping exists.
+std::string unmapped_interface_name(uint16_t link_type, uint32_t channel, uint32_t hw_channel, bool any_mapping);
+
+}
+
+#endif
@@ -0,0 +1,237 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "statistics.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include <pcapng_exporter/linktype.h>
+
+#include "json.hpp"
+#include "sink.hpp"
+
+#define NANOS_PER_SEC 1000000000
+
+namespace blf_converter {
+
+StatisticsSink::StatisticsSink(ObjectSink& next)
+	: next(next)
+{
+}
+
+void StatisticsSink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (make_frame_view(ohb, date_offset_ns, &view)) {
+		update(view);
+	}
+	next.write_object(ohb, date_offset_ns);
+}
+
+void StatisticsSink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	mappings.push_back(mapping);
+	next.add_mapping(mapping);
+}
+
+void StatisticsSink::flush() {
+	next.flush();
+}
+
+void StatisticsSink::update(const frame_view& view) {
+	row_type type = ROW_FRAME;
+	if (view.flags & FRAME_FLAG_STATUS) type = ROW_STATUS;
+	else if (view.flags & FRAME_FLAG_ERROR) type = ROW_ERROR;
+	// Identifiers, slots and EtherTypes leave bits 29 and 30 of the key free
+	uint64_t key = view.key() | (uint64_t)type << 29;
+	message_statistics* entry = last_entry;
+	if (!entry || key != last_key) {
+		auto it = table.find(key);
+		if (it == table.end()) {
+			message_statistics created;
+			created.type = type;
+			created.link_type = view.link_type;
+			created.channel = view.channel;
+			created.hw_channel = view.hw_channel;
+			created.id = view.id;
+			created.ext = (view.flags & FRAME_FLAG_EXT) != 0;
+			it = table.emplace(key, created).first;
+		}
+		entry = &it->second;
+		last_key = key;
+		last_entry = entry;
+	}
+
+	uint32_t length = view.header_length + view.data_length;
+	entry->bytes += length;
+	entry->min_length = std::min(entry->min_length, length);
+	entry->max_length = std::max(entry->max_length, length);
+	if (type == ROW_FRAME && (view.link_type == LINKTYPE_CAN || view.link_type == LINKTYPE_LIN)) {
+		entry->dlc_counts[view.dlc & 0xF]++;
+	}
+
+	if (entry->count > 0) {
+		// Objects are not strictly ordered, a negative gap counts as zero
+		uint64_t gap = view.timestamp_ns > entry->last_ns ? view.timestamp_ns - entry->last_ns : 0;
+		entry->min_gap_ns = std::min(entry->min_gap_ns, gap);
+		entry->max_gap_ns = std::max(entry->max_gap_ns, gap);
+		entry->gap_sum += (double)gap;
+		entry->gap_sum_sq += (double)gap * (double)gap;
+	}
+	else {
+		entry->first_ns = view.timestamp_ns;
+	}
+	entry->last_ns = std::max(entry->last_ns, view.timestamp_ns);
+	entry->count++;
+}
+
+std::vector<const StatisticsSink::message_statistics*> StatisticsSink::sorted() const {
+	std::vector<const message_statistics*> entries;
+	entries.reserve(table.size());
+	for (const auto& item : table) {
+		entries.push_back(&item.second);
+	}
+	std::sort(entries.begin(), entries.end(), [](const message_statistics* a, const message_statistics* b) {
+		if (a->link_type != b->link_type) return a->link_type < b->link_type;
+		if (a->hw_channel != b->hw_channel) return a->hw_channel < b->hw_channel;
+		if (a->channel != b->channel) return a->channel < b->channel;
+		if (a->type != b->type) return a->type < b->type;
+		if (a->ext != b->ext) return b->ext;
+		return a->id < b->id;
+	});
+	return entries;
+}
+
+std::string StatisticsSink::interface_name(const message_statistics& entry) const {
+	uint32_t channel_id = 100000 * entry.hw_channel + entry.channel;
+	for (const auto& mapping : mappings) {
+		if (mapping.when.chl_id && mapping.when.chl_id.value() != channel_id) continue;
+		if (mapping.when.chl_link && mapping.when.chl_link.value() != entry.link_type) continue;
+		if (mapping.change.inf_name) return mapping.change.inf_name.value();
+	}
+	return unmapped_interface_name(entry.link_type, entry.channel, entry.hw_channel, !mappings.empty());
+}
+
+const char* StatisticsSink::type_name(row_type type) {
+	switch (type) {
+	case ROW_ERROR: return "error";
+	case ROW_STATUS: return "status";
+	default: return "frame";
+	}
+}
+
+static const char* bus_name(uint16_t link_type) {
+	switch (link_type) {
+	case LINKTYPE_CAN: return "CAN";
+	case LINKTYPE_LIN: return "LIN";
+	case LINKTYPE_ETHERNET: return "Ethernet";
+	case LINKTYPE_FLEXRAY: return "FlexRay";
+	default: return "Unknown";
+	}
+}
+
+// Derived values shared by both report formats
+struct derived_statistics {
+	std::string rate;
+	uint64_t mean_gap_ns;
+	uint64_t jitter_ns;
+};
+
+template<class Entry>
+static derived_statistics derive(const Entry& entry) {
+	derived_statistics result = { "0", 0, 0 };
+	uint64_t gaps = entry.count - 1;
+	if (gaps > 0) {
+		double mean = entry.gap_sum / gaps;
+		double variance = entry.gap_sum_sq / gaps - mean * mean;
+		result.mean_gap_ns = (uint64_t)std::llround(mean);
+		result.jitter_ns = variance > 0 ? (uint64_t)std::llround(std::sqrt(variance)) : 0;
+	}
+	if (entry.last_ns > entry.first_ns) {
+		char rate[32];
+		snprintf(rate, sizeof(rate), "%.3f", (double)gaps * NANOS_PER_SEC / (double)(entry.last_ns - entry.first_ns));
+		result.rate = rate;
+	}
+	return result;
+}
+
+void StatisticsSink::write_json(std::ostream& out) const {
+	out << "{\n  \"messages\": [";
+	bool first = true;
+	for (const message_statistics* entry : sorted()) {
+		derived_statistics d = derive(*entry);
+		out << (first ? "\n" : ",\n");
+		first = false;
+		out << "    {\"bus\": \"" << bus_name(entry->link_type) << "\"";
+		out << ", \"type\": \"" << type_name(entry->type) << "\"";
+		out << ", \"interface\": " << json_quote(interface_name(*entry));
+		out << ", \"channel\": " << 100000 * entry->hw_channel + entry->channel;
+		out << ", \"id\": " << entry->id;
+		if (entry->link_type == LINKTYPE_CAN) {
+			out << ", \"extended\": " << (entry->ext ? "true" : "false");
+		}
+		out << ", \"count\": " << entry->count;
+		out << ", \"bytes\": " << entry->bytes;
+		out << ", \"min_length\": " << entry->min_length;
+		out << ", \"max_length\": " << entry->max_length;
+		out << ", \"first_ns\": " << entry->first_ns;
+		out << ", \"last_ns\": " << entry->last_ns;
+		out << ", \"rate_hz\": " << d.rate;
+		if (entry->count > 1) {
+			out << ", \"min_cycle_ns\": " << entry->min_gap_ns;
+			out << ", \"max_cycle_ns\": " << entry->max_gap_ns;
+			out << ", \"mean_cycle_ns\": " << d.mean_gap_ns;
+			out << ", \"jitter_ns\": " << d.jitter_ns;
+		}
+		if (entry->type == ROW_FRAME && (entry->link_type == LINKTYPE_CAN || entry->link_type == LINKTYPE_LIN)) {
+			out << ", \"dlc\": {";
+			bool first_dlc = true;
+			for (int dlc = 0; dlc < 16; dlc++) {
+				if (entry->dlc_counts[dlc] == 0) continue;
+				out << (first_dlc ? "" : ", ") << "\"" << dlc << "\": " << entry->dlc_counts[dlc];
+				first_dlc = false;
+			}
+			out << "}";
+		}
+		out << "}";
+	}
+	out << "\n  ]\n}\n";
+}
+
+void StatisticsSink::write_csv(std::ostream& out) const {
+	out << "bus,type,interface,channel,id,extended,count,bytes,min_length,max_length,first_ns,last_ns,"
+		"rate_hz,min_cycle_ns,max_cycle_ns,mean_cycle_ns,jitter_ns";
+	for (int dlc = 0; dlc < 16; dlc++) {
+		out << ",dlc" << dlc;
+	}
+	out << "\n";
+	for (const message_statistics* entry : sorted()) {
+		derived_statistics d = derive(*entry);
+		std::string name = interface_name(*entry);
+		if (name.find_first_of(",\"\n") != std::string::npos) {
+			std::string quoted = "\"";
+			for (char c : name) {
+				quoted += c == '"' ? "\"\"" : std::string(1, c);
+			}
+			name = quoted + "\"";
+		}
+		out << bus_name(entry->link_type) << "," << type_name(entry->type) << "," << name << "," << 100000 * entry->hw_channel + entry->channel << ","
+			<< entry->id << "," << (entry->ext ? 1 : 0) << "," << entry->count << ","
+			<< entry->bytes << "," << entry->min_length << "," << entry->max_length << ","
+			<< entry->first_ns << "," << entry->last_ns << "," << d.rate << ",";
+		if (entry->count > 1) {
+			out << entry->min_gap_ns << "," << entry->max_gap_ns << "," << d.mean_gap_ns << "," << d.jitter_ns;
+		}
+		else {
+			out << ",,,";
+		}
+		for (int dlc = 0; dlc < 16; dlc++) {
+			out << "," << entry->dlc_counts[dlc];
+		}
+		out << "\n";
+	}
+}
+
+}
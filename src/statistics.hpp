@@ -0,0 +1,81 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_STATISTICS_H
+#define _APP_STATISTICS_H
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "encoder.hpp"
+#include "frame_view.hpp"
+
+namespace blf_converter {
+
+// Aggregates traffic per message (interface and CAN / LIN identifier, FlexRay
+// slot or EtherType) while the objects pass on to the next sink. Error frames
+// and FlexRay status events get rows of their own, so that they do not count
+// as frames of the identifier or slot they carry.
+class StatisticsSink : public ObjectSink {
+public:
+	explicit StatisticsSink(ObjectSink& next);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+	size_t messages() const { return table.size(); }
+
+	void write_json(std::ostream& out) const;
+	void write_csv(std::ostream& out) const;
+
+private:
+	enum row_type : uint8_t {
+		ROW_FRAME,
+		ROW_ERROR,
+		ROW_STATUS
+	};
+
+	struct message_statistics {
+		row_type type;
+		uint16_t link_type;
+		uint32_t channel;
+		uint32_t hw_channel;
+		uint32_t id;
+		bool ext;
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+		uint32_t min_length = UINT32_MAX;
+		uint32_t max_length = 0;
+		uint64_t first_ns = 0;
+		uint64_t last_ns = 0;
+		// Cycle time, i.e. the gap between consecutive frames
+		uint64_t min_gap_ns = UINT64_MAX;
+		uint64_t max_gap_ns = 0;
+		double gap_sum = 0;
+		double gap_sum_sq = 0;
+		// CAN / LIN frames only
+		uint32_t dlc_counts[16] = {};
+	};
+
+	ObjectSink& next;
+	std::unordered_map<uint64_t, message_statistics> table;
+	std::vector<pcapng_exporter::channel_mapping> mappings;
+
+	// Consecutive frames often have the same id
+	uint64_t last_key = 0;
+	message_statistics* last_entry = nullptr;
+
+	void update(const frame_view& view);
+	std::vector<const message_statistics*> sorted() const;
+	std::string interface_name(const message_statistics& entry) const;
+	static const char* type_name(row_type type);
+};
+
+}
+
+#endif
@@ -0,0 +1,216 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "summary.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+#define SUMMARY_FILTER_HASHES 3
+
+namespace blf_converter {
+
+// splitmix64 finalizer, both halves give the double hashing of the Bloom filter
+static uint64_t mix(uint64_t x) {
+	x += 0x9E3779B97F4A7C15ull;
+	x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+	x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+	return x ^ (x >> 31);
+}
+
+void id_filter::add(uint32_t id) {
+	uint64_t hash = mix(id);
+	uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+	for (uint32_t i = 0; i < SUMMARY_FILTER_HASHES; i++) {
+		uint32_t bit = (h1 + i * h2) % SUMMARY_FILTER_BITS;
+		bits[bit / 8] |= (uint8_t)(1 << (bit % 8));
+	}
+}
+
+bool id_filter::may_contain(uint32_t id) const {
+	uint64_t hash = mix(id);
+	uint32_t h1 = (uint32_t)hash, h2 = (uint32_t)(hash >> 32) | 1;
+	for (uint32_t i = 0; i < SUMMARY_FILTER_HASHES; i++) {
+		uint32_t bit = (h1 + i * h2) % SUMMARY_FILTER_BITS;
+		if (!(bits[bit / 8] & (1 << (bit % 8)))) {
+			return false;
+		}
+	}
+	return true;
+}
+
+std::string id_filter::to_hex() const {
+	static const char digits[] = "0123456789abcdef";
+	std::string text;
+	text.reserve(sizeof(bits) * 2);
+	for (uint8_t byte : bits) {
+		text += digits[byte >> 4];
+		text += digits[byte & 0xF];
+	}
+	return text;
+}
+
+static int hex_digit(char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+id_filter id_filter::from_hex(const std::string& text) {
+	id_filter filter;
+	if (text.size() != sizeof(filter.bits) * 2) {
+		throw std::runtime_error("Invalid identifier filter");
+	}
+	for (size_t i = 0; i < sizeof(filter.bits); i++) {
+		int high = hex_digit(text[2 * i]), low = hex_digit(text[2 * i + 1]);
+		if (high < 0 || low < 0) {
+			throw std::runtime_error("Invalid identifier filter");
+		}
+		filter.bits[i] = (uint8_t)(high << 4 | low);
+	}
+	return filter;
+}
+
+SummarySink::SummarySink(ObjectSink& next)
+	: next(next)
+{
+}
+
+void SummarySink::write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) {
+	frame_view view;
+	if (make_frame_view(ohb, date_offset_ns, &view)) {
+		uint64_t key = (uint64_t)view.link_type << 48 | (uint64_t)view.hw_channel << 24 | view.channel;
+		interface_summary* entry = last_entry;
+		if (!entry || key != last_key) {
+			auto it = interfaces.find(key);
+			if (it == interfaces.end()) {
+				interface_summary created;
+				created.link_type = view.link_type;
+				created.channel = view.channel;
+				created.hw_channel = view.hw_channel;
+				it = interfaces.emplace(key, created).first;
+			}
+			entry = &it->second;
+			last_key = key;
+			last_entry = entry;
+		}
+		entry->frames++;
+		// Extended CAN identifiers are kept apart from standard ones
+		entry->ids.add(view.id | (view.flags & FRAME_FLAG_EXT ? 0x80000000 : 0));
+
+		first_ns = std::min(first_ns, view.timestamp_ns);
+		last_ns = std::max(last_ns, view.timestamp_ns);
+		frames++;
+	}
+	next.write_object(ohb, date_offset_ns);
+}
+
+void SummarySink::add_mapping(const pcapng_exporter::channel_mapping& mapping) {
+	next.add_mapping(mapping);
+}
+
+void SummarySink::flush() {
+	next.flush();
+}
+
+void SummarySink::write_json(std::ostream& out, const std::string& file) const {
+	std::vector<const interface_summary*> sorted;
+	for (const auto& item : interfaces) {
+		sorted.push_back(&item.second);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const interface_summary* a, const interface_summary* b) {
+		if (a->link_type != b->link_type) return a->link_type < b->link_type;
+		if (a->hw_channel != b->hw_channel) return a->hw_channel < b->hw_channel;
+		return a->channel < b->channel;
+	});
+
+	out << "{\"file\": " << json_quote(file) << ", \"frames\": " << frames;
+	if (frames > 0) {
+		out << ", \"start_ns\": " << first_ns << ", \"end_ns\": " << last_ns;
+	}
+	out << ",\n \"interfaces\": [";
+	bool first = true;
+	for (const auto* entry : sorted) {
+		out << (first ? "" : ",") << "\n  {"
+			<< "\"link_type\": " << entry->link_type
+			<< ", \"channel\": " << entry->channel
+			<< ", \"hw_channel\": " << entry->hw_channel
+			<< ", \"frames\": " << entry->frames
+			<< ", \"ids\": \"" << entry->ids.to_hex() << "\"}";
+		first = false;
+	}
+	out << "\n]}\n";
+}
+
+static uint64_t member_number(const nlohmann::json& value, const char* key) {
+	auto member = value.find(key);
+	if (member == value.end() || !member->is_number_unsigned()) {
+		throw std::runtime_error(std::string("Missing ") + key);
+	}
+	return member->get<uint64_t>();
+}
+
+bool summary_matches(const nlohmann::json& summary, const summary_query& query) {
+	auto interfaces = summary.find("interfaces");
+	if (summary.find("start_ns") == summary.end() || interfaces == summary.end() || !interfaces->is_array()) {
+		// No frames
+		return false;
+	}
+	if (member_number(summary, "end_ns") < query.from_ns || member_number(summary, "start_ns") > query.to_ns) {
+		return false;
+	}
+
+	for (const auto& item : *interfaces) {
+		if (query.link_type && member_number(item, "link_type") != *query.link_type) {
+			continue;
+		}
+		if (query.channel && member_number(item, "channel") != *query.channel) {
+			continue;
+		}
+		if (query.id) {
+			auto ids = item.find("ids");
+			if (ids == item.end() || !ids->is_string()) {
+				throw std::runtime_error("Missing ids");
+			}
+			id_filter filter = id_filter::from_hex(ids->get<std::string>());
+			if (!filter.may_contain(*query.id) && !filter.may_contain(*query.id | 0x80000000)) {
+				continue;
+			}
+		}
+		return true;
+	}
+	return false;
+}
+
+void query_summaries(const std::string& directory, const summary_query& query, std::function<void(const std::string& file)> on_match) {
+	if (!fs::is_directory(directory)) {
+		throw std::runtime_error("Not a directory: " + directory);
+	}
+	for (const auto& entry : fs::recursive_directory_iterator(directory, fs::directory_options::skip_permission_denied)) {
+		if (!entry.is_regular_file() || entry.path().extension() != ".json") {
+			continue;
+		}
+		try {
+			nlohmann::json summary = load_json(entry.path().string());
+			auto file = summary.find("file");
+			if (file == summary.end() || !file->is_string()) {
+				continue;
+			}
+			if (summary_matches(summary, query)) {
+				on_match(file->get<std::string>());
+			}
+		}
+		catch (std::runtime_error&) {
+			// Unreadable or no summary
+		}
+	}
+}
+
+}
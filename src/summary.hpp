@@ -0,0 +1,90 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_SUMMARY_H
+#define _APP_SUMMARY_H
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+
+#include "encoder.hpp"
+#include "frame_view.hpp"
+#include "json.hpp"
+
+#define SUMMARY_FILTER_BITS 4096
+
+namespace blf_converter {
+
+// Bloom filter of the identifiers seen on one interface, 3 bits per identifier
+struct id_filter {
+	uint8_t bits[SUMMARY_FILTER_BITS / 8] = {};
+
+	void add(uint32_t id);
+	bool may_contain(uint32_t id) const;
+
+	std::string to_hex() const;
+	// Throws std::runtime_error for malformed text
+	static id_filter from_hex(const std::string& text);
+};
+
+// Collects a compact summary of a BLF file while the objects pass on to the
+// next sink: the time range of its frames and per interface the number of frames
+// and a Bloom filter of the CAN / LIN identifiers, FlexRay slots and EtherTypes.
+// Summaries of a whole archive tell which files may hold a message without
+// converting them, see query_summaries().
+class SummarySink : public ObjectSink {
+public:
+	explicit SummarySink(ObjectSink& next);
+
+	void write_object(Vector::BLF::ObjectHeaderBase* ohb, uint64_t date_offset_ns) override;
+	void add_mapping(const pcapng_exporter::channel_mapping& mapping) override;
+	void flush() override;
+
+	// file is recorded as the path of the BLF file
+	void write_json(std::ostream& out, const std::string& file) const;
+
+private:
+	struct interface_summary {
+		uint16_t link_type;
+		uint32_t channel;
+		uint32_t hw_channel;
+		uint64_t frames = 0;
+		id_filter ids;
+	};
+
+	ObjectSink& next;
+	std::unordered_map<uint64_t, interface_summary> interfaces;
+	uint64_t first_ns = UINT64_MAX;
+	uint64_t last_ns = 0;
+	uint64_t frames = 0;
+
+	// Consecutive frames mostly come from the same interface
+	uint64_t last_key = 0;
+	interface_summary* last_entry = nullptr;
+};
+
+// Unset fields match everything, the time range is inclusive
+struct summary_query {
+	std::optional<uint16_t> link_type;
+	std::optional<uint32_t> channel;
+	std::optional<uint32_t> id;
+	uint64_t from_ns = 0;
+	uint64_t to_ns = UINT64_MAX;
+};
+
+// True if the summarized file may contain frames matching the query. Identifiers
+// are looked up in Bloom filters, so a few files match without containing the identifier.
+bool summary_matches(const nlohmann::json& summary, const summary_query& query);
+
+// Calls on_match with the BLF file of every summary (*.json) below directory
+// that matches the query, other JSON files are skipped. Throws std::runtime_error.
+void query_summaries(const std::string& directory, const summary_query& query, std::function<void(const std::string& file)> on_match);
+
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "trace.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+#include "json.hpp"
+
+namespace blf_converter {
+
+static const char* stage_names[TRACE_STAGE_COUNT] = { "inflate", "decode", "mapping", "encode", "output" };
+
+Tracer::Tracer(size_t max_records)
+	: origin(now()), max_records(max_records)
+{
+	// The creating thread is the conversion thread
+	thread_index();
+}
+
+uint64_t Tracer::now() {
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t Tracer::thread_index() {
+	auto id = std::this_thread::get_id();
+	auto it = std::find(threads.begin(), threads.end(), id);
+	if (it != threads.end()) {
+		return (uint32_t)(it - threads.begin());
+	}
+	threads.push_back(id);
+	thread_names.push_back(threads.size() == 1 ? "convert" : "thread " + std::to_string(threads.size()));
+	return (uint32_t)threads.size() - 1;
+}
+
+void Tracer::name_thread(const std::string& name) {
+	std::lock_guard<std::mutex> lock(mutex);
+	thread_names[thread_index()] = name;
+}
+
+void Tracer::begin_container() {
+	container_start = now();
+	objects = 0;
+	std::fill(totals, totals + TRACE_STAGE_COUNT, 0);
+}
+
+void Tracer::end_container(uint64_t bytes) {
+	uint64_t end = now();
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!has_room()) {
+		dropped++;
+		return;
+	}
+	container_record record = { thread_index(), container_start, end, bytes, objects, {} };
+	std::copy(totals, totals + TRACE_STAGE_COUNT, record.totals);
+	containers.push_back(record);
+}
+
+void Tracer::span(const char* name, uint64_t start, uint64_t end, uint64_t bytes) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!has_room()) {
+		dropped++;
+		return;
+	}
+	spans.push_back({ name, thread_index(), start, end, bytes });
+}
+
+// Trace timestamps are microseconds
+static void write_event(std::ostream& out, bool& first, const char* name, uint32_t tid, uint64_t start, uint64_t duration, const std::string& args) {
+	char times[64];
+	snprintf(times, sizeof(times), "\"ts\":%.3f,\"dur\":%.3f", start / 1000.0, duration / 1000.0);
+	out << (first ? "\n" : ",\n") << "{\"name\":\"" << name << "\",\"cat\":\"blf_converter\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid << "," << times;
+	if (!args.empty()) {
+		out << ",\"args\":{" << args << "}";
+	}
+	out << "}";
+	first = false;
+}
+
+void Tracer::write_json(std::ostream& out) {
+	std::lock_guard<std::mutex> lock(mutex);
+	bool first = true;
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (size_t i = 0; i < thread_names.size(); i++) {
+		out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+			<< ",\"args\":{\"name\":" << json_quote(thread_names[i]) << "}}";
+		first = false;
+	}
+	for (const auto& c : containers) {
+		std::string args = "\"bytes\":" + std::to_string(c.bytes) + ",\"objects\":" + std::to_string(c.objects);
+		for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+			args += ",\"" + std::string(stage_names[s]) + "_us\":" + std::to_string(c.totals[s] / 1000);
+		}
+		write_event(out, first, "container", c.tid, c.start - origin, c.end - c.start, args);
+
+		// The summed stage times laid out one after the other inside the container
+		uint64_t encode = c.totals[TRACE_ENCODE] - std::min(c.totals[TRACE_ENCODE], c.totals[TRACE_OUTPUT]);
+		uint64_t durations[TRACE_STAGE_COUNT] = {
+			c.totals[TRACE_INFLATE], c.totals[TRACE_DECODE], c.totals[TRACE_MAPPING], encode, c.totals[TRACE_OUTPUT] };
+		uint64_t at = c.start - origin;
+		for (int s = 0; s < TRACE_STAGE_COUNT; s++) {
+			if (durations[s] == 0) continue;
+			write_event(out, first, stage_names[s], c.tid, at, durations[s], "");
+			at += durations[s];
+		}
+	}
+	for (const auto& s : spans) {
+		std::string args = s.bytes ? "\"bytes\":" + std::to_string(s.bytes) : "";
+		write_event(out, first, s.name, s.tid, s.start - origin, s.end - s.start, args);
+	}
+	out << "\n],\"otherData\":{\"dropped_records\":" << dropped << "}}\n";
+}
+
+}
@@ -0,0 +1,106 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_TRACE_H
+#define _APP_TRACE_H
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace blf_converter {
+
+enum trace_stage {
+	TRACE_INFLATE,  // zlib inflation of log containers
+	TRACE_DECODE,   // object deserialization by Vector_BLF
+	TRACE_MAPPING,  // channel mappings from AppText objects
+	TRACE_ENCODE,   // sinks, including TRACE_OUTPUT
+	TRACE_OUTPUT,   // writing encoded packets
+	TRACE_STAGE_COUNT
+};
+
+// Records where the conversion spends its time, as Chrome trace event JSON
+// (chrome://tracing, ui.perfetto.dev). Stage times are summed per log container
+// and written as one span per container with a child span per stage, so the
+// trace stays small for large files. Spans from other threads (e.g. the I/O
+// thread) are recorded individually with span().
+class Tracer {
+public:
+	explicit Tracer(size_t max_records = 1 << 20);
+
+	// Nanoseconds on a monotonic clock
+	static uint64_t now();
+
+	// Conversion thread only
+	void add(trace_stage stage, uint64_t ns) { totals[stage] += ns; }
+	void count_object() { objects++; }
+	void begin_container();
+	void end_container(uint64_t bytes);
+
+	// Any thread
+	void span(const char* name, uint64_t start, uint64_t end, uint64_t bytes = 0);
+	void name_thread(const std::string& name);
+
+	void write_json(std::ostream& out);
+
+private:
+	struct container_record {
+		uint32_t tid;
+		uint64_t start;
+		uint64_t end;
+		uint64_t bytes;
+		uint64_t objects;
+		uint64_t totals[TRACE_STAGE_COUNT];
+	};
+	struct span_record {
+		const char* name;
+		uint32_t tid;
+		uint64_t start;
+		uint64_t end;
+		uint64_t bytes;
+	};
+
+	uint64_t origin;
+	size_t max_records;
+	uint64_t dropped = 0;
+
+	uint64_t container_start = 0;
+	uint64_t objects = 0;
+	uint64_t totals[TRACE_STAGE_COUNT] = {};
+
+	std::mutex mutex;
+	std::vector<std::thread::id> threads;
+	std::vector<std::string> thread_names;
+	std::vector<container_record> containers;
+	std::vector<span_record> spans;
+
+	uint32_t thread_index();
+	bool has_room() const { return containers.size() + spans.size() < max_records; }
+};
+
+// Adds the time until the end of the scope to a stage, does nothing without tracer
+class trace_scope {
+public:
+	trace_scope(Tracer* tracer, trace_stage stage)
+		: tracer(tracer), stage(stage), start(tracer ? Tracer::now() : 0)
+	{
+	}
+	~trace_scope() {
+		if (tracer) {
+			tracer->add(stage, Tracer::now() - start);
+		}
+	}
+
+private:
+	Tracer* tracer;
+	trace_stage stage;
+	uint64_t start;
+};
+
+}
+
+#endif
@@ -0,0 +1,148 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+#include "watch.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace blf_converter {
+
+WorkerPool::WorkerPool(size_t workers, size_t queue_limit)
+	: queue_limit(queue_limit ? queue_limit : 1)
+{
+	for (size_t i = 0; i < (workers ? workers : 1); i++) {
+		threads.emplace_back(&WorkerPool::run, this);
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		closing = true;
+	}
+	changed.notify_all();
+	for (auto& thread : threads) {
+		thread.join();
+	}
+}
+
+void WorkerPool::submit(std::function<void()> job) {
+	std::unique_lock<std::mutex> lock(mutex);
+	changed.wait(lock, [this] { return jobs.size() < queue_limit; });
+	jobs.push_back(std::move(job));
+	lock.unlock();
+	changed.notify_all();
+}
+
+void WorkerPool::run() {
+	while (true) {
+		std::function<void()> job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			changed.wait(lock, [this] { return closing || !jobs.empty(); });
+			if (jobs.empty()) {
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+		changed.notify_all();
+		job();
+	}
+}
+
+#ifdef __linux__
+static bool has_extension(const std::string& name, const std::string& extension) {
+	if (name.size() <= extension.size()) {
+		return false;
+	}
+	size_t offset = name.size() - extension.size();
+	for (size_t i = 0; i < extension.size(); i++) {
+		if (tolower((unsigned char)name[offset + i]) != tolower((unsigned char)extension[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+void watch_directory(
+	const std::string& directory,
+	const std::string& extension,
+	const std::atomic<bool>& stop,
+	const std::function<void(const std::string& path)>& on_file
+) {
+	int fd = inotify_init1(IN_CLOEXEC);
+	if (fd < 0) {
+		throw std::runtime_error(std::string("inotify: ") + strerror(errno));
+	}
+	// Files are only complete once closed after writing or renamed into the directory
+	if (inotify_add_watch(fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_ONLYDIR) < 0) {
+		std::string error = strerror(errno);
+		close(fd);
+		throw std::runtime_error("Unable to watch " + directory + ": " + error);
+	}
+
+	alignas(inotify_event) char buffer[64 * 1024];
+	while (!stop) {
+		// Wake up regularly to check stop
+		pollfd pfd = { fd, POLLIN, 0 };
+		int ready = poll(&pfd, 1, 500);
+		if (ready < 0 && errno != EINTR) {
+			std::string error = strerror(errno);
+			close(fd);
+			throw std::runtime_error("Watching " + directory + " failed: " + error);
+		}
+		if (ready <= 0) {
+			continue;
+		}
+		ssize_t length = read(fd, buffer, sizeof(buffer));
+		if (length < 0 && errno != EINTR && errno != EAGAIN) {
+			std::string error = strerror(errno);
+			close(fd);
+			throw std::runtime_error("Watching " + directory + " failed: " + error);
+		}
+		if (length <= 0) {
+			continue;
+		}
+		for (char* p = buffer; p < buffer + length; ) {
+			inotify_event* event = (inotify_event*)p;
+			p += sizeof(inotify_event) + event->len;
+			if (event->mask & IN_Q_OVERFLOW) {
+				fprintf(stderr, "Too many files at once, some were missed\n");
+				continue;
+			}
+			if (event->len == 0 || (event->mask & IN_ISDIR)) {
+				continue;
+			}
+			std::string name = event->name;
+			if (has_extension(name, extension)) {
+				on_file(directory + "/" + name);
+			}
+		}
+	}
+	close(fd);
+}
+#else
+void watch_directory(
+	const std::string& directory,
+	const std::string&,
+	const std::atomic<bool>&,
+	const std::function<void(const std::string& path)>&
+) {
+	throw std::runtime_error("Watching " + directory + " is only supported on Linux");
+}
+#endif
+
+}
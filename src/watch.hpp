@@ -0,0 +1,57 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+#ifndef _APP_WATCH_H
+#define _APP_WATCH_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace blf_converter {
+
+// Fixed number of threads running queued jobs. submit() blocks while
+// queue_limit jobs are waiting, the destructor runs the remaining jobs.
+class WorkerPool {
+public:
+	WorkerPool(size_t workers, size_t queue_limit);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	void submit(std::function<void()> job);
+
+private:
+	size_t queue_limit;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<std::function<void()>> jobs;
+	bool closing = false;
+
+	std::vector<std::thread> threads;
+
+	void run();
+};
+
+// Calls on_file with the path of every file in directory that is closed after
+// writing or moved into it and ends with extension. Returns once stop is set,
+// throws std::runtime_error if the directory cannot be watched or waiting for
+// changes fails. Only supported on Linux.
+void watch_directory(
+	const std::string& directory,
+	const std::string& extension,
+	const std::atomic<bool>& stop,
+	const std::function<void(const std::string& path)>& on_file
+);
+
+}
+
+#endif
@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+#
+#  Copyright (c) 2020 Technica Engineering GmbH
+#  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+#
+# Checks that two PCAPNG files hold the same packets: the same number of
+# packets with the same timestamps, link types and data. Sections, interface
+# numbering and the order of packets with equal timestamps may differ, so that
+# the sections of --parallel compare equal to a sequential conversion.
+
+import struct
+import sys
+
+BLOCK_TYPE_SHB = 0x0A0D0D0A
+BLOCK_TYPE_IDB = 0x00000001
+BLOCK_TYPE_EPB = 0x00000006
+OPT_ENDOFOPT = 0
+OPT_IF_TSRESOL = 9
+
+
+def options(data, order):
+    offset = 0
+    while offset + 4 <= len(data):
+        code, length = struct.unpack_from(order + "HH", data, offset)
+        if code == OPT_ENDOFOPT:
+            return
+        yield code, data[offset + 4:offset + 4 + length]
+        offset += 4 + (length + 3) // 4 * 4
+
+
+def to_nanos(ticks, tsresol):
+    if tsresol & 0x80:
+        return ticks * 1000000000 >> (tsresol & 0x7F)
+    if tsresol <= 9:
+        return ticks * 10 ** (9 - tsresol)
+    return ticks // 10 ** (tsresol - 9)
+
+
+def read_packets(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    packets = []
+    interfaces = []
+    order = "<"
+    offset = 0
+    while offset + 12 <= len(data):
+        block_type = struct.unpack_from("<I", data, offset)[0]
+        if block_type == BLOCK_TYPE_SHB:
+            order = "<" if struct.unpack_from("<I", data, offset + 8)[0] == 0x1A2B3C4D else ">"
+            interfaces = []
+        block_length = struct.unpack_from(order + "I", data, offset + 4)[0]
+        if block_length < 12 or offset + block_length > len(data):
+            raise ValueError(f"{path}: damaged block at offset {offset}")
+        body = data[offset + 8:offset + block_length - 4]
+        if block_type == BLOCK_TYPE_IDB:
+            link_type = struct.unpack_from(order + "H", body, 0)[0]
+            tsresol = 6
+            for code, value in options(body[8:], order):
+                if code == OPT_IF_TSRESOL:
+                    tsresol = value[0]
+            interfaces.append((link_type, tsresol))
+        elif block_type == BLOCK_TYPE_EPB:
+            interface, high, low, captured = struct.unpack_from(order + "IIII", body, 0)
+            link_type, tsresol = interfaces[interface]
+            packets.append((to_nanos(high << 32 | low, tsresol), link_type, body[20:20 + captured]))
+        offset += block_length
+    return packets
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(f"Usage: {sys.argv[0]} expected.pcapng actual.pcapng", file=sys.stderr)
+        return 2
+    expected = sorted(read_packets(sys.argv[1]))
+    actual = sorted(read_packets(sys.argv[2]))
+    if len(expected) != len(actual):
+        print(f"{len(expected)} packets expected, {len(actual)} found")
+        return 1
+    for e, a in zip(expected, actual):
+        if e != a:
+            print(f"Packet at {e[0]} ns (link type {e[1]}) differs, found one at {a[0]} ns (link type {a[1]})")
+            return 1
+    print(f"{len(actual)} packets are equal")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,444 @@
+/*
+  Copyright (c) 2020 Technica Engineering GmbH
+  GNU General Public License v3.0+ (see LICENSE or https://www.gnu.org/licenses/gpl-3.0.txt)
+*/
+
+// Writes synthetic BLF files of arbitrary size for benchmarking. Each bus gets
+// a catalogue of messages per channel whose payloads change slowly like real
+// signals, so compression ratios stay close to recorded traces.
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <args.hxx>
+#include <zlib.h>
+
+#include <Vector/BLF.h>
+
+#include "blf_format.hpp"
+
+using namespace Vector::BLF;
+
+#define NANOS_PER_SEC 1000000000
+
+// Vector_BLF busType values used by DbChannelInfo
+#define BUS_TYPE_CAN 0x01
+#define BUS_TYPE_LIN 0x05
+#define BUS_TYPE_FLEXRAY 0x07
+#define BUS_TYPE_ETHERNET 0x0B
+
+enum bus { BUS_CANFD, BUS_ETHERNET, BUS_FLEXRAY, BUS_LIN, BUS_COUNT };
+
+static const char* bus_names[BUS_COUNT] = { "canfd", "ethernet", "flexray", "lin" };
+
+// Serializes objects through Vector_BLF into memory
+class BufferFile : public AbstractFile {
+public:
+	std::vector<uint8_t> data;
+
+	std::streamsize gcount() const override { return 0; }
+	void read(char* s, std::streamsize n) override { throw std::runtime_error("Write only"); }
+	std::streampos tellg() override { return (std::streamoff)pos; }
+	void seekg(const std::streampos p) override { pos = (size_t)(std::streamoff)p; }
+	void seekg(const std::streamoff off, const std::ios_base::seekdir way) override {
+		if (way == std::ios_base::beg) pos = (size_t)off;
+		else if (way == std::ios_base::cur) pos = (size_t)((std::streamoff)pos + off);
+		else pos = (size_t)((std::streamoff)data.size() + off);
+	}
+	void write(const char* s, std::streamsize n) override {
+		if (pos + n > data.size()) {
+			data.resize(pos + n);
+		}
+		memcpy(data.data() + pos, s, (size_t)n);
+		pos += (size_t)n;
+	}
+	std::streampos tellp() override { return (std::streamoff)pos; }
+	bool good() const override { return true; }
+	bool eof() const override { return false; }
+
+	void append(ObjectHeaderBase& obj) {
+		obj.headerSize = obj.calculateHeaderSize();
+		obj.objectSize = obj.calculateObjectSize();
+		size_t start = data.size();
+		pos = start;
+		obj.write(*this);
+		// Objects are padded to 4 bytes, whether or not write() did it
+		data.resize(std::max(data.size(), start + obj.objectSize + obj.objectSize % 4), 0);
+	}
+
+	void clear() {
+		data.clear();
+		pos = 0;
+	}
+
+private:
+	size_t pos = 0;
+};
+
+static void put_le16(uint8_t* p, uint16_t v) { p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); }
+static void put_le32(uint8_t* p, uint32_t v) { put_le16(p, (uint16_t)v); put_le16(p + 2, (uint16_t)(v >> 16)); }
+static void put_le64(uint8_t* p, uint64_t v) { put_le32(p, (uint32_t)v); put_le32(p + 4, (uint32_t)(v >> 32)); }
+
+static void put_systemtime(uint8_t* p, const SYSTEMTIME& t) {
+	put_le16(p, t.year);
+	put_le16(p + 2, t.month);
+	put_le16(p + 4, t.dayOfWeek);
+	put_le16(p + 6, t.day);
+	put_le16(p + 8, t.hour);
+	put_le16(p + 10, t.minute);
+	put_le16(p + 12, t.second);
+	put_le16(p + 14, t.milliseconds);
+}
+
+// Packs objects into log containers and keeps the file statistics
+class BlfWriter {
+public:
+	BlfWriter(const std::string& path, int compression_level, size_t container_size)
+		: out(path, std::ios_base::out | std::ios_base::binary), level(compression_level), container_size(container_size)
+	{
+		if (!out.is_open()) {
+			throw std::runtime_error("Unable to open: " + path);
+		}
+		std::vector<uint8_t> header(BLF_FILE_STATISTICS_SIZE, 0);
+		out.write((const char*)header.data(), header.size());
+		file_size = BLF_FILE_STATISTICS_SIZE;
+		uncompressed_size = BLF_FILE_STATISTICS_SIZE;
+	}
+
+	void write(ObjectHeaderBase& obj) {
+		objects.append(obj);
+		object_count++;
+		if (objects.data.size() >= container_size) {
+			write_container(container_size);
+		}
+	}
+
+	void close(const SYSTEMTIME& start, const SYSTEMTIME& last) {
+		while (!objects.data.empty()) {
+			write_container(std::min(container_size, objects.data.size()));
+		}
+		uint8_t header[BLF_FILE_STATISTICS_SIZE] = { 0 };
+		put_le32(header, BLF_FILE_SIGNATURE);
+		put_le32(header + 4, BLF_FILE_STATISTICS_SIZE);
+		put_le32(header + 8, 4070100);
+		header[12] = 2; // CANoe
+		header[13] = (uint8_t)level;
+		header[14] = 12;
+		header[15] = 0;
+		put_le64(header + 16, file_size);
+		put_le64(header + 24, uncompressed_size);
+		put_le32(header + 32, (uint32_t)object_count);
+		put_le32(header + 36, 0);
+		put_systemtime(header + 40, start);
+		put_systemtime(header + 56, last);
+		out.seekp(0);
+		out.write((const char*)header, sizeof(header));
+		out.close();
+		if (!out) {
+			throw std::runtime_error("Write failed");
+		}
+	}
+
+	uint64_t objects_written() const { return object_count; }
+	uint64_t bytes_written() const { return file_size; }
+
+private:
+	std::ofstream out;
+	int level;
+	size_t container_size;
+	BufferFile objects;
+	std::vector<uint8_t> compressed;
+	uint64_t object_count = 0;
+	uint64_t file_size = 0;
+	uint64_t uncompressed_size = 0;
+
+	// Objects span containers like in files written by CANoe
+	void write_container(size_t length) {
+		const uint8_t* payload = objects.data.data();
+		size_t payload_length = length;
+		uint16_t method = BLF_COMPRESSION_NONE;
+		if (level > 0) {
+			uLongf compressed_length = compressBound((uLong)length);
+			compressed.resize(compressed_length);
+			if (compress2(compressed.data(), &compressed_length, payload, (uLong)length, level) != Z_OK) {
+				throw std::runtime_error("Compression failed");
+			}
+			payload = compressed.data();
+			payload_length = compressed_length;
+			method = BLF_COMPRESSION_ZLIB;
+		}
+
+		uint8_t header[BLF_LOG_CONTAINER_HEADER_SIZE] = { 0 };
+		uint32_t object_size = (uint32_t)(BLF_LOG_CONTAINER_HEADER_SIZE + payload_length);
+		put_le32(header, BLF_OBJECT_SIGNATURE);
+		put_le16(header + 4, BLF_OBJECT_HEADER_BASE_SIZE);
+		put_le16(header + 6, 1);
+		put_le32(header + 8, object_size);
+		put_le32(header + 12, (uint32_t)ObjectType::LOG_CONTAINER);
+		put_le16(header + 16, method);
+		put_le32(header + 24, (uint32_t)length);
+		out.write((const char*)header, sizeof(header));
+		out.write((const char*)payload, payload_length);
+		static const char padding[4] = { 0 };
+		out.write(padding, object_size % 4);
+
+		file_size += object_size + object_size % 4;
+		uncompressed_size += BLF_LOG_CONTAINER_HEADER_SIZE + length;
+		objects.data.erase(objects.data.begin(), objects.data.begin() + length);
+	}
+};
+
+// A periodic message with slowly changing signal values
+struct message {
+	uint32_t channel;
+	uint32_t id;
+	uint32_t length;
+	uint32_t counter = 0;
+	std::vector<uint8_t> payload;
+};
+
+static uint64_t parse_size(const std::string& text) {
+	size_t pos = 0;
+	double value = std::stod(text, &pos);
+	std::string unit = text.substr(pos);
+	if (unit == "K") value *= 1 << 10;
+	else if (unit == "M") value *= 1 << 20;
+	else if (unit == "G") value *= 1 << 30;
+	else if (!unit.empty()) throw std::invalid_argument("Unknown size unit: " + unit);
+	return (uint64_t)value;
+}
+
+// "canfd=70,ethernet=20,flexray=5,lin=5"
+static std::vector<double> parse_mix(const std::string& text) {
+	std::vector<double> weights(BUS_COUNT, 0);
+	size_t start = 0;
+	while (start < text.size()) {
+		size_t end = text.find(',', start);
+		if (end == std::string::npos) end = text.size();
+		std::string item = text.substr(start, end - start);
+		size_t eq = item.find('=');
+		if (eq == std::string::npos) throw std::invalid_argument("Invalid mix entry: " + item);
+		std::string name = item.substr(0, eq);
+		auto it = std::find(bus_names, bus_names + BUS_COUNT, name);
+		if (it == bus_names + BUS_COUNT) throw std::invalid_argument("Unknown bus: " + name);
+		weights[it - bus_names] = std::stod(item.substr(eq + 1));
+		start = end + 1;
+	}
+	return weights;
+}
+
+static void update_payload(message& msg, std::mt19937& rng) {
+	msg.counter++;
+	if (msg.payload.empty()) return;
+	// Alive counter, one slowly drifting signal, the rest mostly static
+	msg.payload[0] = (uint8_t)msg.counter;
+	if (msg.payload.size() > 2) {
+		msg.payload[1 + msg.counter % (msg.payload.size() - 1)] += (uint8_t)(rng() % 3);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	args::ArgumentParser parser("Generates synthetic BLF files for benchmarking blf_converter.");
+	parser.helpParams.showTerminator = false;
+	parser.helpParams.proglineShowFlags = true;
+
+	args::HelpFlag help(parser, "help", "", { 'h', "help" }, args::Options::HiddenFromUsage);
+	args::ValueFlag<std::string> sizearg(parser, "size", "Uncompressed object data to write (e.g. 512M, 4G)", { "size" }, "1G");
+	args::ValueFlag<std::string> mixarg(parser, "mix", "Share of objects per bus", { "mix" }, "canfd=70,ethernet=20,flexray=5,lin=5");
+	args::ValueFlag<uint32_t> channelsarg(parser, "count", "Channels per bus", { "channels" }, 4);
+	args::ValueFlag<uint32_t> messagesarg(parser, "count", "Distinct messages per channel", { "messages" }, 200);
+	args::ValueFlag<int> compressionarg(parser, "level", "zlib level of the log containers, 0 stores them uncompressed", { "compression" }, 6);
+	args::ValueFlag<size_t> containerarg(parser, "bytes", "Uncompressed size of a log container", { "container-size" }, 128 * 1024);
+	args::ValueFlag<uint32_t> ratearg(parser, "count", "Objects per second of simulated time", { "rate" }, 20000);
+	args::ValueFlag<uint32_t> seedarg(parser, "seed", "Random seed", { "seed" }, 1);
+	args::Flag noapptextarg(parser, "no-app-text", "Do not write channel names as AppText", { "no-app-text" });
+	args::Positional<std::string> outarg(parser, "outfile", "Output File", args::Options::Required);
+
+	try
+	{
+		parser.ParseCLI(argc, argv);
+	}
+	catch (const args::Help&)
+	{
+		std::cout << parser;
+		return 0;
+	}
+	catch (const args::Error& e)
+	{
+		std::cerr << e.what() << std::endl;
+		std::cerr << parser;
+		return 1;
+	}
+
+	uint64_t target_size;
+	std::vector<double> mix;
+	try {
+		target_size = parse_size(args::get(sizearg));
+		mix = parse_mix(args::get(mixarg));
+	}
+	catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+
+	std::mt19937 rng(args::get(seedarg));
+	uint32_t channels = std::max(1u, args::get(channelsarg));
+	uint32_t per_channel = std::max(1u, args::get(messagesarg));
+
+	// Message catalogues
+	static const uint32_t canfd_lengths[] = { 8, 8, 8, 16, 32, 64 };
+	static const uint32_t ethernet_lengths[] = { 60, 60, 128, 342, 590, 1514 };
+	static const uint32_t flexray_lengths[] = { 16, 16, 32, 42, 64 };
+	static const uint32_t lin_lengths[] = { 2, 4, 8, 8 };
+	std::vector<message> catalogue[BUS_COUNT];
+	for (uint32_t ch = 1; ch <= channels; ch++) {
+		for (uint32_t i = 0; i < per_channel; i++) {
+			message msg;
+			msg.channel = ch;
+
+			msg.id = 0x100 + i * 7;
+			msg.length = canfd_lengths[rng() % 6];
+			catalogue[BUS_CANFD].push_back(msg);
+
+			msg.id = 0x0800;
+			msg.length = ethernet_lengths[rng() % 6];
+			catalogue[BUS_ETHERNET].push_back(msg);
+
+			msg.id = 1 + i % 2047;
+			msg.length = flexray_lengths[rng() % 5];
+			catalogue[BUS_FLEXRAY].push_back(msg);
+
+			if (i < 60) {
+				msg.id = i;
+				msg.length = lin_lengths[rng() % 4];
+				catalogue[BUS_LIN].push_back(msg);
+			}
+		}
+	}
+	for (auto& messages : catalogue) {
+		for (auto& msg : messages) {
+			msg.payload.resize(msg.length);
+			for (auto& b : msg.payload) {
+				b = (uint8_t)(rng() % 4 == 0 ? rng() : 0);
+			}
+		}
+	}
+
+	std::vector<double> weights;
+	for (int b = 0; b < BUS_COUNT; b++) {
+		weights.push_back(catalogue[b].empty() ? 0 : mix[b]);
+	}
+	std::discrete_distribution<int> pick_bus(weights.begin(), weights.end());
+	size_t next_message[BUS_COUNT] = { 0 };
+
+	SYSTEMTIME start = {};
+	start.year = 2020;
+	start.month = 6;
+	start.day = 1;
+	start.hour = 8;
+
+	try {
+		BlfWriter writer(args::get(outarg), std::min(9, std::max(0, args::get(compressionarg))), std::max((size_t)4096, args::get(containerarg)));
+
+		if (!noapptextarg) {
+			static const std::pair<int, uint32_t> buses[] = {
+				{ BUS_CANFD, BUS_TYPE_CAN }, { BUS_LIN, BUS_TYPE_LIN }, { BUS_FLEXRAY, BUS_TYPE_FLEXRAY }, { BUS_ETHERNET, BUS_TYPE_ETHERNET } };
+			for (const auto& bus : buses) {
+				if (weights[bus.first] <= 0) continue;
+				for (uint32_t ch = 1; ch <= channels; ch++) {
+					AppText text;
+					text.objectFlags = ObjectHeader::ObjectFlags::TimeOneNans;
+					text.objectTimeStamp = 0;
+					text.source = AppText::Source::DbChannelInfo;
+					text.reservedAppText1 = bus.second << 16 | ch << 8;
+					text.text = std::string("Generated.dbc;") + bus_names[bus.first] + std::to_string(ch);
+					text.textLength = (DWORD)text.text.size();
+					writer.write(text);
+				}
+			}
+		}
+
+		uint64_t step_ns = NANOS_PER_SEC / std::max(1u, args::get(ratearg));
+		uint64_t ts = 0;
+		uint64_t written = 0;
+
+		CanFdMessage64 canfd;
+		EthernetFrameEx ethernet;
+		FlexRayVFrReceiveMsgEx flexray;
+		LinMessage2 lin;
+
+		while (written < target_size) {
+			int b = pick_bus(rng);
+			message& msg = catalogue[b][next_message[b]++ % catalogue[b].size()];
+			update_payload(msg, rng);
+			ts += step_ns / 2 + rng() % step_ns;
+
+			ObjectHeader* oh;
+			switch (b) {
+			case BUS_CANFD:
+				canfd.channel = (BYTE)msg.channel;
+				canfd.id = msg.id;
+				canfd.flags = 1 << 12 | 1 << 13; // EDL, BRS
+				canfd.validDataBytes = (BYTE)msg.length;
+				canfd.dlc = (BYTE)(msg.length <= 8 ? msg.length : msg.length == 16 ? 10 : msg.length == 32 ? 13 : 15);
+				canfd.data = msg.payload;
+				oh = &canfd;
+				break;
+			case BUS_ETHERNET: {
+				static const uint8_t header[14] = { 0x02, 0, 0, 0, 0, 1, 0x02, 0, 0, 0, 0, 2, 0x08, 0x00 };
+				ethernet.channel = (WORD)msg.channel;
+				ethernet.hardwareChannel = 0;
+				ethernet.dir = msg.counter % 2;
+				ethernet.frameData.assign(header, header + sizeof(header));
+				ethernet.frameData.insert(ethernet.frameData.end(), msg.payload.begin(), msg.payload.end() - std::min((size_t)14, msg.payload.size()));
+				ethernet.frameLength = (WORD)ethernet.frameData.size();
+				oh = &ethernet;
+				break;
+			}
+			case BUS_FLEXRAY:
+				flexray.channel = (WORD)msg.channel;
+				flexray.channelMask = 1;
+				flexray.frameId = (WORD)msg.id;
+				flexray.cycle = (WORD)(msg.counter % 64);
+				flexray.byteCount = (WORD)msg.length;
+				flexray.dataCount = (WORD)msg.length;
+				flexray.dataBytes = msg.payload;
+				oh = &flexray;
+				break;
+			default:
+				lin.channel = (WORD)msg.channel;
+				lin.id = (BYTE)msg.id;
+				lin.dlc = (BYTE)msg.length;
+				std::fill(lin.data.begin(), lin.data.end(), 0);
+				std::copy(msg.payload.begin(), msg.payload.end(), lin.data.begin());
+				oh = &lin;
+				break;
+			}
+			oh->objectFlags = ObjectHeader::ObjectFlags::TimeOneNans;
+			oh->objectTimeStamp = ts;
+			writer.write(*oh);
+			written += oh->objectSize;
+		}
+
+		SYSTEMTIME last = start;
+		uint64_t seconds = ts / NANOS_PER_SEC;
+		last.milliseconds = (WORD)(ts / 1000000 % 1000);
+		last.second = (WORD)(seconds % 60);
+		last.minute = (WORD)(seconds / 60 % 60);
+		last.hour = (WORD)(start.hour + seconds / 3600 % 16);
+		writer.close(start, last);
+
+		std::cout << writer.objects_written() << " objects, " << writer.bytes_written() << " bytes" << std::endl;
+	}
+	catch (std::runtime_error& e) {
+		std::cerr << e.what() << std::endl;
+		return 1;
+	}
+	return 0;
+}